@@ -0,0 +1,20 @@
+#ifndef ADC_FAST_H_
+#define ADC_FAST_H_
+
+#include "stm32f4xx_hal.h"
+#include "stm32f4xx_ll_adc.h"
+
+/* Per-sample ADC fast path: HAL still configures the ADCs (MX_ADCx_Init), but single conversions
+ * are started and collected through LL with the converter left powered between samples. */
+#ifndef ADC_FAST_PATH
+#define ADC_FAST_PATH                 1                 // 0 keeps HAL_ADC_Start/PollForConversion/Stop
+#endif
+#define ADC_FAST_TIMEOUT_US           100               // 480 + 10 cycles at 9 MHz take 55 us
+
+
+void ADC_FAST_INIT(ADC_HandleTypeDef *hadc);
+int ADC_FAST_READ(ADC_TypeDef *adc);
+void ADC_FAST_BENCH(ADC_HandleTypeDef *hadc, uint32_t *hal_cycles, uint32_t *ll_cycles);
+
+
+#endif /* ADC_FAST_H_ */
@@ -0,0 +1,65 @@
+#ifndef ADC_TUNE_H_
+#define ADC_TUNE_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Sample-time tuning: for one input, the sample times are tried from the shortest up and the
+ * first one whose settling error stays within the target is kept. The settling test kicks the
+ * sampling capacitor to a reference input (sampled for 480 cycles), converts the input once,
+ * and compares that first conversion with the settled value of back-to-back conversions. The
+ * error is scaled to a full-scale step, so the result does not depend on how far the input
+ * happens to sit from the reference. The reference is VREFINT on ADC1; ADC2 has no internal
+ * channels, so it kicks from another external input. Conversions go through a callback: the
+ * ADC that samples the input, or the source-impedance model for checks off target. */
+#define ADC_TUNE_SAMPLE_TIMES         8                 // ADC_SAMPLETIME_3CYCLES .. ADC_SAMPLETIME_480CYCLES
+#define ADC_TUNE_TRIALS               16                // Kick + first conversion pairs per sample time
+#define ADC_TUNE_SETTLED              16                // Back-to-back conversions for the settled value
+#define ADC_TUNE_TARGET_LSB           1                 // Allowed full-scale settling error
+#define ADC_TUNE_MIN_SWING            128               // Smaller input-to-reference gaps cannot resolve the error
+#define ADC_TUNE_FULL_SCALE           1023              // 10-bit conversions
+#define ADC_TUNE_CONVERSION_CYCLES    10                // 10-bit successive approximation
+#define ADC_TUNE_REFERENCE            ADC_CHANNEL_VREFINT
+
+#define ADC_TUNE_OK                   0
+#define ADC_TUNE_WEAK                 1                 // Input too close to the kick input: longest time kept
+#define ADC_TUNE_ERROR                -1                // Conversion failed
+
+/* Converts input (an ADC channel number) with a sample time code (ADC_SAMPLETIME_xxx),
+ * returning the code or -1 */
+typedef int (*ADC_TUNE_ConvertFn)(void *ctx, uint8_t input, uint8_t sample_time);
+
+typedef struct
+{
+  uint8_t sample_time;                                  // Chosen ADC_SAMPLETIME_xxx code
+  uint16_t swing;                                       // Settled input to kick input gap (LSB)
+  uint16_t error_q4[ADC_TUNE_SAMPLE_TIMES];             // Full-scale settling error per time, 1/16 LSB
+  uint32_t rate_hz;                                     // Conversions per second at the chosen time
+} ADC_TUNE_Result;
+
+/* RC model of the source and the sampling capacitor:
+ * v += (v_input - v) * (1 - exp(-t_sample / ((R_source + R_adc) * C_adc))) per conversion */
+typedef struct
+{
+  uint8_t input;                                        // Channel of the tuned input
+  float source_ohms;                                    // Its source resistance
+  float level;                                          // Its voltage, in LSB
+  float reference;                                      // Any other input, in LSB (low-impedance source)
+  float cap;                                            // Sampling capacitor state, in LSB
+  uint32_t seed;                                        // Dither (+-0.5 LSB, stands in for the ADC noise)
+} ADC_TUNE_Model;
+
+#define ADC_TUNE_MODEL_R_ADC          6000.0f           // Sampling switch resistance (datasheet max)
+#define ADC_TUNE_MODEL_C_ADC          4e-12f            // Sampling capacitor
+
+
+int ADC_TUNE_RUN(ADC_TUNE_ConvertFn convert, void *ctx, uint8_t channel, uint8_t kick, ADC_TUNE_Result *result);
+uint32_t ADC_TUNE_CYCLES(uint8_t sample_time);
+uint32_t ADC_TUNE_CLOCK(void);
+void ADC_TUNE_SET_SAMPLE_TIME(ADC_TypeDef *adc, uint8_t channel, uint8_t sample_time);
+void ADC_TUNE_BEGIN(ADC_TypeDef *adc);
+void ADC_TUNE_END(ADC_TypeDef *adc);
+int ADC_TUNE_ADC(void *ctx, uint8_t input, uint8_t sample_time);
+int ADC_TUNE_MODEL_CONVERT(void *ctx, uint8_t input, uint8_t sample_time);
+
+
+#endif /* ADC_TUNE_H_ */
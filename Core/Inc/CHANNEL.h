@@ -0,0 +1,53 @@
+#ifndef CHANNEL_H_
+#define CHANNEL_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Channel registry laid out as structure-of-arrays: every field lives in its own contiguous,
+ * word-aligned array so CHANNEL_PROCESS walks memory linearly, two 16-bit channels per word. */
+#define CHANNEL_MAX                   32                // Must be even
+#define CHANNEL_GAIN_ONE              4096              // Calibration gain is Q12
+#define CHANNEL_FLAG_ENABLED          0x01
+#define CHANNEL_FLAG_FRESH            0x02              // Written since the last CHANNEL_PROCESS
+#define CHANNEL_FLAG_OVERRANGE        0x04              // Last raw value above the channel limit
+#define CHANNEL_SNAPSHOT_MAX          8                 // Channels published in the snapshot
+
+typedef struct
+{
+  uint16_t raw[CHANNEL_MAX] __attribute__((aligned(4)));
+  uint16_t filtered[CHANNEL_MAX] __attribute__((aligned(4)));  // (filtered + raw) / 2 per pass
+  int16_t scaled[CHANNEL_MAX] __attribute__((aligned(4)));     // (raw - offset) * gain, raw < 0x8000
+  uint32_t timestamp[CHANNEL_MAX];                             // Tick of the last raw value
+  int16_t gain[CHANNEL_MAX] __attribute__((aligned(4)));
+  int16_t offset[CHANNEL_MAX] __attribute__((aligned(4)));
+  uint16_t limit[CHANNEL_MAX] __attribute__((aligned(4)));
+  uint8_t flags[CHANNEL_MAX] __attribute__((aligned(4)));
+  const char *name[CHANNEL_MAX];
+  uint8_t count;
+} CHANNEL_Registry;
+
+/* Consistent copy of the first CHANNEL_SNAPSHOT_MAX channels, published after every CHANNEL_PROCESS */
+typedef struct
+{
+  uint16_t raw[CHANNEL_SNAPSHOT_MAX];
+  uint16_t filtered[CHANNEL_SNAPSHOT_MAX];
+  int16_t scaled[CHANNEL_SNAPSHOT_MAX];
+  uint32_t timestamp[CHANNEL_SNAPSHOT_MAX];
+  uint8_t flags[CHANNEL_SNAPSHOT_MAX];
+  uint8_t count;
+  uint32_t pass;                                        // CHANNEL_PROCESS passes so far
+} CHANNEL_Snapshot;
+
+extern CHANNEL_Registry channel_Registry;
+
+
+void CHANNEL_INIT(void);
+int CHANNEL_REGISTER(const char *name, int16_t gain, int16_t offset, uint16_t limit);
+void CHANNEL_CONFIGURE(uint8_t channel, int16_t gain, int16_t offset, uint16_t limit);
+void CHANNEL_SET(uint8_t channel, uint16_t raw, uint32_t tick);
+void CHANNEL_PROCESS(void);
+uint32_t CHANNEL_READ_SNAPSHOT(CHANNEL_Snapshot *snapshot);
+void CHANNEL_RESTORE(const CHANNEL_Snapshot *snapshot);
+
+
+#endif /* CHANNEL_H_ */
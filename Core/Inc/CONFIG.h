@@ -0,0 +1,52 @@
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include "stm32f4xx_hal.h"
+#include "GRAPH.h"
+
+/* Live configuration: two configuration sets, one active and one being prepared. A new set is
+ * edited off-line, validated, its pipeline built, and then activated by bumping the epoch (one
+ * word store). Every stage picks the active set up at its own block boundary with CONFIG_ENTER,
+ * so sampling never stops; the old set is only handed out for editing again once every stage
+ * has moved to the new epoch. */
+#define CONFIG_CHANNELS               GRAPH_CHANNELS
+#define CONFIG_PERIOD_MIN_MS          1
+#define CONFIG_PERIOD_MAX_MS          60000
+
+/* Stages reading the configuration (each calls CONFIG_ENTER from one task only) */
+#define CONFIG_STAGE_ACQ0             0                 // Acquisition + pipeline of channel 0
+#define CONFIG_STAGE_ACQ1             1                 // Acquisition + pipeline of channel 1
+#define CONFIG_STAGE_PROCESS          2                 // Registry calibration
+#define CONFIG_STAGES                 3
+
+typedef struct
+{
+  uint16_t period_ms[CONFIG_CHANNELS];                  // Sample period
+  int16_t gain[CONFIG_CHANNELS];                        // Q12 calibration gain
+  int16_t offset[CONFIG_CHANNELS];                      // Calibration offset (raw counts)
+  uint16_t limit[CONFIG_CHANNELS];                      // Over-range threshold (raw counts)
+  uint8_t sample_time[CONFIG_CHANNELS];                 // ADC_SAMPLETIME_xxx code (0..7), see ADC_TUNE
+  uint8_t filter_shift;                                 // Pipeline EMA smoothing (1..15)
+  uint8_t decimate;                                     // Pipeline decimation factor (2..255)
+} CONFIG_Params;
+
+typedef struct
+{
+  CONFIG_Params params;
+  GRAPH_Graph pipeline;                                 // Built from params before activation
+  int stats[CONFIG_CHANNELS];                           // Stats node of each channel's pipeline
+  uint32_t epoch;                                       // Epoch at which the set became active
+} CONFIG_Set;
+
+typedef int (*CONFIG_BuildFn)(CONFIG_Set *set);         // Builds set->pipeline, 0 on success
+
+
+int CONFIG_INIT(const CONFIG_Params *defaults, CONFIG_BuildFn build);
+int CONFIG_VALIDATE(const CONFIG_Params *params);
+CONFIG_Params *CONFIG_EDIT(void);
+int CONFIG_COMMIT(void);
+CONFIG_Set *CONFIG_ENTER(uint8_t stage);
+uint32_t CONFIG_EPOCH(void);
+
+
+#endif /* CONFIG_H_ */
@@ -0,0 +1,71 @@
+#ifndef DWT_DELAY_H_
+#define DWT_DELAY_H_
+
+#include "stm32f4xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DWT_CYCLES_PER_US             (SystemCoreClock / 1000000U)
+
+
+void DWT_DELAY_INIT(void);
+
+
+/**
+  * @brief  Returns the current value of the DWT cycle counter.
+  * @param  None
+  * @retval The number of core clock cycles elapsed since the first DWT_DELAY_INIT (wraps every 2^32 cycles).
+  */
+
+static inline uint32_t DWT_GET_CYCLES(void)
+{
+  return DWT->CYCCNT;
+}
+
+
+/**
+  * @brief  Busy-waits for the given number of core clock cycles.
+  * @param  cycles: Number of cycles to wait.
+  * @retval None
+  * @note   The subtraction is done modulo 2^32 so the wait is correct across counter wrap.
+  */
+
+static inline void DWT_DELAY_CYCLES(uint32_t cycles)
+{
+  uint32_t start = DWT->CYCCNT;
+  while ((DWT->CYCCNT - start) < cycles);
+}
+
+
+/**
+  * @brief  Busy-waits for the given number of microseconds.
+  * @param  us: Number of microseconds to wait.
+  * @retval None
+  */
+
+static inline void DWT_DELAY_US(uint32_t us)
+{
+  DWT_DELAY_CYCLES(us * DWT_CYCLES_PER_US);
+}
+
+
+/**
+  * @brief  Busy-waits for at least the given number of nanoseconds.
+  * @param  ns: Number of nanoseconds to wait.
+  * @retval None
+  * @note   The cycle count is rounded up so that short setup/hold times are never undershot.
+  */
+
+static inline void DWT_DELAY_NS(uint32_t ns)
+{
+  DWT_DELAY_CYCLES(((ns * DWT_CYCLES_PER_US) + 999U) / 1000U);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DWT_DELAY_H_ */
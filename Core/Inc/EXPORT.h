@@ -0,0 +1,43 @@
+#ifndef EXPORT_H_
+#define EXPORT_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Streaming exporter: sample blocks framed as COBS(header | samples | CRC-16) 0x00 on USART3 TX (PD8) */
+#define EXPORT_BAUDRATE               921600
+#define EXPORT_RING_SIZE              2048              // TX ring in bytes, drained by DMA1 Stream3
+#define EXPORT_BLOCK_SAMPLES          16                // Samples per frame
+#define EXPORT_CHANNELS               2
+#define EXPORT_FRAME_SAMPLE_BLOCK     0x01              // Frame type of a sample block
+#define EXPORT_FRAME_TIME             0x02              // Tick to Unix time mapping (channel, count = 0)
+#define EXPORT_HEADER_SIZE            8                 // type, seq, channel, count, tick (u32 LE)
+#define EXPORT_TIME_SIZE              14                // us (u16), wall us (i64), skew Q32 (i32), LE
+#define EXPORT_CRC_SIZE               2
+#define EXPORT_PAYLOAD_MAX            (EXPORT_HEADER_SIZE + 2 * EXPORT_BLOCK_SAMPLES + EXPORT_CRC_SIZE)
+#define EXPORT_FRAME_MAX              (EXPORT_PAYLOAD_MAX + EXPORT_PAYLOAD_MAX / 254 + 2)
+#define EXPORT_DMA_IRQ_PRIORITY       5
+
+#define EXPORT_OK                     0
+#define EXPORT_DROPPED                1                 // Ring full: frame discarded and counted
+
+typedef struct
+{
+  uint32_t frames_sent;                                 // Frames queued in the TX ring
+  uint32_t frames_dropped;                              // Frames rejected by back-pressure (seq skipped)
+  uint32_t bytes_sent;                                  // Bytes handed to the DMA
+  uint16_t ring_peak;                                   // Highest ring occupancy seen, in bytes
+} EXPORT_Stats;
+
+
+void EXPORT_INIT(void);
+int EXPORT_PUSH_BLOCK(uint8_t channel, const uint16_t *samples, uint8_t count);
+void EXPORT_PUSH_SAMPLE(uint8_t channel, uint16_t sample);
+int EXPORT_PUSH_TIME(uint32_t tick, uint16_t us, int64_t wall_us, int32_t skew_q32);
+uint16_t EXPORT_FREE_SPACE(void);
+void EXPORT_GET_STATS(EXPORT_Stats *stats);
+uint16_t EXPORT_CRC16(uint16_t crc, const uint8_t *data, uint32_t length);
+uint32_t EXPORT_COBS_ENCODE(const uint8_t *src, uint32_t length, uint8_t *dst);
+void EXPORT_DMA_IRQHandler(void);
+
+
+#endif /* EXPORT_H_ */
@@ -0,0 +1,109 @@
+#ifndef GRAPH_H_
+#define GRAPH_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Block dataflow engine: nodes are added at configuration time (each one reading an earlier node),
+ * GRAPH_COMPILE groups them per source and assigns pool buffers, and every incoming block is then
+ * pushed through its source's nodes in order. Filters and decimators work in place when they are
+ * the last reader of their input; stats and detectors pass their input through without a copy. */
+#define GRAPH_MAX_NODES               16
+#define GRAPH_MAX_BUFFERS             4                 // Pool blocks shared by all sources
+#define GRAPH_BLOCK_SAMPLES           16                // Longer blocks are processed in chunks
+#define GRAPH_CHANNELS                2                 // One source node per channel
+#define GRAPH_NONE                    0xFF
+
+typedef enum
+{
+  GRAPH_SOURCE = 0,
+  GRAPH_FILTER,                                         // y += (x - y) / 2^shift
+  GRAPH_DECIMATE,                                       // Mean of every factor samples
+  GRAPH_STATS,                                          // Running min/max/mean, pass-through
+  GRAPH_DETECT,                                         // Threshold with hysteresis, pass-through
+  GRAPH_SINK                                            // Hands the block to a callback
+} GRAPH_Kind;
+
+typedef void (*GRAPH_SinkFn)(void *ctx, const uint16_t *samples, uint16_t count);
+typedef void (*GRAPH_DetectFn)(void *ctx, uint8_t active, uint16_t value);
+
+typedef struct
+{
+  uint8_t kind;
+  uint8_t input;                                        // Node read from (GRAPH_NONE for sources)
+  uint8_t root;                                         // Channel of the source feeding this node
+  uint8_t buffer;                                       // Pool buffer written (GRAPH_NONE if none)
+  union
+  {
+    struct { uint8_t channel; } source;
+    struct { uint8_t shift; uint8_t primed; int32_t acc; } filter;
+    struct { uint8_t factor; uint8_t phase; uint32_t acc; } decimate;
+    struct { uint16_t min; uint16_t max; uint32_t count; uint64_t sum; } stats;
+    struct { uint16_t high; uint16_t low; uint8_t active; GRAPH_DetectFn fn; void *ctx; } detect;
+    struct { GRAPH_SinkFn fn; void *ctx; } sink;
+  } u;
+} GRAPH_Node;
+
+typedef struct
+{
+  GRAPH_Node nodes[GRAPH_MAX_NODES];
+  uint8_t sched[GRAPH_MAX_NODES];                       // Node indices grouped by source
+  uint8_t sched_start[GRAPH_CHANNELS + 1];
+  uint8_t node_count;
+  uint8_t buffers_used;
+  uint8_t compiled;
+  uint8_t staged[GRAPH_CHANNELS];
+  uint16_t stage[GRAPH_CHANNELS][GRAPH_BLOCK_SAMPLES];  // GRAPH_PUSH_SAMPLE accumulation
+  uint16_t pool[GRAPH_MAX_BUFFERS][GRAPH_BLOCK_SAMPLES];
+} GRAPH_Graph;
+
+typedef struct
+{
+  uint16_t min;
+  uint16_t max;
+  uint16_t mean;
+  uint32_t count;
+} GRAPH_Stats;
+
+/* Running state of the nodes (accumulators, counters), without the structure or callbacks:
+ * restored with GRAPH_LOAD_STATE into a graph built the same way, e.g. after a reset */
+typedef struct
+{
+  uint8_t kind;
+  uint8_t flag;                                         // Filter primed, decimate phase, detector active
+  uint16_t min;
+  uint16_t max;
+  int32_t acc;                                          // Filter / decimate accumulator
+  uint32_t count;
+  uint64_t sum;
+} GRAPH_NodeState;
+
+typedef struct
+{
+  uint8_t node_count;
+  GRAPH_NodeState nodes[GRAPH_MAX_NODES];
+} GRAPH_State;
+
+typedef struct
+{
+  uint32_t graph_cycles;                                // Per GRAPH_BLOCK_SAMPLES block
+  uint32_t hand_cycles;                                 // Same processing written inline
+} GRAPH_Bench;
+
+
+void GRAPH_INIT(GRAPH_Graph *graph);
+int GRAPH_ADD_SOURCE(GRAPH_Graph *graph, uint8_t channel);
+int GRAPH_ADD_FILTER(GRAPH_Graph *graph, int input, uint8_t shift);
+int GRAPH_ADD_DECIMATE(GRAPH_Graph *graph, int input, uint8_t factor);
+int GRAPH_ADD_STATS(GRAPH_Graph *graph, int input);
+int GRAPH_ADD_DETECT(GRAPH_Graph *graph, int input, uint16_t high, uint16_t low, GRAPH_DetectFn fn, void *ctx);
+int GRAPH_ADD_SINK(GRAPH_Graph *graph, int input, GRAPH_SinkFn fn, void *ctx);
+int GRAPH_COMPILE(GRAPH_Graph *graph);
+void GRAPH_RUN(GRAPH_Graph *graph, uint8_t channel, const uint16_t *samples, uint16_t count);
+void GRAPH_PUSH_SAMPLE(GRAPH_Graph *graph, uint8_t channel, uint16_t sample);
+int GRAPH_READ_STATS(GRAPH_Graph *graph, int node, GRAPH_Stats *stats, uint8_t reset);
+void GRAPH_SAVE_STATE(GRAPH_Graph *graph, GRAPH_State *state);
+int GRAPH_LOAD_STATE(GRAPH_Graph *graph, const GRAPH_State *state);
+void GRAPH_BENCH(GRAPH_Bench *bench);
+
+
+#endif /* GRAPH_H_ */
@@ -0,0 +1,50 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Per-channel min/max/mean pyramid: level 0 buckets last HISTORY_BASE_MS, every level above
+ * merges HISTORY_FACTOR_n buckets of the level below (1 s, 10 s, 1 min, 10 min by default). */
+#define HISTORY_CHANNELS              2
+#define HISTORY_LEVELS                4
+#define HISTORY_DEPTH                 60                // Buckets kept per level
+#define HISTORY_BASE_MS               1000
+#define HISTORY_FACTORS               { 10, 6, 10 }     // Level n+1 bucket = factor[n] level n buckets
+
+#define HISTORY_FOOTPRINT             (sizeof(HISTORY_Level) * HISTORY_LEVELS * HISTORY_CHANNELS)
+
+typedef struct
+{
+  uint16_t min;
+  uint16_t max;
+  uint32_t count;                                       // Samples merged
+  uint32_t sum;
+} HISTORY_Bucket;
+
+typedef struct
+{
+  HISTORY_Bucket ring[HISTORY_DEPTH];                   // Closed buckets, oldest overwritten
+  HISTORY_Bucket open;                                  // Bucket being filled
+  uint16_t head;                                        // Next ring slot to write
+  uint16_t filled;                                      // Closed buckets available
+  uint16_t merged;                                      // Lower-level buckets merged into open
+} HISTORY_Level;
+
+typedef struct
+{
+  uint16_t min;
+  uint16_t max;
+  uint16_t mean;
+  uint32_t count;
+  uint32_t span_ms;                                     // Time actually covered by the answer
+} HISTORY_Summary;
+
+
+void HISTORY_INIT(void);
+void HISTORY_ADD(uint8_t channel, uint16_t value, uint32_t tick_ms);
+int HISTORY_QUERY(uint8_t channel, uint32_t window_ms, HISTORY_Summary *summary);
+uint16_t HISTORY_TREND(uint8_t channel, uint8_t level, HISTORY_Bucket *buckets, uint16_t count);
+uint32_t HISTORY_BUCKET_MS(uint8_t level);
+
+
+#endif /* HISTORY_H_ */
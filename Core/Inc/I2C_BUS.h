@@ -0,0 +1,106 @@
+#ifndef I2C_BUS_H_
+#define I2C_BUS_H_
+
+#include "stm32f4xx_hal.h"
+#include "stm32f4xx_ll_i2c.h"
+#include "DWT_DELAY.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Manager of the shared I2C2 bus. Every transaction runs under the bus lock (the LCD takes it
+ * per character, so sensor reads slot in between); register reads can also be queued, from a
+ * task or an interrupt, and are then run by the bus task in arrival order. A request that is
+ * still queued is not queued twice: a second trigger is counted as coalesced.
+ *
+ * Another master may share the bus: a transaction that loses arbitration, hits a bus error or
+ * finds the bus held is retried after a random backoff whose window doubles on every attempt
+ * (so two masters that collided pick different slots), up to I2C_BUS_RETRIES times. Attempts,
+ * losses and backoff time are counted per client to check that no client is starved. */
+#define I2C_BUS_QUEUE_DEPTH           8
+#define I2C_BUS_BURST_MAX             8                 // Bytes per queued register read
+#define I2C_BUS_TIMEOUT               10                // Max time (ms) for one transaction
+#define I2C_BUS_RETRIES               6                 // Retries after arbitration loss / busy bus
+#define I2C_BUS_BACKOFF_SLOT_US       100               // About one byte at 100 kHz
+#define I2C_BUS_BACKOFF_MAX_SLOTS     32                // Window cap (3.2 ms)
+
+/* Transaction results */
+#define I2C_BUS_OK                    0
+#define I2C_BUS_ERROR                 -1                // NACK or timeout, not retried
+#define I2C_BUS_LOST                  -2                // Arbitration lost or bus error
+#define I2C_BUS_BUSY                  -3                // Bus held by another master
+
+/* Clients, for the fairness accounting */
+#define I2C_BUS_CLIENT_LCD            0
+#define I2C_BUS_CLIENT_SENSOR         1
+#define I2C_BUS_CLIENT_SYNC           2
+#define I2C_BUS_CLIENTS               3
+
+typedef void (*I2C_BUS_DoneFn)(void *ctx, int status, const uint8_t *data, uint8_t length);
+typedef int (*I2C_BUS_TransferFn)(void *ctx);          // One attempt, returns an I2C_BUS_ result
+
+typedef struct
+{
+  uint8_t address;                                      // 8-bit (shifted) slave address
+  uint8_t reg;                                          // First register of the burst
+  uint8_t length;                                       // 1..I2C_BUS_BURST_MAX
+  volatile uint8_t queued;
+  uint8_t data[I2C_BUS_BURST_MAX];
+  uint32_t stamp;                                       // DWT cycles when queued
+  uint32_t coalesced;                                   // Triggers while already queued
+  I2C_BUS_DoneFn done;                                  // Called from the bus task
+  void *ctx;
+} I2C_BUS_Request;
+
+typedef struct
+{
+  uint32_t transactions;                                // Completed (success or not)
+  uint32_t attempts;                                    // Bus attempts, retries included
+  uint32_t lost;                                        // Arbitration losses and bus errors
+  uint32_t busy;                                        // Attempts that found the bus held
+  uint32_t failed;                                      // Transactions given up or NACKed
+  uint32_t max_attempts;                                // Worst attempts for one transaction
+  uint32_t backoff_us;                                  // Total time spent backing off
+} I2C_BUS_Stats;
+
+
+/**
+  * @brief  Waits for an I2C2 status flag during a register-level master transfer.
+  * @param  flag: SR1 flag mask (I2C_SR1_SB, I2C_SR1_ADDR, I2C_SR1_TXE or I2C_SR1_BTF).
+  * @param  start: DWT cycle count at the start of the transfer.
+  * @retval I2C_BUS_OK once the flag is set, I2C_BUS_LOST if another master won the bus,
+  *         I2C_BUS_ERROR on timeout or NACK.
+  */
+
+static inline int I2C_BUS_WAIT(uint32_t flag, uint32_t start)
+{
+  uint32_t timeout = I2C_BUS_TIMEOUT * (SystemCoreClock / 1000U);
+
+  while (!READ_BIT(I2C2->SR1, flag))
+  {
+    if (READ_BIT(I2C2->SR1, I2C_SR1_ARLO | I2C_SR1_BERR))
+      return I2C_BUS_LOST;
+    if (LL_I2C_IsActiveFlag_AF(I2C2) || (DWT_GET_CYCLES() - start > timeout))
+      return I2C_BUS_ERROR;
+  }
+  return I2C_BUS_OK;
+}
+
+
+void I2C_BUS_INIT(void);
+void I2C_BUS_LOCK(void);
+void I2C_BUS_UNLOCK(void);
+int I2C_BUS_RUN(uint8_t client, I2C_BUS_TransferFn transfer, void *ctx);
+int I2C_BUS_WRITE(uint8_t client, uint8_t address, const uint8_t *data, uint8_t length);
+int I2C_BUS_READ(uint8_t client, uint8_t address, uint8_t reg, uint8_t *data, uint8_t length);
+int I2C_BUS_SUBMIT(I2C_BUS_Request *request);
+int I2C_BUS_SUBMIT_FROM_ISR(I2C_BUS_Request *request);
+void I2C_BUS_READ_STATS(uint8_t client, I2C_BUS_Stats *stats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* I2C_BUS_H_ */
@@ -0,0 +1,44 @@
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Operator input without polling: buttons on PE2..PE4 and the encoder A line (PD12) raise EXTI
+ * interrupts; the first edge masks the lines and starts a TIM7 one-shot, and when it expires the
+ * settled levels and the TIM4 encoder count (PD12/PD13, encoder mode, counted in hardware) are
+ * compared with the last reported state. Only real changes are queued, so INPUT_WAIT only
+ * returns early when the operator did something. */
+#define INPUT_BUTTON_PORT             GPIOE
+#define INPUT_BUTTON_PINS             (GPIO_PIN_2 | GPIO_PIN_3 | GPIO_PIN_4)   // Active low
+#define INPUT_BUTTON_FIRST_PIN        2
+#define INPUT_BUTTONS                 3
+#define INPUT_ENCODER_PORT            GPIOD
+#define INPUT_ENCODER_A_PIN           GPIO_PIN_12                             // TIM4_CH1, also EXTI12
+#define INPUT_ENCODER_B_PIN           GPIO_PIN_13                             // TIM4_CH2
+#define INPUT_ENCODER_COUNTS          4                 // Counts per detent (x4 quadrature)
+#define INPUT_DEBOUNCE_MS             20
+#define INPUT_QUEUE_DEPTH             8
+#define INPUT_IRQ_PRIORITY            6
+
+typedef enum
+{
+  INPUT_PRESS = 0,
+  INPUT_RELEASE,
+  INPUT_ROTATE                                          // value = signed detents
+} INPUT_Type;
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t button;                                       // 0..INPUT_BUTTONS-1 (presses/releases)
+  int16_t value;
+} INPUT_Event;
+
+
+void INPUT_INIT(void);
+int INPUT_WAIT(INPUT_Event *event, uint32_t timeout);
+void INPUT_EXTI_CALLBACK(uint16_t pin);
+void INPUT_TIMER_IRQHandler(void);
+
+
+#endif /* INPUT_H_ */
@@ -0,0 +1,240 @@
+#ifndef LCD_HPP_
+#define LCD_HPP_
+
+/*
+ * Header-only C++17 HD44780 driver.
+ *
+ * Lcd<Transport, Geometry> resolves row offsets, cursor commands and backpack masks at compile
+ * time and inlines the frame encoding into each transport. The C driver in LCD_I2C.c is left
+ * untouched; C tasks reach this layer through the extern "C" facade in LCD_CPP.h.
+ */
+
+#include <cstdint>
+#include <type_traits>
+#include "LCD_I2C.h"
+#include "I2C_BUS.h"
+#include "DWT_DELAY.h"
+
+namespace lcd {
+
+enum class Rs : uint8_t { Cmd = LCD_RS_CMD, Data = LCD_RS_DATA };
+
+
+/* Panel geometry: DDRAM offsets of each row and the matching set-cursor commands */
+template <uint8_t Rows, uint8_t Cols>
+struct Geometry
+{
+  static_assert(Rows >= 1 && Rows <= 4, "HD44780 panels have 1 to 4 rows");
+  static constexpr uint8_t rows = Rows;
+  static constexpr uint8_t cols = Cols;
+
+  static constexpr uint8_t rowOffset(uint8_t row)
+  {
+    constexpr uint8_t offsets[4] = { 0x00, LCD_DDRAM_ROW_SECOND, 0x00 + Cols, LCD_DDRAM_ROW_SECOND + Cols };
+    return offsets[row];
+  }
+
+  static constexpr uint8_t cursorCmd(uint8_t row, uint8_t col)
+  {
+    return static_cast<uint8_t>(LCD_CMD_SET_DDRAM_ADDR | (rowOffset(row) + col));
+  }
+};
+
+using Geometry16x2 = Geometry<2, LCD_CLEAR_ROW_LENGTH>;
+static_assert(Geometry16x2::cursorCmd(0, 0) == LCD_CURSOR_ROW_FIRST, "row 0 offset");
+static_assert(Geometry16x2::cursorCmd(1, 0) == LCD_CURSOR_ROW_SECOND, "row 1 offset");
+
+
+/* PCF8574 / 74HC595 backpack encoding: the control masks are folded at compile time */
+struct Backpack
+{
+  static constexpr uint8_t enOn(Rs rs)  { return rs == Rs::Data ? RS_EN_ON_MASK : EN_BIT_MASK; }
+  static constexpr uint8_t enOff(Rs rs) { return rs == Rs::Data ? RS_BIT_MASK : RS_EN_OFF_MASK; }
+
+  static inline void encode(uint8_t value, Rs rs, uint8_t *out)
+  {
+    const uint8_t upper = value & UPPER_BITS_MASK;
+    const uint8_t lower = static_cast<uint8_t>(value << 4) & UPPER_BITS_MASK;
+    out[0] = upper | enOn(rs);
+    out[1] = upper | enOff(rs);
+    out[2] = lower | enOn(rs);
+    out[3] = lower | enOff(rs);
+  }
+};
+
+
+/* PCF8574 backpack on I2C2 */
+struct I2cBackpack
+{
+  static void init() {}
+
+  static inline void write(uint8_t value, Rs rs)
+  {
+    uint8_t frame[LCD_BUFFER_SIZE];
+    Backpack::encode(value, rs, frame);
+    I2C_BUS_WRITE(I2C_BUS_CLIENT_LCD, SLAVE_ADDRESS_LCD, frame, LCD_BUFFER_SIZE);
+  }
+
+  static void flush() {}
+};
+
+
+/* HD44780 wired to LCD_GPIO_PORT, 4-bit or 8-bit bus */
+template <unsigned Width>
+struct GpioBus
+{
+  static_assert(Width == 4 || Width == 8, "bus width must be 4 or 8");
+  static constexpr unsigned shift = (Width == 8) ? LCD_GPIO_D0_PIN_NUM : LCD_GPIO_D0_PIN_NUM + 4;
+  static constexpr uint32_t mask = ((1UL << Width) - 1UL) << shift;
+
+  static void init()
+  {
+    GPIO_InitTypeDef GPIO_InitStruct = {};
+    DWT_DELAY_INIT();
+    __HAL_RCC_GPIOE_CLK_ENABLE();
+    LCD_GPIO_PORT->BSRR = (mask | LCD_GPIO_RS_PIN | LCD_GPIO_EN_PIN) << 16;
+    GPIO_InitStruct.Pin = mask | LCD_GPIO_RS_PIN | LCD_GPIO_EN_PIN;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(LCD_GPIO_PORT, &GPIO_InitStruct);
+  }
+
+  static inline void strobe(uint8_t bits, Rs rs)
+  {
+    const uint32_t set   = (static_cast<uint32_t>(bits) << shift) & mask;
+    const uint32_t reset = mask & ~set;
+    const uint32_t rsSet = (rs == Rs::Data) ? LCD_GPIO_RS_PIN : 0U;
+    LCD_GPIO_PORT->BSRR = set | rsSet | ((reset | (LCD_GPIO_RS_PIN & ~rsSet)) << 16);
+    DWT_DELAY_NS(LCD_GPIO_SETUP_NS);
+    LCD_GPIO_PORT->BSRR = LCD_GPIO_EN_PIN;
+    DWT_DELAY_NS(LCD_GPIO_EN_PULSE_NS);
+    LCD_GPIO_PORT->BSRR = static_cast<uint32_t>(LCD_GPIO_EN_PIN) << 16;
+    DWT_DELAY_NS(LCD_GPIO_EN_PULSE_NS);
+  }
+
+  static inline void write(uint8_t value, Rs rs)
+  {
+    if constexpr (Width == 8)
+      strobe(value, rs);
+    else
+    {
+      strobe(value >> 4, rs);
+      strobe(value & 0x0F, rs);
+    }
+    const bool slow = (rs == Rs::Cmd) && (value <= LCD_CMD_RETURN_HOME);
+    DWT_DELAY_US(slow ? LCD_GPIO_HOME_EXEC_US : LCD_GPIO_EXEC_US);
+  }
+
+  static void flush() {}
+};
+
+
+/* Adapter onto whichever C transport LCD_TRANSPORT selects (used for the DMA-fed SPI backend
+ * and the LL I2C byte pump) */
+struct CTransport
+{
+  static void init() { LCD_TRANSPORT_INIT(); }
+  static inline void write(uint8_t value, Rs rs) { LCD_TRANSPORT_WRITE(value, static_cast<uint8_t>(rs)); }
+  static void flush() { LCD_TRANSPORT_FLUSH(); }
+};
+
+
+template <class Transport, class Geo = Geometry16x2>
+class Lcd
+{
+public:
+  using Geometry = Geo;
+
+  /* Same power-on sequence as LCD_INIT, 4-bit unless the transport is an 8-bit GPIO bus */
+  static void init()
+  {
+    constexpr bool eightBit = std::is_same<Transport, GpioBus<8>>::value;
+    Transport::init();
+    HAL_Delay(DELAY_50MS);
+    command(LCD_INIT_CMD_8BIT);
+    HAL_Delay(DELAY_5MS);
+    command(LCD_INIT_CMD_8BIT);
+    HAL_Delay(DELAY_1MS);
+    command(LCD_INIT_CMD_8BIT);
+    HAL_Delay(DELAY_10MS);
+    if constexpr (!eightBit)
+    {
+      command(LCD_INIT_CMD_4BIT);
+      HAL_Delay(DELAY_10MS);
+    }
+    command(eightBit ? LCD_INIT_CMD_FUNCTION_SET_8BIT : LCD_INIT_CMD_FUNCTION_SET);
+    HAL_Delay(DELAY_1MS);
+    command(LCD_INIT_CMD_DISPLAY_OFF);
+    HAL_Delay(DELAY_1MS);
+    command(LCD_INIT_CMD_CLEAR_DISPLAY);
+    HAL_Delay(DELAY_1MS);
+    HAL_Delay(DELAY_1MS);
+    command(LCD_INIT_CMD_ENTRY_MODE_SET);
+    HAL_Delay(DELAY_1MS);
+    command(LCD_INIT_CMD_DISPLAY_ON);
+    Transport::flush();
+    for (auto &row : shadow)
+      for (auto &cell : row)
+        cell = ' ';
+  }
+
+  static inline void command(uint8_t cmd) { Transport::write(cmd, Rs::Cmd); }
+  static inline void putc(char c) { Transport::write(static_cast<uint8_t>(c), Rs::Data); }
+
+  /* Compile-time position: the set-cursor command is a constant */
+  template <uint8_t Row, uint8_t Col>
+  static inline void setCursor()
+  {
+    static_assert(Row < Geometry::rows && Col < Geometry::cols, "cursor outside the panel");
+    constexpr uint8_t cmd = Geometry::cursorCmd(Row, Col);
+    command(cmd);
+  }
+
+  static inline void setCursor(uint8_t row, uint8_t col) { command(Geometry::cursorCmd(row, col)); }
+
+  static void print(const char *str)
+  {
+    while (*str)
+      putc(*str++);
+    Transport::flush();
+  }
+
+  /* Sends only the cells of the row that differ from the shadow frame */
+  template <uint8_t Row>
+  static void writeRow(const char *str)
+  {
+    static_assert(Row < Geometry::rows, "row outside the panel");
+    int next = -1;
+    for (uint8_t col = 0; col < Geometry::cols; col++)
+    {
+      const char c = *str ? *str++ : ' ';
+      if (shadow[Row][col] == c)
+        continue;
+      if (next != col)
+        setCursor(Row, col);
+      putc(c);
+      shadow[Row][col] = c;
+      next = col + 1;
+    }
+    Transport::flush();
+  }
+
+private:
+  static inline char shadow[Geometry::rows][Geometry::cols] = {};
+};
+
+
+#if (LCD_TRANSPORT == LCD_TRANSPORT_I2C) && !LCD_I2C_FAST_PATH
+using DefaultTransport = I2cBackpack;
+#elif LCD_TRANSPORT == LCD_TRANSPORT_GPIO
+using DefaultTransport = GpioBus<LCD_GPIO_BUS_WIDTH>;
+#else
+using DefaultTransport = CTransport;
+#endif
+
+using Display = Lcd<DefaultTransport, Geometry16x2>;
+
+} // namespace lcd
+
+#endif /* LCD_HPP_ */
@@ -0,0 +1,29 @@
+#ifndef LCD_CPP_H_
+#define LCD_CPP_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Set to 1 (and give the project the C++ nature) to build the C++17 driver in LCD_CPP.cpp */
+#ifndef LCD_CPP_DRIVER
+#define LCD_CPP_DRIVER                0
+#endif
+
+#define LCD_BENCH_TEXT                "0123456789ABCDEF"
+#define LCD_BENCH_ROUNDS              4
+
+
+void LCD_CPP_INIT(void);
+void LCD_CPP_SET_CURSOR(int row, int col);
+void LCD_CPP_SEND_STRING(const char *str);
+void LCD_CPP_WRITE_ROW(int row, const char *str);
+void LCD_CPP_BENCH(uint32_t *c_cycles_per_char, uint32_t *cpp_cycles_per_char);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LCD_CPP_H_ */
@@ -2,6 +2,11 @@
 #define LCD_I2C_H_
 
 #include "stm32f4xx_hal.h"
+#include "LCD_TRANSPORT.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 extern I2C_HandleTypeDef hi2c2;
 
@@ -16,6 +21,7 @@ extern I2C_HandleTypeDef hi2c2;
 #define LCD_CURSOR_ROW_FIRST          0x80
 #define LCD_CURSOR_ROW_SECOND         0xC0
 #define LCD_CLEAR_ROW_LENGTH          16
+#define LCD_ROWS                      2
 #define DELAY_50MS                    40
 #define DELAY_5MS                     5
 #define DELAY_1MS                     1
@@ -23,12 +29,19 @@ extern I2C_HandleTypeDef hi2c2;
 #define LCD_INIT_CMD_8BIT             0x30              // Commande d'initialisation 8 bits
 #define LCD_INIT_CMD_4BIT             0x20              // Commande pour activer le mode 4 bits
 #define LCD_INIT_CMD_FUNCTION_SET     0x28              // Function set
+#define LCD_INIT_CMD_FUNCTION_SET_8BIT 0x38             // Function set (8 bit bus)
 #define LCD_INIT_CMD_DISPLAY_OFF      0x08              // Display on/off control (display off)
 #define LCD_INIT_CMD_CLEAR_DISPLAY    0x01              // Clear display
 #define LCD_INIT_CMD_ENTRY_MODE_SET   0x06              // Entry mode set
 #define LCD_INIT_CMD_DISPLAY_ON       0x0C              // Display on/off control (display on)
 #define LCD_MOVE_RIGHT                0x1C
 #define LCD_MOVE_LEFT                 0x18
+#define LCD_CMD_SET_DDRAM_ADDR        0x80              // Set DDRAM address (cursor position)
+#define LCD_DDRAM_ROW_SECOND          0x40              // DDRAM address offset of the second row
+#define LCD_CMD_RETURN_HOME           0x02
+#define LCD_CMD_RETURN_HOME_X         0x01              // Don't-care bit of return home
+#define LCD_CMD_SHIFT_MASK            0xF8              // Cursor/display shift opcode and S/C bit
+#define LCD_CMD_CURSOR_SHIFT          0x10              // Cursor shift (S/C = 0)
 
 
 void LCD_SEND_CMD(char cmd);
@@ -39,6 +52,12 @@ void LCD_INIT(void);
 void LCD_SEND_STRING(char *str);
 void LCD_SCROLL_LEFT(void);
 void LCD_SCROLL_RIGHT(void);
+void LCD_WRITE_ROW(int row, const char *str);
+void LCD_I2C_BENCH(uint32_t *hal_cycles, uint32_t *ll_cycles);  // LCD_TRANSPORT_I2C builds only
+
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* LCD_I2C_H_ */
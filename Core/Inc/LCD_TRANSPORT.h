@@ -0,0 +1,62 @@
+#ifndef LCD_TRANSPORT_H_
+#define LCD_TRANSPORT_H_
+
+#include "stm32f4xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Available transports, selected at build time with -DLCD_TRANSPORT=<value> */
+#define LCD_TRANSPORT_I2C             0                 // PCF8574 backpack on I2C2
+#define LCD_TRANSPORT_GPIO            1                 // HD44780 wired directly to GPIO
+#define LCD_TRANSPORT_SPI             2                 // 74HC595 backpack on SPI1, fed by DMA
+
+#ifndef LCD_TRANSPORT
+#define LCD_TRANSPORT                 LCD_TRANSPORT_I2C
+#endif
+
+/* I2C transport: 1 drives I2C2 with the LL byte pump, 0 goes through HAL_I2C_Master_Transmit */
+#ifndef LCD_I2C_FAST_PATH
+#define LCD_I2C_FAST_PATH             1
+#endif
+
+#define LCD_RS_CMD                    0
+#define LCD_RS_DATA                   1
+
+/* GPIO parallel transport: RS/EN and the data bus share one port so a single BSRR write updates them */
+#ifndef LCD_GPIO_BUS_WIDTH
+#define LCD_GPIO_BUS_WIDTH            4                 // 4 (D4..D7 wired) or 8 (D0..D7 wired)
+#endif
+#define LCD_GPIO_PORT                 GPIOE
+#define LCD_GPIO_RS_PIN               GPIO_PIN_6
+#define LCD_GPIO_EN_PIN               GPIO_PIN_7
+#define LCD_GPIO_D0_PIN_NUM           8                 // D0 on PE8 ... D7 on PE15
+#define LCD_GPIO_SETUP_NS             60                // RS/data setup before EN rises (tAS)
+#define LCD_GPIO_EN_PULSE_NS          500               // EN high and low width (half of tcycE)
+#define LCD_GPIO_EXEC_US              40                // Execution time of most instructions
+#define LCD_GPIO_HOME_EXEC_US         1600              // Execution time of clear display / return home
+
+/* SPI transport: the 74HC595 outputs use the same pin map as the PCF8574 backpack (RS, RW, EN, BL, D4..D7).
+ * TIM1 paces the stream: each update event DMAs one backpack state into SPI1->DR, and TIM1_CH1 (PA8)
+ * raises the 595 latch (RCLK) once that byte has been shifted out. SCK is PA5, MOSI is PA7. */
+#define LCD_SPI_TIMER_CLOCK_HZ        72000000U         // TIM1 kernel clock (APB2 x2)
+#define LCD_SPI_STATE_TICKS           144               // 2 us per backpack state
+#define LCD_SPI_LATCH_TICKS           100               // Latch edge, after the byte (0.9 us at 9 MHz) is shifted
+#define LCD_SPI_STATES_PER_BYTE       20                // 4 nibble/enable states + idle padding, 40 us per byte
+#define LCD_SPI_BUFFER_BYTES          16                // LCD bytes per DMA buffer (two buffers are used)
+#define LCD_SPI_HOME_EXEC_US          1600              // Execution time of clear display / return home
+#define LCD_SPI_TIMEOUT               10                // Max time (ms) to wait for a DMA buffer to drain
+
+
+void LCD_TRANSPORT_INIT(void);
+void LCD_TRANSPORT_WRITE(uint8_t value, uint8_t rs);
+void LCD_TRANSPORT_FLUSH(void);
+void LCD_BACKPACK_ENCODE(uint8_t value, uint8_t rs, uint8_t *lcd_Buffer);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LCD_TRANSPORT_H_ */
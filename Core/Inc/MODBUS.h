@@ -0,0 +1,76 @@
+#ifndef MODBUS_H_
+#define MODBUS_H_
+
+#include "stm32f4xx_hal.h"
+#include "CHANNEL.h"
+#include "CONFIG.h"
+
+/* Modbus RTU slave on USART6 (PC6 TX, PC7 RX, PC8 RS-485 driver enable), 8E1. A request is
+ * received by DMA and ends at the first idle character time; the USART interrupt checks it
+ * and answers reads at once from a register image kept big-endian, so a read response is a
+ * copy and a CRC and no task runs. Writes (configuration, clock) are handed to MODBUS_SERVICE,
+ * which applies them in the default task and then answers. The line is half duplex:
+ * reception is off from the end of a request to the end of its response. */
+#define MODBUS_BAUDRATE               19200
+#define MODBUS_ADDRESS                1
+#define MODBUS_FRAME_MAX              256
+#define MODBUS_IRQ_PRIORITY           5
+#define MODBUS_RX_STREAM              DMA2_Stream1      // USART6_RX, channel 5
+#define MODBUS_TX_STREAM              DMA2_Stream6      // USART6_TX, channel 5
+#define MODBUS_DMA_CHANNEL            5
+#define MODBUS_DE_PORT                GPIOC
+#define MODBUS_DE_PIN                 GPIO_PIN_8
+
+/* Input registers (function 04), 32-bit values high word first */
+#define MODBUS_IR_CHANNELS            0                 // Channels in the snapshot
+#define MODBUS_IR_PASS                1                 // CHANNEL_PROCESS passes (2 registers)
+#define MODBUS_IR_UPTIME              3                 // Seconds since reset (2 registers)
+#define MODBUS_IR_LATENCY             5                 // Worst read response latency, us (2 registers)
+#define MODBUS_IR_CHANNEL_BASE        8                 // raw, filtered, scaled, flags per channel
+#define MODBUS_IR_CHANNEL_STRIDE      4
+#define MODBUS_INPUT_REGS             (MODBUS_IR_CHANNEL_BASE + MODBUS_IR_CHANNEL_STRIDE * CHANNEL_SNAPSHOT_MAX)
+
+/* Holding registers (functions 03, 06, 16) */
+#define MODBUS_HR_PERIOD              0                 // period_ms per channel
+#define MODBUS_HR_GAIN                2
+#define MODBUS_HR_OFFSET              4
+#define MODBUS_HR_LIMIT               6
+#define MODBUS_HR_FILTER_SHIFT        8
+#define MODBUS_HR_DECIMATE            9
+#define MODBUS_HR_TIME                10                // Unix time in seconds (2 registers)
+#define MODBUS_HOLDING_REGS           12
+
+/* Exception codes */
+#define MODBUS_EX_FUNCTION            0x01
+#define MODBUS_EX_ADDRESS             0x02
+#define MODBUS_EX_VALUE               0x03
+#define MODBUS_EX_FAILURE             0x04
+#define MODBUS_EX_BUSY                0x06
+
+typedef struct
+{
+  uint8_t input[2 * MODBUS_INPUT_REGS];
+  uint8_t holding[2 * MODBUS_HOLDING_REGS];
+} MODBUS_Image;
+
+typedef struct
+{
+  uint32_t frames;                                      // Addressed to us with a good CRC
+  uint32_t responses;
+  uint32_t exceptions;
+  uint32_t writes;                                      // Write requests applied
+  uint32_t crc_errors;
+  uint32_t line_errors;                                 // Parity, framing, noise, overrun
+  uint32_t other;                                       // For another slave
+  uint32_t latency_max_cycles;                          // End of request to start of a read response
+} MODBUS_Stats;
+
+
+void MODBUS_INIT(void);
+void MODBUS_SERVICE(const CONFIG_Params *params);
+uint16_t MODBUS_CRC16(const uint8_t *data, uint32_t length);
+void MODBUS_READ_STATS(MODBUS_Stats *stats);
+void MODBUS_IRQHandler(void);
+
+
+#endif /* MODBUS_H_ */
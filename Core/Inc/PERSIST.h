@@ -0,0 +1,39 @@
+#ifndef PERSIST_H_
+#define PERSIST_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Persistent records in the 4 KB backup SRAM (kept across resets, and across power loss while
+ * VBAT is supplied). Every record has two slots, each with a header carrying a sequence number
+ * and a CHECKSUM over header and data; a save goes to the older slot, so a reset in the middle
+ * of a save still leaves the previous copy. The layout follows the PERSIST_DEFINE call order. */
+#define PERSIST_BASE                  BKPSRAM_BASE
+#define PERSIST_SIZE                  0x1000U
+#define PERSIST_MAX_RECORDS           8
+#define PERSIST_MAGIC                 0x50525354U       // "PRST"
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t id;
+  uint16_t length;                                      // Data bytes following the header
+  uint32_t sequence;                                    // Higher is newer
+  uint32_t crc;                                         // CHECKSUM over header and data with crc = 0
+} PERSIST_Header;
+
+typedef struct
+{
+  uint32_t saves;
+  uint32_t restored;                                    // Records found valid by PERSIST_LOAD
+  uint32_t invalid;                                     // Records with no valid slot
+} PERSIST_Stats;
+
+
+void PERSIST_INIT(void);
+int PERSIST_DEFINE(uint16_t length);
+int PERSIST_LOAD(int id, void *data);
+int PERSIST_SAVE(int id, const void *data);
+void PERSIST_READ_STATS(PERSIST_Stats *stats);
+
+
+#endif /* PERSIST_H_ */
@@ -0,0 +1,36 @@
+#ifndef PULSE_H_
+#define PULSE_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Pulse counting and frequency measurement without per-edge interrupts:
+ * - TIM3 counts edges on ETR (PD2) in external clock mode 2; PULSE_SERVICE extends it to 64 bits.
+ * - TIM5 (32-bit) measures PA0 in PWM-input mode: every rising edge resets the counter, and a DMA
+ *   burst moves CCR1 (period) and CCR2 (high time) into a circular buffer.
+ * Tie PD2 and PA0 together to count and time the same signal. */
+#define PULSE_CAPTURE_CLOCK_HZ        72000000U         // TIM5 kernel clock (APB1 x2), no prescaler
+#define PULSE_CAPTURE_DEPTH           64                // Period/high-time pairs kept by the DMA
+#define PULSE_WINDOW_MS               1000              // Measurement window
+#define PULSE_INPUT_FILTER            0x3               // ETF / IC1F: fCK_INT, N = 8
+#define PULSE_DMA_STREAM              DMA1_Stream2      // TIM5_CH1 request
+#define PULSE_DMA_CHANNEL             6
+
+typedef struct
+{
+  uint64_t total;                                       // Edges counted since PULSE_INIT
+  uint32_t window_count;                                // Edges counted in the last window
+  uint32_t window_ms;                                   // Actual length of the last window
+  uint32_t count_freq_mhz;                              // window_count / window_ms, in mHz
+  uint32_t period_freq_mhz;                             // From the captured periods, in mHz (0: none)
+  uint16_t duty_permille;                               // High time / period of the captured periods
+  uint16_t periods;                                     // Periods averaged in the last window
+  uint32_t window;                                      // Windows completed
+} PULSE_Result;
+
+
+void PULSE_INIT(void);
+void PULSE_SERVICE(uint32_t now_ms);
+uint32_t PULSE_READ(PULSE_Result *result);
+
+
+#endif /* PULSE_H_ */
@@ -0,0 +1,161 @@
+#ifndef RTOS_FAST_H_
+#define RTOS_FAST_H_
+
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "queue.h"
+
+/* Task-context shims for the hot RTOS operations. Objects are still created through CMSIS-RTOS2
+ * (osMutexNew, osSemaphoreNew, osMessageQueueNew, osThreadNew), whose ids are the FreeRTOS
+ * handles; these calls skip the IRQ checks and argument translation of cmsis_os2.c.
+ * Only call them from tasks (the _FROM_ISR variants excepted). Timeouts are in ticks. */
+#ifndef RTOS_FAST_PATH
+#define RTOS_FAST_PATH                1                 // 0 routes every shim through CMSIS-RTOS2
+#endif
+#define RTOS_MUTEX_RECURSIVE_TAG      1U                // cmsis_os2.c tags recursive mutex ids in bit 0
+
+typedef struct
+{
+  uint32_t mutex[2];                                    // DWT cycles, { CMSIS-RTOS2, shim }
+  uint32_t semaphore[2];                                // Release + acquire
+  uint32_t notify[2];                                   // Thread flags set/wait vs notify give/take
+  uint32_t queue[2];                                    // Put + get
+} RTOS_FAST_Bench;
+
+
+#if RTOS_FAST_PATH
+
+static inline void RTOS_DELAY(uint32_t ticks)
+{
+  if (ticks)
+    vTaskDelay(ticks);
+}
+
+static inline void RTOS_DELAY_UNTIL(uint32_t *wake, uint32_t period)
+{
+  vTaskDelayUntil((TickType_t *) wake, period);
+}
+
+static inline osStatus_t RTOS_MUTEX_ACQUIRE(osMutexId_t mutex, uint32_t timeout)
+{
+  SemaphoreHandle_t handle = (SemaphoreHandle_t)((uint32_t) mutex & ~RTOS_MUTEX_RECURSIVE_TAG);
+  BaseType_t ok = ((uint32_t) mutex & RTOS_MUTEX_RECURSIVE_TAG) ? xSemaphoreTakeRecursive(handle, timeout)
+                                                                 : xSemaphoreTake(handle, timeout);
+  return (ok == pdPASS) ? osOK : (timeout ? osErrorTimeout : osErrorResource);
+}
+
+static inline osStatus_t RTOS_MUTEX_RELEASE(osMutexId_t mutex)
+{
+  SemaphoreHandle_t handle = (SemaphoreHandle_t)((uint32_t) mutex & ~RTOS_MUTEX_RECURSIVE_TAG);
+  BaseType_t ok = ((uint32_t) mutex & RTOS_MUTEX_RECURSIVE_TAG) ? xSemaphoreGiveRecursive(handle)
+                                                                 : xSemaphoreGive(handle);
+  return (ok == pdPASS) ? osOK : osErrorResource;
+}
+
+static inline osStatus_t RTOS_SEMAPHORE_ACQUIRE(osSemaphoreId_t semaphore, uint32_t timeout)
+{
+  return (xSemaphoreTake((SemaphoreHandle_t) semaphore, timeout) == pdPASS) ? osOK
+         : (timeout ? osErrorTimeout : osErrorResource);
+}
+
+static inline osStatus_t RTOS_SEMAPHORE_RELEASE(osSemaphoreId_t semaphore)
+{
+  return (xSemaphoreGive((SemaphoreHandle_t) semaphore) == pdPASS) ? osOK : osErrorResource;
+}
+
+static inline void RTOS_SEMAPHORE_RELEASE_FROM_ISR(osSemaphoreId_t semaphore)
+{
+  BaseType_t woken = pdFALSE;
+  xSemaphoreGiveFromISR((SemaphoreHandle_t) semaphore, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+static inline osStatus_t RTOS_QUEUE_PUT(osMessageQueueId_t queue, const void *msg, uint32_t timeout)
+{
+  return (xQueueSendToBack((QueueHandle_t) queue, msg, timeout) == pdPASS) ? osOK
+         : (timeout ? osErrorTimeout : osErrorResource);
+}
+
+static inline osStatus_t RTOS_QUEUE_GET(osMessageQueueId_t queue, void *msg, uint32_t timeout)
+{
+  return (xQueueReceive((QueueHandle_t) queue, msg, timeout) == pdPASS) ? osOK
+         : (timeout ? osErrorTimeout : osErrorResource);
+}
+
+#else
+
+static inline void RTOS_DELAY(uint32_t ticks)
+{
+  osDelay(ticks);
+}
+
+static inline void RTOS_DELAY_UNTIL(uint32_t *wake, uint32_t period)
+{
+  *wake += period;
+  osDelayUntil(*wake);
+}
+
+static inline osStatus_t RTOS_MUTEX_ACQUIRE(osMutexId_t mutex, uint32_t timeout)
+{
+  return osMutexAcquire(mutex, timeout);
+}
+
+static inline osStatus_t RTOS_MUTEX_RELEASE(osMutexId_t mutex)
+{
+  return osMutexRelease(mutex);
+}
+
+static inline osStatus_t RTOS_SEMAPHORE_ACQUIRE(osSemaphoreId_t semaphore, uint32_t timeout)
+{
+  return osSemaphoreAcquire(semaphore, timeout);
+}
+
+static inline osStatus_t RTOS_SEMAPHORE_RELEASE(osSemaphoreId_t semaphore)
+{
+  return osSemaphoreRelease(semaphore);
+}
+
+static inline void RTOS_SEMAPHORE_RELEASE_FROM_ISR(osSemaphoreId_t semaphore)
+{
+  osSemaphoreRelease(semaphore);
+}
+
+static inline osStatus_t RTOS_QUEUE_PUT(osMessageQueueId_t queue, const void *msg, uint32_t timeout)
+{
+  return osMessageQueuePut(queue, msg, 0, timeout);
+}
+
+static inline osStatus_t RTOS_QUEUE_GET(osMessageQueueId_t queue, void *msg, uint32_t timeout)
+{
+  return osMessageQueueGet(queue, msg, NULL, timeout);
+}
+
+#endif /* RTOS_FAST_PATH */
+
+
+/* Direct-to-task notifications (no CMSIS-RTOS2 equivalent besides thread flags, which use the
+ * same notification value: do not mix both on one task) */
+static inline void RTOS_NOTIFY(osThreadId_t thread)
+{
+  xTaskNotifyGive((TaskHandle_t) thread);
+}
+
+static inline void RTOS_NOTIFY_FROM_ISR(osThreadId_t thread)
+{
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR((TaskHandle_t) thread, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+static inline uint32_t RTOS_NOTIFY_WAIT(uint32_t timeout)
+{
+  return ulTaskNotifyTake(pdTRUE, timeout);
+}
+
+
+void RTOS_FAST_BENCH(RTOS_FAST_Bench *bench);
+
+
+#endif /* RTOS_FAST_H_ */
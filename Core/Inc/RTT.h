@@ -0,0 +1,65 @@
+#ifndef RTT_H_
+#define RTT_H_
+
+#include "stm32f4xx_hal.h"
+
+/* In-RAM ring channels read by an external agent (debug probe, OpenOCD "rtt", Tools/rtt_rx.py)
+ * without halting the core. The control block uses the SEGGER RTT layout and ID, so existing
+ * readers find it by scanning RAM or through the _SEGGER_RTT symbol. The target only moves the
+ * write index of an up channel and the read index of a down channel; the reader moves the others.
+ * A write is one or two memcpy calls and an index store. */
+#define RTT_ID                        "SEGGER RTT"
+#define RTT_UP_CHANNELS               3
+#define RTT_DOWN_CHANNELS             1
+#define RTT_TERMINAL                  0                 // Text log (up) and commands (down)
+#define RTT_TRACE                     1                 // Binary event records
+#define RTT_SAMPLES                   2                 // Binary sample records
+#define RTT_TERMINAL_SIZE             1024
+#define RTT_TRACE_SIZE                512
+#define RTT_SAMPLES_SIZE              2048
+#define RTT_DOWN_SIZE                 32
+#define RTT_STDOUT                    1                 // printf / _write go to the terminal channel
+
+/* Up channel modes when the reader falls behind (2 is the blocking mode of other RTT
+ * implementations, never used here) */
+#define RTT_MODE_SKIP                 0                 // Drop the whole write
+#define RTT_MODE_TRIM                 1                 // Write what fits
+#define RTT_MODE_OVERWRITE            3                 // Drop the oldest data instead
+
+typedef struct
+{
+  const char *name;
+  char *buffer;
+  uint32_t size;
+  volatile uint32_t wr;                                 // Next byte written
+  volatile uint32_t rd;                                 // Next byte read
+  uint32_t flags;                                       // RTT_MODE_xxx
+} RTT_Buffer;
+
+typedef struct
+{
+  char id[16];                                          // RTT_ID, written last by RTT_INIT
+  int32_t max_up;
+  int32_t max_down;
+  RTT_Buffer up[RTT_UP_CHANNELS];
+  RTT_Buffer down[RTT_DOWN_CHANNELS];
+} RTT_Control;
+
+typedef struct
+{
+  uint32_t written[RTT_UP_CHANNELS];                    // Bytes accepted
+  uint32_t dropped[RTT_UP_CHANNELS];                    // Bytes skipped, trimmed or overwritten
+} RTT_Stats;
+
+extern RTT_Control _SEGGER_RTT;
+
+
+void RTT_INIT(void);
+uint32_t RTT_WRITE(uint8_t channel, const void *data, uint32_t length);
+uint32_t RTT_WRITE_SHARED(uint8_t channel, const void *data, uint32_t length);
+uint32_t RTT_WRITE_STRING(uint8_t channel, const char *text);
+uint32_t RTT_READ(uint8_t channel, void *data, uint32_t length);
+void RTT_READ_STATS(RTT_Stats *stats);
+
+
+#endif /* RTT_H_ */
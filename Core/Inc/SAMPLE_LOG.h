@@ -0,0 +1,101 @@
+#ifndef SAMPLE_LOG_H_
+#define SAMPLE_LOG_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Flash sample log: sectors 8..11 (512 KB) used as a ring of fixed 256-byte blocks.
+ * Slot 0 of every sector holds the sector header; each other slot holds one channel block
+ * whose header carries the block time range and its min/max/sum summary.
+ * A sector erase stalls every flash read, instruction fetches included, for up to 2 s
+ * (tERASE128KB, x32); DMA and timers keep running. It is done ahead of time, once per sector,
+ * when the sector being written is half full, so the write path never waits for it. In that
+ * window PULSE loses 16-bit counter wraps above ~32 kHz, and sync beats and Modbus requests
+ * are handled late. */
+#define SAMPLE_LOG_BASE               0x08080000U       // Must match the end of FLASH in the linker script
+#define SAMPLE_LOG_FIRST_SECTOR       FLASH_SECTOR_8
+#define SAMPLE_LOG_SECTORS            4
+#define SAMPLE_LOG_SECTOR_SIZE        0x20000U
+#define SAMPLE_LOG_BLOCK_SIZE         256
+#define SAMPLE_LOG_BLOCKS_PER_SECTOR  (SAMPLE_LOG_SECTOR_SIZE / SAMPLE_LOG_BLOCK_SIZE)
+#define SAMPLE_LOG_BLOCK_SAMPLES      ((SAMPLE_LOG_BLOCK_SIZE - sizeof(SAMPLE_LOG_BlockHeader)) / sizeof(SAMPLE_LOG_Sample))
+#define SAMPLE_LOG_MAX_BLOCK_SPAN     0xFFFFU           // ms, limit of the 16-bit sample offsets
+#define SAMPLE_LOG_CHANNELS           2
+#define SAMPLE_LOG_SECTOR_MAGIC       0x534C4F47U       // "SLOG"
+#define SAMPLE_LOG_BLOCK_MAGIC        0xB10D            // 0xB10C blocks had no summary_crc
+#define SAMPLE_LOG_ERASED             0xFFFFFFFFU
+#define SAMPLE_LOG_ERASE_AHEAD_BLOCKS (SAMPLE_LOG_BLOCKS_PER_SECTOR / 2)  // Next sector erased from here
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t sequence;                                    // Increases by one each time a sector is reused
+} SAMPLE_LOG_SectorHeader;
+
+typedef struct
+{
+  uint16_t magic;
+  uint8_t channel;
+  uint8_t count;
+  uint32_t t_first;                                     // Log time of the first sample (ms)
+  uint32_t t_last;                                      // Log time of the last sample (ms)
+  uint16_t min;
+  uint16_t max;
+  uint32_t sum;
+  uint32_t summary_crc;                                 // CHECKSUM over the fields above
+  uint32_t crc;                                         // CHECKSUM over the block with crc = 0
+} SAMPLE_LOG_BlockHeader;
+
+typedef struct
+{
+  uint16_t value;
+  uint16_t dt;                                          // ms after t_first
+} SAMPLE_LOG_Sample;
+
+typedef struct
+{
+  SAMPLE_LOG_BlockHeader header;
+  SAMPLE_LOG_Sample samples[(SAMPLE_LOG_BLOCK_SIZE - sizeof(SAMPLE_LOG_BlockHeader)) / sizeof(SAMPLE_LOG_Sample)];
+} SAMPLE_LOG_Block;
+
+/* Sparse RAM index: one entry per sector */
+typedef struct
+{
+  uint32_t sequence;                                    // 0 if the sector holds no valid data
+  uint32_t t_last_first;                                // t_last of the first block
+  uint32_t t_last_last;                                 // t_last of the last block
+  uint16_t blocks;                                      // Programmed blocks (slot 1 .. blocks)
+} SAMPLE_LOG_SectorIndex;
+
+typedef struct
+{
+  uint16_t min;
+  uint16_t max;
+  uint16_t mean;
+  uint32_t count;
+  uint32_t sum;
+} SAMPLE_LOG_Point;
+
+typedef struct
+{
+  uint32_t sectors_scanned;
+  uint32_t blocks_scanned;
+  uint32_t blocks_summarized;                           // Answered from the block header alone
+  uint32_t blocks_decoded;
+  uint32_t cycles;
+} SAMPLE_LOG_QueryStats;
+
+
+void SAMPLE_LOG_INIT(void);
+void SAMPLE_LOG_APPEND(uint8_t channel, uint16_t value);
+void SAMPLE_LOG_SERVICE(void);
+uint32_t SAMPLE_LOG_NOW(void);
+uint32_t SAMPLE_LOG_TICK(uint32_t log_time);
+const SAMPLE_LOG_SectorIndex *SAMPLE_LOG_INDEX(void);
+const SAMPLE_LOG_Block *SAMPLE_LOG_BLOCK_AT(uint8_t sector, uint16_t slot);
+int SAMPLE_LOG_BLOCK_VALID(const SAMPLE_LOG_Block *block);
+int SAMPLE_LOG_SUMMARY_VALID(const SAMPLE_LOG_Block *block);
+int SAMPLE_LOG_QUERY(uint8_t channel, uint32_t t1, uint32_t t2, SAMPLE_LOG_Point *points,
+                     uint16_t count, SAMPLE_LOG_QueryStats *stats);
+
+
+#endif /* SAMPLE_LOG_H_ */
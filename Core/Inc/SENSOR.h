@@ -0,0 +1,32 @@
+#ifndef SENSOR_H_
+#define SENSOR_H_
+
+#include "I2C_BUS.h"
+
+/* External I2C sensors read on data-ready: the sensor's DRDY/ALERT output (open drain, active
+ * low) on PE0 or PE1 raises EXTI, which queues a burst read of the result registers on the bus
+ * manager; the bus task stores the value in the sensor's channel. The bus is only used when a
+ * conversion is actually available, and the DRDY-to-channel latency is measured per sensor. */
+#define SENSOR_MAX                    2
+#define SENSOR_DRDY_PORT              GPIOE
+#define SENSOR_DRDY_PINS              (GPIO_PIN_0 | GPIO_PIN_1)
+#define SENSOR_IRQ_PRIORITY           6
+
+typedef struct
+{
+  uint32_t reads;                                       // Values delivered to the channel
+  uint32_t errors;                                      // Failed bus reads
+  uint32_t coalesced;                                   // Data-ready edges while a read was queued
+  uint32_t latency_min;                                 // DWT cycles, data-ready to CHANNEL_SET
+  uint32_t latency_max;
+  uint32_t latency_avg;
+} SENSOR_Stats;
+
+
+void SENSOR_INIT(void);
+int SENSOR_REGISTER(uint8_t address, uint8_t reg, uint16_t drdy_pin, uint8_t channel);
+void SENSOR_EXTI_CALLBACK(uint16_t pin);
+int SENSOR_READ_STATS(int sensor, SENSOR_Stats *stats);
+
+
+#endif /* SENSOR_H_ */
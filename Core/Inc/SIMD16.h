@@ -0,0 +1,35 @@
+#ifndef SIMD16_H_
+#define SIMD16_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Packed halfword kernels: two int16 samples per 32-bit word through the Cortex-M4 DSP
+ * instructions (QSUB16, SMULBB/SMULTT, SSUB16 + SEL, SMLALD). Builds without the DSP extension
+ * (host checks, Cortex-M0/M3) get the equivalent C loops. Arrays need no alignment; an odd
+ * trailing sample is handled on its own. */
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#define SIMD16_PACKED                 1
+#else
+#define SIMD16_PACKED                 0
+#endif
+#define SIMD16_CAL_SHIFT              12                // Calibration gains are Q12
+
+typedef struct
+{
+  uint32_t calibrate[2];                                // DWT cycles, { packed, C }
+  uint32_t scale[2];
+  uint32_t dot[2];
+  uint32_t minmax[2];
+} SIMD16_Bench;
+
+
+void SIMD16_OFFSET(int16_t *dst, const int16_t *src, int16_t offset, uint16_t count);
+void SIMD16_SCALE(int16_t *dst, const int16_t *src, int16_t gain, uint8_t shift, uint16_t count);
+void SIMD16_CALIBRATE(int16_t *dst, const int16_t *src, const int16_t *offset, const int16_t *gain, uint16_t count);
+void SIMD16_CLAMP(int16_t *dst, const int16_t *src, int16_t lo, int16_t hi, uint16_t count);
+int64_t SIMD16_DOT(const int16_t *a, const int16_t *b, uint16_t count);
+void SIMD16_MINMAX(const int16_t *src, uint16_t count, int16_t *min, int16_t *max);
+void SIMD16_BENCH(uint16_t count, SIMD16_Bench *bench);
+
+
+#endif /* SIMD16_H_ */
@@ -0,0 +1,89 @@
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/* Seqlock snapshot of a multi-word record, in the latch form: the record is kept twice and the
+ * sequence number tells readers which copy is stable. One writer (task or ISR) publishes; any
+ * number of readers copy without locking and retry only if a publish completed meanwhile.
+ * Readers never wait on a preempted writer, so a high-priority reader cannot stall behind it.
+ * Header-only so the same code runs on the target and in host tests. */
+#if defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__)
+#define SNAPSHOT_BARRIER()            __asm volatile ("dmb" ::: "memory")
+#else
+#define SNAPSHOT_BARRIER()            __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+typedef struct
+{
+  volatile uint32_t seq;                                // Odd: copy[1] is stable, even: copy[0]
+  uint16_t size;
+  void *copy[2];
+} SNAPSHOT_Handle;
+
+
+/**
+  * @brief  Binds a snapshot to its two record buffers.
+  * @param  snap: The snapshot.
+  * @param  copy0: First buffer of size bytes.
+  * @param  copy1: Second buffer of size bytes.
+  * @param  size: Record size in bytes.
+  * @retval None
+  */
+
+static inline void SNAPSHOT_INIT(SNAPSHOT_Handle *snap, void *copy0, void *copy1, uint16_t size)
+{
+  memset(copy0, 0, size);
+  memset(copy1, 0, size);
+  snap->copy[0] = copy0;
+  snap->copy[1] = copy1;
+  snap->size = size;
+  snap->seq = 0;
+}
+
+
+/**
+  * @brief  Publishes a new record (single writer only).
+  * @param  snap: The snapshot.
+  * @param  record: The record to publish.
+  * @retval None
+  */
+
+static inline void SNAPSHOT_PUBLISH(SNAPSHOT_Handle *snap, const void *record)
+{
+  snap->seq++;                                          // Readers move to copy[1]
+  SNAPSHOT_BARRIER();
+  memcpy(snap->copy[0], record, snap->size);
+  SNAPSHOT_BARRIER();
+  snap->seq++;                                          // Readers move back to copy[0]
+  SNAPSHOT_BARRIER();
+  memcpy(snap->copy[1], record, snap->size);
+  SNAPSHOT_BARRIER();
+}
+
+
+/**
+  * @brief  Copies the latest consistent record.
+  * @param  snap: The snapshot.
+  * @param  record: Receives the record.
+  * @retval Number of attempts (1 unless a publish overlapped the copy).
+  */
+
+static inline uint32_t SNAPSHOT_READ(const SNAPSHOT_Handle *snap, void *record)
+{
+  uint32_t seq, tries = 0;
+
+  do
+  {
+    seq = snap->seq;
+    SNAPSHOT_BARRIER();
+    memcpy(record, snap->copy[seq & 1U], snap->size);
+    SNAPSHOT_BARRIER();
+    tries++;
+  } while (seq != snap->seq);
+  return tries;
+}
+
+
+#endif /* SNAPSHOT_H_ */
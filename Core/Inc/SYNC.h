@@ -0,0 +1,60 @@
+#ifndef SYNC_H_
+#define SYNC_H_
+
+#include "stm32f4xx_hal.h"
+#include "ADC_FAST.h"
+
+/* Cross-board sample alignment over I2C2. Every board runs a 1 kHz sampling grid on TIM8: its
+ * update event triggers ADC1/ADC2 (TRGO), and the RTOS tick is locked SYNC_ADC_LEAD_US after it.
+ * The end-of-conversion interrupt files every result under the tick of its grid edge, so a task
+ * woken on a tick reads the sample taken at the grid edge just before (SYNC_SAMPLE), however
+ * rarely it reads; draining every conversion also keeps the ADCs out of overrun.
+ *
+ * The master board issues a general call (address 0x00) carrying SYNC_COMMAND, a sequence number
+ * and the grid phase and tick count it latched when the command byte was acknowledged. Every
+ * other board latches its own phase and tick at the same bus event (RXNE of the command byte),
+ * steps its TIM8 by the difference (the residual skew, reported), re-locks its tick and adopts
+ * the master's tick numbering for SYNC_ALIGN_WAKE. */
+#ifndef SYNC_ROLE_MASTER
+#define SYNC_ROLE_MASTER              0                 // 1 on the one board that issues the sync
+#endif
+#ifndef SYNC_ADC_TRIGGER
+#define SYNC_ADC_TRIGGER              ADC_FAST_PATH     // ADC1/ADC2 convert on the grid (read with SYNC_SAMPLE)
+#endif
+#if SYNC_ADC_TRIGGER && !ADC_FAST_PATH
+#error "SYNC_ADC_TRIGGER needs ADC_FAST_PATH: the HAL path starts, polls and stops the ADCs itself"
+#endif
+#define SYNC_PERIOD_MS                1000              // Master: time between syncs
+#define SYNC_COMMAND                  0x5C              // Second general-call byte (0x04/0x06 are reserved)
+#define SYNC_MESSAGE_BYTES            8                 // Command, sequence, phase (2), tick (4)
+#define SYNC_GRID_US                  1000              // TIM8 period, equal to the RTOS tick
+#define SYNC_ADC_LEAD_US              100               // Conversion edge before each tick
+#define SYNC_ADC_DEPTH                16                // Grid samples kept per ADC (ticks)
+#define SYNC_TIMER_CLOCK_HZ           72000000U         // TIM8 kernel clock (APB2 x2)
+#define SYNC_IRQ_PRIORITY             2                 // Above configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY:
+                                                        // the handlers make no RTOS API calls
+
+typedef struct
+{
+  uint32_t syncs;                                       // Sync commands applied
+  uint32_t ignored;                                     // Other or truncated general calls
+  uint8_t sequence;                                     // Of the last sync
+  int32_t skew_us;                                      // Grid error found at the last sync
+  uint32_t skew_max_us;                                 // Largest |skew_us| after the first sync
+  int32_t tick_offset;                                  // Master tick - local tick
+  uint32_t adc_overruns;                                // Conversions lost (ISR held off past the next edge)
+} SYNC_Stats;
+
+
+void SYNC_INIT(void);
+int SYNC_SEND(void);
+void SYNC_SERVICE(uint32_t now_ms);
+void SYNC_ALIGN_WAKE(uint32_t *wake, uint32_t period, uint32_t *seen);
+int SYNC_SAMPLE(ADC_TypeDef *adc, uint32_t tick);
+void SYNC_READ_STATS(SYNC_Stats *stats);
+void SYNC_I2C_EV_IRQHandler(void);
+void SYNC_TIMER_IRQHandler(void);
+void SYNC_ADC_IRQHandler(void);
+
+
+#endif /* SYNC_H_ */
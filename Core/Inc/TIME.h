@@ -0,0 +1,74 @@
+#ifndef TIME_H_
+#define TIME_H_
+
+#include "stm32f4xx_hal.h"
+
+/* Wall-clock time service: the RTC (calendar + sub-second counter) is correlated with the
+ * monotonic microsecond clock (HAL tick + TIM2 count) every TIME_CORRELATE_MS, at an edge of
+ * the sub-second counter. Between correlations, monotonic timestamps are turned into Unix time
+ * with one multiply-shift for the measured rate difference, so samples never touch the RTC. */
+#define TIME_CORRELATE_MS             10000
+#define TIME_LSE_TIMEOUT_MS           1000              // Then the RTC falls back to the LSI
+#define TIME_PREDIV_A                 3                 // 32768 / 4 / 8192 = 1 Hz, 122 us sub-second steps
+#define TIME_PREDIV_S_LSE             8191
+#define TIME_PREDIV_S_LSI             7999              // Nominal 32 kHz
+#define TIME_EDGE_MAX_US              4                 // Widest accepted bracket of a sub-second edge
+#define TIME_EDGE_TRIES               8
+#define TIME_SKEW_SHIFT               2                 // Rate filter: 1/4 of each new measurement
+#define TIME_UNIX_2000                946684800U        // RTC year 0
+#define TIME_RTC_NONE                 0
+#define TIME_RTC_LSE                  1
+#define TIME_RTC_LSI                  2
+
+/* Point on the monotonic clock: HAL tick and microseconds into it */
+typedef struct
+{
+  uint32_t ms;
+  uint16_t us;
+} TIME_Mono;
+
+/* Current mapping from the monotonic clock to Unix time:
+ * wall_us = base_wall_us + d + (d * skew_q32) >> 32, with d = mono - base_mono in us */
+typedef struct
+{
+  TIME_Mono base_mono;
+  int64_t base_wall_us;
+  int32_t skew_q32;                                     // (RTC rate - monotonic rate) / monotonic rate
+  uint32_t sequence;                                    // Correlations so far, 0: no mapping yet
+} TIME_Map;
+
+typedef struct
+{
+  uint16_t year;
+  uint8_t month;                                        // 1..12
+  uint8_t day;                                          // 1..31
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+  uint8_t weekday;                                      // 1 = Monday .. 7 = Sunday
+} TIME_Civil;
+
+typedef struct
+{
+  uint32_t correlations;
+  uint32_t missed;                                      // No edge bracketed within TIME_EDGE_MAX_US
+  int32_t residual_us;                                  // Last prediction error of the previous mapping
+  uint32_t residual_max_us;
+  int32_t skew_ppb;
+  uint8_t source;                                       // TIME_RTC_xxx
+} TIME_Stats;
+
+
+void TIME_INIT(void);
+void TIME_MONO_NOW(TIME_Mono *mono);
+int TIME_SERVICE(uint32_t now);
+int TIME_SET(uint32_t unix_s);
+void TIME_READ_MAP(TIME_Map *map);
+int64_t TIME_TO_WALL_US(const TIME_Mono *mono);
+int64_t TIME_TICK_TO_WALL_MS(uint32_t tick);
+void TIME_CIVIL(uint32_t unix_s, TIME_Civil *civil);
+uint32_t TIME_UNIX(const TIME_Civil *civil);
+void TIME_READ_STATS(TIME_Stats *stats);
+
+
+#endif /* TIME_H_ */
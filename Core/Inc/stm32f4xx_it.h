@@ -54,6 +54,19 @@ void UsageFault_Handler(void);
 void DebugMon_Handler(void);
 void TIM2_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void DMA1_Stream3_IRQHandler(void);
+void DMA2_Stream0_IRQHandler(void);
+void EXTI0_IRQHandler(void);
+void EXTI1_IRQHandler(void);
+void EXTI2_IRQHandler(void);
+void EXTI3_IRQHandler(void);
+void EXTI4_IRQHandler(void);
+void EXTI15_10_IRQHandler(void);
+void TIM7_IRQHandler(void);
+void I2C2_EV_IRQHandler(void);
+void TIM8_CC_IRQHandler(void);
+void USART6_IRQHandler(void);
+void ADC_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -0,0 +1,79 @@
+#include "ADC_FAST.h"
+#include "DWT_DELAY.h"
+
+
+/**
+  * @brief  Powers an ADC up once so samples can skip the HAL start/stop sequence.
+  * @param  hadc: An ADC configured by HAL.
+  * @retval None
+  * @note   HAL_ADC_Start sets ADON and waits tSTAB on every call, and HAL_ADC_Stop clears it
+  *         again. Here the converter stays on, so the stabilization delay is paid once.
+  *         Continuous mode (set by MX_ADCx_Init) is turned off: each SWSTART must give exactly
+  *         one conversion, or EOC would already be set when ADC_FAST_READ starts waiting.
+  */
+
+void ADC_FAST_INIT(ADC_HandleTypeDef *hadc)
+{
+  DWT_DELAY_INIT();
+  CLEAR_BIT(hadc->Instance->CR2, ADC_CR2_CONT);
+  if (!LL_ADC_IsEnabled(hadc->Instance))
+  {
+    LL_ADC_Enable(hadc->Instance);
+    DWT_DELAY_US(ADC_STAB_DELAY_US);
+  }
+}
+
+
+/**
+  * @brief  Runs one software-triggered regular conversion.
+  * @param  adc: The ADC instance (enabled by ADC_FAST_INIT).
+  * @retval The conversion result, or -1 on timeout.
+  * @note   DR is read first so that an EOC left over from an earlier conversion cannot end the
+  *         wait before this one completes. No locking: the caller owns the ADC for the duration.
+  */
+
+int ADC_FAST_READ(ADC_TypeDef *adc)
+{
+  uint32_t start = DWT_GET_CYCLES();
+  uint32_t timeout = ADC_FAST_TIMEOUT_US * (SystemCoreClock / 1000000U);
+
+  (void) LL_ADC_REG_ReadConversionData32(adc);          // Clears a stale EOC
+  LL_ADC_ClearFlag_OVR(adc);
+  LL_ADC_REG_StartConversionSWStart(adc);
+  while (!LL_ADC_IsActiveFlag_EOCS(adc))
+  {
+    if (DWT_GET_CYCLES() - start > timeout)
+      return -1;
+  }
+  return (uint16_t) LL_ADC_REG_ReadConversionData32(adc);
+}
+
+
+/**
+  * @brief  Measures one sample through HAL and through the LL fast path.
+  * @param  hadc: An ADC configured by HAL and not in use by another task.
+  * @param  hal_cycles: Receives DWT cycles of HAL_ADC_Start/PollForConversion/GetValue/Stop.
+  * @param  ll_cycles: Receives DWT cycles of ADC_FAST_READ.
+  * @retval None
+  * @note   Leaves the ADC enabled, as ADC_FAST_INIT does.
+  */
+
+void ADC_FAST_BENCH(ADC_HandleTypeDef *hadc, uint32_t *hal_cycles, uint32_t *ll_cycles)
+{
+  volatile uint32_t value;
+  uint32_t start;
+
+  DWT_DELAY_INIT();
+  start = DWT_GET_CYCLES();
+  HAL_ADC_Start(hadc);
+  HAL_ADC_PollForConversion(hadc, 1000);
+  value = HAL_ADC_GetValue(hadc);
+  HAL_ADC_Stop(hadc);
+  *hal_cycles = DWT_GET_CYCLES() - start;
+
+  ADC_FAST_INIT(hadc);
+  start = DWT_GET_CYCLES();
+  value = ADC_FAST_READ(hadc->Instance);
+  *ll_cycles = DWT_GET_CYCLES() - start;
+  (void) value;
+}
@@ -0,0 +1,244 @@
+#include "ADC_TUNE.h"
+#include "ADC_FAST.h"
+#include "DWT_DELAY.h"
+#include <math.h>
+#include <string.h>
+
+static const uint16_t adc_tune_Cycles[ADC_TUNE_SAMPLE_TIMES] = { 3, 15, 28, 56, 84, 112, 144, 480 };
+typedef struct
+{
+  uint32_t cr1;
+  uint32_t cr2;
+  uint32_t sqr3;
+  uint32_t smpr1;
+  uint32_t smpr2;
+} ADC_TUNE_Saved;
+
+static ADC_TUNE_Saved adc_tune_Saved[2];                // ADC1, ADC2 state around a tuning run
+
+
+/**
+  * @brief  Settled value of an input: mean of back-to-back conversions after a first one.
+  * @param  convert: Conversion callback.
+  * @param  ctx: Callback context.
+  * @param  channel: The input.
+  * @param  sample_time: ADC_SAMPLETIME_xxx code.
+  * @retval The mean in 1/16 LSB, or -1 if a conversion failed.
+  */
+
+static int32_t ADC_TUNE_SETTLED_Q4(ADC_TUNE_ConvertFn convert, void *ctx, uint8_t channel, uint8_t sample_time)
+{
+  int32_t sum = 0;
+
+  if (convert(ctx, channel, sample_time) < 0)           // Capacitor left wherever it was
+    return -1;
+  for (uint8_t i = 0; i < ADC_TUNE_SETTLED; i++)
+  {
+    int value = convert(ctx, channel, sample_time);
+    if (value < 0)
+      return -1;
+    sum += value;
+  }
+  return (sum * 16) / ADC_TUNE_SETTLED;
+}
+
+
+/**
+  * @brief  Finds the shortest sample time of an input that meets ADC_TUNE_TARGET_LSB.
+  * @param  convert: Conversion callback (ADC_TUNE_ADC or ADC_TUNE_MODEL_CONVERT).
+  * @param  ctx: Callback context.
+  * @param  channel: ADC channel of the input.
+  * @param  kick: ADC channel the capacitor is charged from before each trial
+  *         (ADC_TUNE_REFERENCE on ADC1, another external input on ADC2).
+  * @param  result: Receives the chosen time, the error of every time tried and the rate.
+  * @retval ADC_TUNE_OK, ADC_TUNE_WEAK (480 cycles kept) or ADC_TUNE_ERROR.
+  * @note   The error of a time is |mean first conversion after the kick - settled value|,
+  *         scaled by ADC_TUNE_FULL_SCALE / swing. Times not tried are left at 0xFFFF.
+  */
+
+int ADC_TUNE_RUN(ADC_TUNE_ConvertFn convert, void *ctx, uint8_t channel, uint8_t kick, ADC_TUNE_Result *result)
+{
+  int32_t reference, settled, swing_q4;
+  int status = ADC_TUNE_WEAK;
+
+  memset(result->error_q4, 0xFF, sizeof(result->error_q4));
+  result->sample_time = ADC_TUNE_SAMPLE_TIMES - 1;
+
+  reference = ADC_TUNE_SETTLED_Q4(convert, ctx, kick, ADC_TUNE_SAMPLE_TIMES - 1);
+  settled = ADC_TUNE_SETTLED_Q4(convert, ctx, channel, ADC_TUNE_SAMPLE_TIMES - 1);
+  if ((reference < 0) || (settled < 0))
+    return ADC_TUNE_ERROR;
+  swing_q4 = (settled > reference) ? settled - reference : reference - settled;
+  result->swing = (uint16_t) (swing_q4 / 16);
+
+  if (result->swing >= ADC_TUNE_MIN_SWING)
+  {
+    for (uint8_t st = 0; st < ADC_TUNE_SAMPLE_TIMES; st++)
+    {
+      int32_t first = 0;
+      int32_t level = ADC_TUNE_SETTLED_Q4(convert, ctx, channel, st);
+      int32_t error;
+
+      if (level < 0)
+        return ADC_TUNE_ERROR;
+      for (uint8_t i = 0; i < ADC_TUNE_TRIALS; i++)
+      {
+        int value;
+        if (convert(ctx, kick, ADC_TUNE_SAMPLE_TIMES - 1) < 0)
+          return ADC_TUNE_ERROR;
+        value = convert(ctx, channel, st);
+        if (value < 0)
+          return ADC_TUNE_ERROR;
+        first += value;
+      }
+      first = (first * 16) / ADC_TUNE_TRIALS;
+      error = (first > level) ? first - level : level - first;
+      error = (error * ADC_TUNE_FULL_SCALE * 16) / swing_q4;
+      result->error_q4[st] = (uint16_t) ((error > 0xFFFE) ? 0xFFFE : error);
+      if (error <= ADC_TUNE_TARGET_LSB * 16)
+      {
+        result->sample_time = st;
+        status = ADC_TUNE_OK;
+        break;
+      }
+    }
+  }
+
+  result->rate_hz = ADC_TUNE_CLOCK() / (ADC_TUNE_CYCLES(result->sample_time) + ADC_TUNE_CONVERSION_CYCLES);
+  return status;
+}
+
+
+/**
+  * @brief  Sampling cycles of a sample time code.
+  * @param  sample_time: ADC_SAMPLETIME_xxx code (0 to 7).
+  * @retval ADC clock cycles.
+  */
+
+uint32_t ADC_TUNE_CYCLES(uint8_t sample_time)
+{
+  return adc_tune_Cycles[sample_time & 7U];
+}
+
+
+/**
+  * @brief  Returns the ADC clock.
+  * @param  None
+  * @retval PCLK2 divided by the common prescaler (ADC->CCR ADCPRE: 2, 4, 6 or 8), in Hz.
+  */
+
+uint32_t ADC_TUNE_CLOCK(void)
+{
+  return HAL_RCC_GetPCLK2Freq() / ((((ADC->CCR & ADC_CCR_ADCPRE) >> ADC_CCR_ADCPRE_Pos) + 1U) * 2U);
+}
+
+
+/**
+  * @brief  Programs the sample time of one channel.
+  * @param  adc: The ADC.
+  * @param  channel: ADC channel number (0 to 18).
+  * @param  sample_time: ADC_SAMPLETIME_xxx code.
+  * @retval None
+  * @note   Takes effect from the next conversion; the ADC can stay enabled.
+  */
+
+void ADC_TUNE_SET_SAMPLE_TIME(ADC_TypeDef *adc, uint8_t channel, uint8_t sample_time)
+{
+  if (channel < 10)
+    MODIFY_REG(adc->SMPR2, 7U << (3U * channel), (uint32_t) (sample_time & 7U) << (3U * channel));
+  else
+    MODIFY_REG(adc->SMPR1, 7U << (3U * (channel - 10U)), (uint32_t) (sample_time & 7U) << (3U * (channel - 10U)));
+}
+
+
+/**
+  * @brief  Takes an ADC over for ADC_TUNE_ADC: powered, software start, no grid interrupt, and
+  *         on ADC1 VREFINT on.
+  * @param  adc: ADC1 or ADC2.
+  * @retval None
+  * @note   The caller keeps the other ADC users out (adcMutex) until ADC_TUNE_END.
+  */
+
+void ADC_TUNE_BEGIN(ADC_TypeDef *adc)
+{
+  ADC_TUNE_Saved *saved = &adc_tune_Saved[(adc == ADC2) ? 1 : 0];
+
+  saved->cr1 = adc->CR1;
+  saved->cr2 = adc->CR2;
+  saved->sqr3 = adc->SQR3;
+  saved->smpr1 = adc->SMPR1;
+  saved->smpr2 = adc->SMPR2;
+  adc->CR1 &= ~ADC_CR1_EOCIE;                           // SYNC_ADC_IRQHandler would take the results
+  adc->CR2 &= ~(ADC_CR2_EXTEN | ADC_CR2_CONT);
+  if (!(adc->CR2 & ADC_CR2_ADON))
+  {
+    adc->CR2 |= ADC_CR2_ADON;                           // Off between HAL samples (ADC_FAST_PATH 0)
+    DWT_DELAY_US(ADC_STAB_DELAY_US);
+  }
+  if (adc == ADC1)
+  {
+    ADC->CCR |= ADC_CCR_TSVREFE;
+    DWT_DELAY_US(10);                                   // VREFINT start-up
+  }
+}
+
+
+/**
+  * @brief  Gives an ADC back in the state ADC_TUNE_BEGIN found it (power, trigger, channel,
+  *         times).
+  * @param  adc: ADC1 or ADC2.
+  * @retval None
+  */
+
+void ADC_TUNE_END(ADC_TypeDef *adc)
+{
+  const ADC_TUNE_Saved *saved = &adc_tune_Saved[(adc == ADC2) ? 1 : 0];
+
+  (void) adc->DR;
+  adc->SMPR1 = saved->smpr1;
+  adc->SMPR2 = saved->smpr2;
+  adc->SQR3 = saved->sqr3;
+  adc->CR2 = saved->cr2;
+  adc->CR1 = saved->cr1;
+}
+
+
+/**
+  * @brief  Conversion callback on an ADC (between ADC_TUNE_BEGIN and ADC_TUNE_END).
+  * @param  ctx: The ADC (ADC1 or ADC2).
+  * @param  input: ADC channel number.
+  * @param  sample_time: ADC_SAMPLETIME_xxx code.
+  * @retval The conversion result, or -1 on timeout.
+  */
+
+int ADC_TUNE_ADC(void *ctx, uint8_t input, uint8_t sample_time)
+{
+  ADC_TypeDef *adc = ctx;
+
+  ADC_TUNE_SET_SAMPLE_TIME(adc, input, sample_time);
+  adc->SQR3 = input;
+  return ADC_FAST_READ(adc);
+}
+
+
+/**
+  * @brief  Conversion callback on the RC model (ADC_TUNE_Model as ctx).
+  * @param  ctx: The model; cap carries the capacitor state from one conversion to the next.
+  * @param  input: m->input for the modelled input, any other channel for the reference.
+  * @param  sample_time: ADC_SAMPLETIME_xxx code.
+  * @retval The capacitor voltage at the end of sampling, in LSB, with the dither added.
+  * @note   Without the dither every trial would round the same way and the averages could
+  *         not resolve the sub-LSB settling error that decides between two times.
+  */
+
+int ADC_TUNE_MODEL_CONVERT(void *ctx, uint8_t input, uint8_t sample_time)
+{
+  ADC_TUNE_Model *m = ctx;
+  float target = (input == m->input) ? m->level : m->reference;
+  float ohms = ADC_TUNE_MODEL_R_ADC + ((input == m->input) ? m->source_ohms : 0.0f);
+  float t = (float) ADC_TUNE_CYCLES(sample_time) / (float) ADC_TUNE_CLOCK();
+
+  m->cap = target + (m->cap - target) * expf(-t / (ohms * ADC_TUNE_MODEL_C_ADC));
+  m->seed = m->seed * 1664525U + 1013904223U;
+  return (int) (m->cap + (float) (m->seed >> 8) / 16777216.0f);
+}
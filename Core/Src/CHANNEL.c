@@ -0,0 +1,207 @@
+#include "CHANNEL.h"
+#include "SIMD16.h"
+#include "SNAPSHOT.h"
+#include <string.h>
+
+CHANNEL_Registry channel_Registry;
+static SNAPSHOT_Handle channel_Snapshot;
+static CHANNEL_Snapshot channel_Snapshot_Copy[2];
+static uint32_t channel_Pass;
+
+
+/**
+  * @brief  Clears the registry.
+  * @param  None
+  * @retval None
+  */
+
+void CHANNEL_INIT(void)
+{
+  memset(&channel_Registry, 0, sizeof(channel_Registry));
+  SNAPSHOT_INIT(&channel_Snapshot, &channel_Snapshot_Copy[0], &channel_Snapshot_Copy[1], sizeof(CHANNEL_Snapshot));
+  channel_Pass = 0;
+}
+
+
+/**
+  * @brief  Adds a channel to the registry.
+  * @param  name: Short label (kept by reference).
+  * @param  gain: Calibration gain, Q12 (CHANNEL_GAIN_ONE = 1.0).
+  * @param  offset: Raw value subtracted before the gain.
+  * @param  limit: Raw values above this set CHANNEL_FLAG_OVERRANGE.
+  * @retval Channel index, or -1 if the registry is full.
+  */
+
+int CHANNEL_REGISTER(const char *name, int16_t gain, int16_t offset, uint16_t limit)
+{
+  uint8_t ch = channel_Registry.count;
+
+  if (ch >= CHANNEL_MAX)
+    return -1;
+
+  channel_Registry.name[ch] = name;
+  channel_Registry.gain[ch] = gain;
+  channel_Registry.offset[ch] = offset;
+  channel_Registry.limit[ch] = limit;
+  channel_Registry.flags[ch] = CHANNEL_FLAG_ENABLED;
+  channel_Registry.count = ch + 1;
+  return ch;
+}
+
+
+/**
+  * @brief  Changes the calibration of a channel.
+  * @param  channel: The channel index.
+  * @param  gain: Calibration gain, Q12.
+  * @param  offset: Raw value subtracted before the gain.
+  * @param  limit: Over-range threshold.
+  * @retval None
+  * @note   Call from the task running CHANNEL_PROCESS so a pass never mixes old and new values.
+  */
+
+void CHANNEL_CONFIGURE(uint8_t channel, int16_t gain, int16_t offset, uint16_t limit)
+{
+  if (channel >= channel_Registry.count)
+    return;
+
+  channel_Registry.gain[channel] = gain;
+  channel_Registry.offset[channel] = offset;
+  channel_Registry.limit[channel] = limit;
+}
+
+
+/**
+  * @brief  Stores a new raw value.
+  * @param  channel: The channel index.
+  * @param  raw: The raw sample.
+  * @param  tick: Time of the sample (HAL_GetTick).
+  * @retval None
+  */
+
+void CHANNEL_SET(uint8_t channel, uint16_t raw, uint32_t tick)
+{
+  if (channel >= channel_Registry.count)
+    return;
+
+  channel_Registry.raw[channel] = raw;
+  channel_Registry.timestamp[channel] = tick;
+  channel_Registry.flags[channel] |= CHANNEL_FLAG_FRESH;
+}
+
+
+/**
+  * @brief  Publishes the processed values of the first channels as one consistent record.
+  * @param  None
+  * @retval None
+  * @note   The flags are taken and FRESH cleared in one masked step, so a sample stored by
+  *         CHANNEL_SET afterwards stays marked for the next pass.
+  */
+
+static void CHANNEL_PUBLISH(void)
+{
+  CHANNEL_Registry *r = &channel_Registry;
+  CHANNEL_Snapshot record;
+  uint8_t n = (r->count < CHANNEL_SNAPSHOT_MAX) ? r->count : CHANNEL_SNAPSHOT_MAX;
+  uint32_t primask;
+
+  memset(&record, 0, sizeof(record));
+  for (uint8_t i = 0; i < n; i++)
+  {
+    record.raw[i] = r->raw[i];
+    record.filtered[i] = r->filtered[i];
+    record.scaled[i] = r->scaled[i];
+    record.timestamp[i] = r->timestamp[i];
+  }
+  primask = __get_PRIMASK();
+  __disable_irq();
+  for (uint8_t i = 0; i < n; i++)
+  {
+    record.flags[i] = r->flags[i];
+    r->flags[i] &= ~CHANNEL_FLAG_FRESH;
+  }
+  __set_PRIMASK(primask);
+  record.count = n;
+  record.pass = ++channel_Pass;
+  SNAPSHOT_PUBLISH(&channel_Snapshot, &record);
+}
+
+
+/**
+  * @brief  Runs one filter/calibration pass over every registered channel.
+  * @param  None
+  * @retval None
+  * @note   Must be called from a single task: it is the only writer of the snapshot.
+  *         Each stage is a separate linear loop over its arrays, so the cost grows with the
+  *         channel count only. The filter and the calibration take two channels per word
+  *         with packed halfword instructions where the core has the DSP extension.
+  */
+
+void CHANNEL_PROCESS(void)
+{
+  CHANNEL_Registry *r = &channel_Registry;
+  uint8_t n = (r->count + 1) & ~1U;                    // Whole words
+  uint32_t primask;
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+  uint32_t *filtered = (uint32_t *) r->filtered;
+  const uint32_t *raw = (const uint32_t *) r->raw;
+
+  for (uint8_t i = 0; i < n / 2; i++)
+    filtered[i] = __UHADD16(filtered[i], raw[i]);
+#else
+  for (uint8_t i = 0; i < n; i++)
+    r->filtered[i] = ((uint32_t) r->filtered[i] + r->raw[i]) >> 1;
+#endif
+
+  SIMD16_CALIBRATE(r->scaled, (const int16_t *) r->raw, r->offset, r->gain, n);
+
+  // CHANNEL_SET may mark a channel fresh from a higher-priority task at any point
+  for (uint8_t i = 0; i < n; i++)
+  {
+    uint8_t over = (r->raw[i] > r->limit[i]) ? CHANNEL_FLAG_OVERRANGE : 0;
+    primask = __get_PRIMASK();
+    __disable_irq();
+    r->flags[i] = (r->flags[i] & ~CHANNEL_FLAG_OVERRANGE) | over;
+    __set_PRIMASK(primask);
+  }
+
+  CHANNEL_PUBLISH();
+}
+
+
+/**
+  * @brief  Copies the latest consistent set of channel values, without locking.
+  * @param  snapshot: Receives the values.
+  * @retval Number of copy attempts (more than 1 only if CHANNEL_PROCESS ran meanwhile).
+  */
+
+uint32_t CHANNEL_READ_SNAPSHOT(CHANNEL_Snapshot *snapshot)
+{
+  return SNAPSHOT_READ(&channel_Snapshot, snapshot);
+}
+
+
+/**
+  * @brief  Restarts from the values of an earlier snapshot (e.g. kept across a reset).
+  * @param  snapshot: A snapshot from CHANNEL_READ_SNAPSHOT.
+  * @retval None
+  * @note   Call after the channels are registered and before sampling starts. Raw and
+  *         filtered values are taken over so the filter resumes warm; timestamps are
+  *         cleared (the tick restarted) and no channel is marked fresh. The pass count
+  *         continues from the snapshot.
+  */
+
+void CHANNEL_RESTORE(const CHANNEL_Snapshot *snapshot)
+{
+  CHANNEL_Registry *r = &channel_Registry;
+  uint8_t n = (snapshot->count < r->count) ? snapshot->count : r->count;
+
+  for (uint8_t i = 0; i < n; i++)
+  {
+    r->raw[i] = snapshot->raw[i];
+    r->filtered[i] = snapshot->filtered[i];
+    r->timestamp[i] = 0;
+  }
+  channel_Pass = snapshot->pass;
+  CHANNEL_PUBLISH();
+}
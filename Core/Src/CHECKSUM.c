@@ -0,0 +1,317 @@
+#include "CHECKSUM.h"
+#include "RTOS_FAST.h"
+#include "DWT_DELAY.h"
+#include <string.h>
+
+#define CHECKSUM_DMA_STREAM           DMA2_Stream0      // Memory-to-memory, DMA2 only
+#define CHECKSUM_DMA_FLAGS            (DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | \
+                                       DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0)
+
+static uint32_t checksum_Table[256];
+static osMutexId_t checksum_Mutex;
+static osSemaphoreId_t checksum_Done;
+static const osMutexAttr_t checksum_Mutex_attributes = {
+  .name = "crcMutex"
+};
+
+
+/**
+  * @brief  Advances a CRC by one byte using the 256-entry table.
+  * @param  crc: The running CRC.
+  * @param  byte: The byte to add (MSB first).
+  * @retval The updated CRC.
+  */
+
+static inline uint32_t CHECKSUM_SW_BYTE(uint32_t crc, uint8_t byte)
+{
+  return (crc << 8) ^ checksum_Table[(crc >> 24) ^ byte];
+}
+
+
+/**
+  * @brief  Advances a CRC over whole 32-bit words in software.
+  * @param  crc: The running CRC.
+  * @param  data: Pointer to the words (any alignment).
+  * @param  words: Number of words.
+  * @retval The updated CRC.
+  * @note   The CRC unit shifts a written word MSB first, so the bytes of each little-endian
+  *         word are taken from the highest address down.
+  */
+
+uint32_t CHECKSUM_SW_WORDS(uint32_t crc, const uint8_t *data, uint32_t words)
+{
+  while (words--)
+  {
+    crc = CHECKSUM_SW_BYTE(crc, data[3]);
+    crc = CHECKSUM_SW_BYTE(crc, data[2]);
+    crc = CHECKSUM_SW_BYTE(crc, data[1]);
+    crc = CHECKSUM_SW_BYTE(crc, data[0]);
+    data += 4;
+  }
+  return crc;
+}
+
+
+#if CHECKSUM_USE_HW
+
+/**
+  * @brief  Computes the word that loads a given value into a freshly reset CRC unit.
+  * @param  crc: The CRC value to restore.
+  * @retval The word to write to CRC->DR right after a reset.
+  * @note   The F4 CRC unit has no writable initial value. Writing W after a reset leaves
+  *         LFSR(0xFFFFFFFF ^ W) in DR, and the 32-step LFSR can be run backwards, so any saved
+  *         value can be reloaded with one extra word. This is what lets several contexts
+  *         share the unit incrementally.
+  */
+
+static uint32_t CHECKSUM_RESTORE_WORD(uint32_t crc)
+{
+  for (int i = 0; i < 32; i++)
+    crc = (crc & 1U) ? (((crc ^ CHECKSUM_POLY) >> 1) | 0x80000000U) : (crc >> 1);
+  return crc ^ CHECKSUM_INIT_VALUE;
+}
+
+
+/**
+  * @brief  Feeds word-aligned data to the CRC unit through DMA2 (memory to memory).
+  * @param  data: Word-aligned source.
+  * @param  words: Number of words (at most CHECKSUM_DMA_MAX_WORDS).
+  * @retval None
+  * @note   Once the scheduler runs, the calling task sleeps on a semaphore until the transfer
+  *         completes, so the CPU stays available to other tasks.
+  */
+
+static void CHECKSUM_HW_DMA(const uint32_t *data, uint32_t words)
+{
+  uint8_t rtos = (osKernelGetState() == osKernelRunning);
+  uint32_t start = HAL_GetTick();
+
+  DMA2->LIFCR = CHECKSUM_DMA_FLAGS;
+  CHECKSUM_DMA_STREAM->PAR = (uint32_t) data;
+  CHECKSUM_DMA_STREAM->M0AR = (uint32_t) &CRC->DR;
+  CHECKSUM_DMA_STREAM->NDTR = words;
+  CHECKSUM_DMA_STREAM->CR = DMA_SxCR_DIR_1 | DMA_SxCR_PINC | DMA_SxCR_PSIZE_1 | DMA_SxCR_MSIZE_1 |
+                            DMA_SxCR_PL_0 | (rtos ? DMA_SxCR_TCIE : 0) | DMA_SxCR_EN;
+
+  if (rtos)
+    RTOS_SEMAPHORE_ACQUIRE(checksum_Done, pdMS_TO_TICKS(CHECKSUM_DMA_TIMEOUT));
+  else
+    while ((CHECKSUM_DMA_STREAM->CR & DMA_SxCR_EN) && ((HAL_GetTick() - start) < CHECKSUM_DMA_TIMEOUT));
+}
+
+
+/**
+  * @brief  Advances a CRC over whole words on the CRC unit.
+  * @param  crc: The running CRC.
+  * @param  data: Pointer to the words (any alignment; DMA is used only when word-aligned).
+  * @param  words: Number of words.
+  * @retval The updated CRC.
+  */
+
+static uint32_t CHECKSUM_HW_WORDS(uint32_t crc, const uint8_t *data, uint32_t words)
+{
+  uint8_t rtos = (osKernelGetState() == osKernelRunning);
+
+  if (rtos)
+    RTOS_MUTEX_ACQUIRE(checksum_Mutex, osWaitForever);
+
+  CRC->CR = CRC_CR_RESET;
+  if (crc != CHECKSUM_INIT_VALUE)
+    CRC->DR = CHECKSUM_RESTORE_WORD(crc);
+
+  if ((((uint32_t) data & 3U) == 0) && (words >= CHECKSUM_DMA_MIN_WORDS))
+  {
+    while (words)
+    {
+      uint32_t chunk = (words > CHECKSUM_DMA_MAX_WORDS) ? CHECKSUM_DMA_MAX_WORDS : words;
+      CHECKSUM_HW_DMA((const uint32_t *) data, chunk);
+      data += chunk * 4;
+      words -= chunk;
+    }
+  }
+  else
+  {
+    while (words--)
+    {
+      CRC->DR = __UNALIGNED_UINT32_READ(data);
+      data += 4;
+    }
+  }
+  crc = CRC->DR;
+
+  if (rtos)
+    RTOS_MUTEX_RELEASE(checksum_Mutex);
+  return crc;
+}
+
+#define CHECKSUM_WORDS                CHECKSUM_HW_WORDS
+#else
+#define CHECKSUM_WORDS                CHECKSUM_SW_WORDS
+#endif /* CHECKSUM_USE_HW */
+
+
+/**
+  * @brief  Builds the software table and prepares the CRC unit and its DMA stream.
+  * @param  None
+  * @retval None
+  * @note   Call once from main before the scheduler starts.
+  */
+
+void CHECKSUM_INIT(void)
+{
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t crc = i << 24;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 0x80000000U) ? ((crc << 1) ^ CHECKSUM_POLY) : (crc << 1);
+    checksum_Table[i] = crc;
+  }
+
+#if CHECKSUM_USE_HW
+  __HAL_RCC_CRC_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+
+  CHECKSUM_DMA_STREAM->CR = 0;
+  CHECKSUM_DMA_STREAM->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_0 | DMA_SxFCR_FTH_1;
+  HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, CHECKSUM_DMA_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+
+  checksum_Mutex = osMutexNew(&checksum_Mutex_attributes);
+  checksum_Done = osSemaphoreNew(1, 0, NULL);
+#endif
+}
+
+
+/**
+  * @brief  Starts a new incremental checksum.
+  * @param  ctx: The context to initialize.
+  * @retval None
+  */
+
+void CHECKSUM_BEGIN(CHECKSUM_Ctx *ctx)
+{
+  ctx->crc = CHECKSUM_INIT_VALUE;
+  ctx->tail_len = 0;
+}
+
+
+/**
+  * @brief  Adds a block of bytes to an incremental checksum.
+  * @param  ctx: The context started with CHECKSUM_BEGIN.
+  * @param  data: Pointer to the bytes.
+  * @param  length: Number of bytes.
+  * @retval None
+  * @note   Words are formed over the concatenated stream, so the result does not depend on
+  *         how the data is split between calls. Contexts hold no hardware state and may be
+  *         interleaved freely between tasks.
+  */
+
+void CHECKSUM_UPDATE(CHECKSUM_Ctx *ctx, const void *data, uint32_t length)
+{
+  const uint8_t *bytes = data;
+  uint32_t words;
+
+  if (ctx->tail_len)
+  {
+    while (length && (ctx->tail_len < 4))
+    {
+      ctx->tail[ctx->tail_len++] = *bytes++;
+      length--;
+    }
+    if (ctx->tail_len < 4)
+      return;
+    ctx->crc = CHECKSUM_SW_WORDS(ctx->crc, ctx->tail, 1);
+    ctx->tail_len = 0;
+  }
+
+  words = length / 4;
+  if (words)
+    ctx->crc = CHECKSUM_WORDS(ctx->crc, bytes, words);
+
+  bytes += words * 4;
+  ctx->tail_len = length & 3U;
+  memcpy(ctx->tail, bytes, ctx->tail_len);
+}
+
+
+/**
+  * @brief  Completes an incremental checksum.
+  * @param  ctx: The context.
+  * @retval The checksum of all bytes passed to CHECKSUM_UPDATE.
+  */
+
+uint32_t CHECKSUM_FINISH(CHECKSUM_Ctx *ctx)
+{
+  uint32_t crc = ctx->crc;
+
+  for (uint8_t i = 0; i < ctx->tail_len; i++)
+    crc = CHECKSUM_SW_BYTE(crc, ctx->tail[i]);
+  ctx->tail_len = 0;
+  return crc;
+}
+
+
+/**
+  * @brief  Computes the checksum of one block.
+  * @param  data: Pointer to the bytes.
+  * @param  length: Number of bytes.
+  * @retval The checksum.
+  */
+
+uint32_t CHECKSUM_BLOCK(const void *data, uint32_t length)
+{
+  CHECKSUM_Ctx ctx;
+
+  CHECKSUM_BEGIN(&ctx);
+  CHECKSUM_UPDATE(&ctx, data, length);
+  return CHECKSUM_FINISH(&ctx);
+}
+
+
+/**
+  * @brief  Measures hardware and software checksum throughput.
+  * @param  length: Number of bytes to checksum, read from the start of flash.
+  * @param  hw_bytes_per_s: Receives the CRC unit throughput (0 if CHECKSUM_USE_HW is 0).
+  * @param  sw_bytes_per_s: Receives the table-driven software throughput.
+  * @retval None
+  */
+
+void CHECKSUM_BENCH(uint32_t length, uint32_t *hw_bytes_per_s, uint32_t *sw_bytes_per_s)
+{
+  const uint8_t *data = (const uint8_t *) FLASH_BASE;
+  uint32_t start, cycles;
+
+  DWT_DELAY_INIT();
+  length &= ~3U;
+
+  *hw_bytes_per_s = 0;
+#if CHECKSUM_USE_HW
+  start = DWT_GET_CYCLES();
+  CHECKSUM_HW_WORDS(CHECKSUM_INIT_VALUE, data, length / 4);
+  cycles = DWT_GET_CYCLES() - start;
+  if (cycles)
+    *hw_bytes_per_s = (uint32_t)(((uint64_t) length * SystemCoreClock) / cycles);
+#endif
+
+  start = DWT_GET_CYCLES();
+  CHECKSUM_SW_WORDS(CHECKSUM_INIT_VALUE, data, length / 4);
+  cycles = DWT_GET_CYCLES() - start;
+  *sw_bytes_per_s = cycles ? (uint32_t)(((uint64_t) length * SystemCoreClock) / cycles) : 0;
+}
+
+
+/**
+  * @brief  Signals the end of a DMA feed to the waiting task.
+  * @param  None
+  * @retval None
+  * @note   Called from DMA2_Stream0_IRQHandler.
+  */
+
+void CHECKSUM_DMA_IRQHandler(void)
+{
+  if (DMA2->LISR & (DMA_LISR_TCIF0 | DMA_LISR_TEIF0))
+  {
+    DMA2->LIFCR = CHECKSUM_DMA_FLAGS;
+    RTOS_SEMAPHORE_RELEASE_FROM_ISR(checksum_Done);
+  }
+}
@@ -0,0 +1,128 @@
+#include "CONFIG.h"
+#include <string.h>
+
+static CONFIG_Set config_Set[2];                        // Active set is config_Set[epoch & 1]
+static volatile uint32_t config_Epoch;
+static volatile uint32_t config_Seen[CONFIG_STAGES];   // Epoch each stage last entered
+static CONFIG_BuildFn config_Build;
+static uint8_t config_Editing;
+
+
+/**
+  * @brief  Activates the first configuration.
+  * @param  defaults: The initial parameters.
+  * @param  build: Builds the processing pipeline of a set (called again on every commit).
+  * @retval 0 on success, -1 if the defaults are invalid or the pipeline cannot be built.
+  * @note   Call before the stages start.
+  */
+
+int CONFIG_INIT(const CONFIG_Params *defaults, CONFIG_BuildFn build)
+{
+  memset(config_Set, 0, sizeof(config_Set));
+  memset((void *) config_Seen, 0, sizeof(config_Seen));
+  config_Epoch = 0;
+  config_Editing = 0;
+  config_Build = build;
+
+  if (CONFIG_VALIDATE(defaults) != 0)
+    return -1;
+  config_Set[0].params = *defaults;
+  return config_Build(&config_Set[0]);
+}
+
+
+/**
+  * @brief  Checks a parameter set.
+  * @param  params: The parameters.
+  * @retval 0 if valid, -1 otherwise.
+  */
+
+int CONFIG_VALIDATE(const CONFIG_Params *params)
+{
+  for (uint8_t ch = 0; ch < CONFIG_CHANNELS; ch++)
+  {
+    if ((params->period_ms[ch] < CONFIG_PERIOD_MIN_MS) || (params->period_ms[ch] > CONFIG_PERIOD_MAX_MS))
+      return -1;
+    if (params->gain[ch] <= 0)
+      return -1;
+    if (params->sample_time[ch] > ADC_SAMPLETIME_480CYCLES)
+      return -1;
+  }
+  if ((params->filter_shift < 1) || (params->filter_shift > 15) || (params->decimate < 2))
+    return -1;
+  return 0;
+}
+
+
+/**
+  * @brief  Opens the inactive set for editing, pre-filled with the active parameters.
+  * @param  None
+  * @retval The parameters to edit, or NULL while a stage still runs on the previous set.
+  * @note   Single editor. Nothing changes for the stages until CONFIG_COMMIT.
+  */
+
+CONFIG_Params *CONFIG_EDIT(void)
+{
+  uint32_t epoch = config_Epoch;
+  CONFIG_Set *next = &config_Set[(epoch + 1) & 1U];
+
+  for (uint8_t s = 0; s < CONFIG_STAGES; s++)
+    if (config_Seen[s] != epoch)
+      return NULL;                                      // Old set not reclaimed yet
+
+  next->params = config_Set[epoch & 1U].params;
+  config_Editing = 1;
+  return &next->params;
+}
+
+
+/**
+  * @brief  Validates the edited set, builds its pipeline and makes it the active one.
+  * @param  None
+  * @retval 0 on success, -1 if nothing is being edited or the set is invalid (the active set
+  *         is left untouched and the edit stays open).
+  */
+
+int CONFIG_COMMIT(void)
+{
+  uint32_t epoch = config_Epoch;
+  CONFIG_Set *next = &config_Set[(epoch + 1) & 1U];
+
+  if (!config_Editing || (CONFIG_VALIDATE(&next->params) != 0) || (config_Build(next) != 0))
+    return -1;
+
+  next->epoch = epoch + 1;
+  config_Editing = 0;
+  __DMB();                                              // Set complete before it is published
+  config_Epoch = epoch + 1;
+  return 0;
+}
+
+
+/**
+  * @brief  Returns the set a stage must use until its next block boundary.
+  * @param  stage: The calling stage (CONFIG_STAGE_x).
+  * @retval The active set.
+  * @note   Recording the epoch tells CONFIG_EDIT that the stage no longer uses older sets.
+  */
+
+CONFIG_Set *CONFIG_ENTER(uint8_t stage)
+{
+  uint32_t epoch = config_Epoch;
+
+  __DMB();
+  config_Seen[stage] = epoch;
+  return &config_Set[epoch & 1U];
+}
+
+
+/**
+  * @brief  Returns the current configuration epoch.
+  * @param  None
+  * @retval Number of commits so far.
+  */
+
+uint32_t CONFIG_EPOCH(void)
+{
+  return config_Epoch;
+}
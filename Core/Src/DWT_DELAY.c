@@ -0,0 +1,20 @@
+#include "DWT_DELAY.h"
+
+/**
+  * @brief  Enables the DWT cycle counter.
+  * @param  None
+  * @retval None
+  * @note   The trace block must be enabled in CoreDebug->DEMCR before the DWT registers
+  *         can be written. The counter is only cleared when it is first started: several
+  *         modules call this at init and others measure elapsed cycles across those calls,
+  *         so a running counter is left alone.
+  */
+
+void DWT_DELAY_INIT(void)
+{
+  if ((CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) && (DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk))
+    return;
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
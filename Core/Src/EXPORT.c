@@ -0,0 +1,335 @@
+#include "EXPORT.h"
+
+#define EXPORT_DMA_STREAM             DMA1_Stream3      // USART3_TX request
+#define EXPORT_DMA_CHANNEL            4
+#define EXPORT_DMA_FLAGS              (DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 | \
+                                       DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3)
+#define EXPORT_CRC16_INIT             0xFFFF            // CRC-16/CCITT-FALSE, poly 0x1021
+
+#if (EXPORT_RING_SIZE & (EXPORT_RING_SIZE - 1)) != 0
+#error "EXPORT_RING_SIZE must be a power of two"
+#endif
+
+static uint8_t export_Ring[EXPORT_RING_SIZE];
+static volatile uint16_t export_Head;                   // Next byte written by producers
+static volatile uint16_t export_Tail;                   // First byte not yet sent
+static volatile uint16_t export_Dma_Len;                // Bytes owned by the running DMA transfer
+static uint8_t export_Seq;
+static EXPORT_Stats export_Stats;
+static uint16_t export_Block[EXPORT_CHANNELS][EXPORT_BLOCK_SAMPLES];
+static uint8_t export_Block_Fill[EXPORT_CHANNELS];
+
+static const uint16_t export_Crc_Table[16] =
+{
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+
+/**
+  * @brief  Starts a DMA transfer for the contiguous part of the ring waiting to be sent.
+  * @param  None
+  * @retval None
+  * @note   Must be called with interrupts masked or from the DMA interrupt itself. A transfer
+  *         stops at the end of the ring; the completion interrupt starts the wrapped part.
+  */
+
+static void EXPORT_KICK(void)
+{
+  uint16_t head = export_Head;
+  uint16_t tail = export_Tail;
+
+  if (export_Dma_Len || (head == tail))
+    return;
+
+  export_Dma_Len = (head > tail) ? (head - tail) : (EXPORT_RING_SIZE - tail);
+  export_Stats.bytes_sent += export_Dma_Len;
+
+  DMA1->LIFCR = EXPORT_DMA_FLAGS;
+  EXPORT_DMA_STREAM->M0AR = (uint32_t) &export_Ring[tail];
+  EXPORT_DMA_STREAM->NDTR = export_Dma_Len;
+  EXPORT_DMA_STREAM->CR |= DMA_SxCR_EN;
+}
+
+
+/**
+  * @brief  Configures USART3 (TX only) and its DMA stream.
+  * @param  None
+  * @retval None
+  * @note   The USART and DMA are programmed at register level because the UART HAL module
+  *         is not part of this project. Only TX (PD8) is used.
+  */
+
+void EXPORT_INIT(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  __HAL_RCC_GPIOD_CLK_ENABLE();
+  __HAL_RCC_USART3_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /**USART3 GPIO Configuration
+  PD8     ------> USART3_TX
+  */
+  GPIO_InitStruct.Pin = GPIO_PIN_8;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Pull = GPIO_PULLUP;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+  GPIO_InitStruct.Alternate = GPIO_AF7_USART3;
+  HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
+
+  // USART3: 8N1, oversampling by 16, TX DMA requests
+  USART3->CR1 = 0;
+  USART3->BRR = (HAL_RCC_GetPCLK1Freq() + (EXPORT_BAUDRATE / 2)) / EXPORT_BAUDRATE;
+  USART3->CR3 = USART_CR3_DMAT;
+  USART3->CR1 = USART_CR1_UE | USART_CR1_TE;
+
+  // DMA1 Stream3 channel 4 (USART3_TX): memory to USART3->DR, byte wide, interrupt on completion
+  EXPORT_DMA_STREAM->CR = 0;
+  EXPORT_DMA_STREAM->PAR = (uint32_t) &USART3->DR;
+  EXPORT_DMA_STREAM->CR = (EXPORT_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC |
+                          DMA_SxCR_DIR_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+
+  HAL_NVIC_SetPriority(DMA1_Stream3_IRQn, EXPORT_DMA_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+}
+
+
+/**
+  * @brief  Updates a CRC-16/CCITT-FALSE with a block of bytes.
+  * @param  crc: The running CRC (EXPORT_CRC16_INIT for a new computation).
+  * @param  data: Pointer to the bytes to add.
+  * @param  length: Number of bytes.
+  * @retval The updated CRC.
+  * @note   A 16-entry nibble table keeps the flash footprint at 32 bytes.
+  */
+
+uint16_t EXPORT_CRC16(uint16_t crc, const uint8_t *data, uint32_t length)
+{
+  while (length--)
+  {
+    crc ^= (uint16_t)(*data++) << 8;
+    crc = (crc << 4) ^ export_Crc_Table[crc >> 12];
+    crc = (crc << 4) ^ export_Crc_Table[crc >> 12];
+  }
+  return crc;
+}
+
+
+/**
+  * @brief  COBS-encodes a buffer and appends the 0x00 frame delimiter.
+  * @param  src: Bytes to encode.
+  * @param  length: Number of bytes to encode.
+  * @param  dst: Destination, at least length + length / 254 + 2 bytes.
+  * @retval Number of bytes written to dst, delimiter included.
+  */
+
+uint32_t EXPORT_COBS_ENCODE(const uint8_t *src, uint32_t length, uint8_t *dst)
+{
+  uint32_t code_pos = 0;
+  uint32_t out = 1;
+  uint8_t code = 1;
+
+  for (uint32_t i = 0; i < length; i++)
+  {
+    if (src[i])
+    {
+      dst[out++] = src[i];
+      code++;
+    }
+    if (!src[i] || (code == 0xFF))
+    {
+      dst[code_pos] = code;
+      code_pos = out++;
+      code = 1;
+    }
+  }
+  dst[code_pos] = code;
+  dst[out++] = 0x00;
+  return out;
+}
+
+
+/**
+  * @brief  Returns the free space in the TX ring.
+  * @param  None
+  * @retval Number of bytes that can be queued without dropping.
+  */
+
+uint16_t EXPORT_FREE_SPACE(void)
+{
+  return (EXPORT_RING_SIZE - 1) - ((export_Head - export_Tail) & (EXPORT_RING_SIZE - 1));
+}
+
+
+/**
+  * @brief  Numbers a payload, adds the CRC, frames it and queues it for transmission.
+  * @param  payload: The payload, sequence byte left blank, with EXPORT_CRC_SIZE bytes of room
+  *         after it.
+  * @param  length: Payload length without the CRC.
+  * @retval EXPORT_OK if the frame was queued, EXPORT_DROPPED if the ring had no room.
+  * @note   Numbering, CRC, framing and the copy into the ring run with interrupts masked
+  *         (about 1000 cycles for a full block), so frames pushed by several tasks enter the
+  *         ring in sequence order. A dropped frame still uses up its number: the receiver
+  *         sees the gap, never a truncated frame.
+  */
+
+static int EXPORT_QUEUE(uint8_t *payload, uint32_t length)
+{
+  uint8_t frame[EXPORT_FRAME_MAX];
+  uint32_t frame_len, primask;
+  uint16_t crc, used;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  payload[1] = export_Seq++;
+  crc = EXPORT_CRC16(EXPORT_CRC16_INIT, payload, length);
+  payload[length++] = crc;
+  payload[length++] = crc >> 8;
+  frame_len = EXPORT_COBS_ENCODE(payload, length, frame);
+
+  if (frame_len > EXPORT_FREE_SPACE())
+  {
+    export_Stats.frames_dropped++;
+    __set_PRIMASK(primask);
+    return EXPORT_DROPPED;
+  }
+
+  for (uint32_t i = 0; i < frame_len; i++)
+  {
+    export_Ring[export_Head] = frame[i];
+    export_Head = (export_Head + 1) & (EXPORT_RING_SIZE - 1);
+  }
+  export_Stats.frames_sent++;
+  used = (export_Head - export_Tail) & (EXPORT_RING_SIZE - 1);
+  if (used > export_Stats.ring_peak)
+    export_Stats.ring_peak = used;
+  EXPORT_KICK();
+
+  __set_PRIMASK(primask);
+  return EXPORT_OK;
+}
+
+
+/**
+  * @brief  Frames a block of samples and queues it for transmission.
+  * @param  channel: The channel the samples belong to.
+  * @param  samples: Pointer to the samples.
+  * @param  count: Number of samples (1 to EXPORT_BLOCK_SAMPLES).
+  * @retval EXPORT_OK if the frame was queued, EXPORT_DROPPED if the ring had no room.
+  */
+
+int EXPORT_PUSH_BLOCK(uint8_t channel, const uint16_t *samples, uint8_t count)
+{
+  uint8_t payload[EXPORT_PAYLOAD_MAX];
+  uint32_t tick = HAL_GetTick();
+  uint32_t length;
+
+  if (count > EXPORT_BLOCK_SAMPLES)
+    count = EXPORT_BLOCK_SAMPLES;
+
+  payload[0] = EXPORT_FRAME_SAMPLE_BLOCK;
+  payload[1] = 0;                                       // Sequence, set by EXPORT_QUEUE
+  payload[2] = channel;
+  payload[3] = count;
+  payload[4] = tick;
+  payload[5] = tick >> 8;
+  payload[6] = tick >> 16;
+  payload[7] = tick >> 24;
+  length = EXPORT_HEADER_SIZE;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    payload[length++] = samples[i];
+    payload[length++] = samples[i] >> 8;
+  }
+  return EXPORT_QUEUE(payload, length);
+}
+
+
+/**
+  * @brief  Queues a time frame mapping block ticks to Unix time.
+  * @param  tick: Tick of the reference point.
+  * @param  us: Microseconds into that tick.
+  * @param  wall_us: Unix time of the reference point in microseconds.
+  * @param  skew_q32: Rate correction, wall = wall_us + d + (d * skew_q32 >> 32) for d us later.
+  * @retval EXPORT_OK if the frame was queued, EXPORT_DROPPED if the ring had no room.
+  * @note   Sent on every correlation; the receiver applies the latest one to the tick of the
+  *         sample blocks that follow.
+  */
+
+int EXPORT_PUSH_TIME(uint32_t tick, uint16_t us, int64_t wall_us, int32_t skew_q32)
+{
+  uint8_t payload[EXPORT_HEADER_SIZE + EXPORT_TIME_SIZE + EXPORT_CRC_SIZE];
+  uint32_t length = 0;
+
+  payload[length++] = EXPORT_FRAME_TIME;
+  payload[length++] = 0;                                // Sequence, set by EXPORT_QUEUE
+  payload[length++] = 0;
+  payload[length++] = 0;
+  for (uint8_t i = 0; i < 4; i++)
+    payload[length++] = tick >> (8 * i);
+  payload[length++] = us;
+  payload[length++] = us >> 8;
+  for (uint8_t i = 0; i < 8; i++)
+    payload[length++] = (uint64_t) wall_us >> (8 * i);
+  for (uint8_t i = 0; i < 4; i++)
+    payload[length++] = (uint32_t) skew_q32 >> (8 * i);
+  return EXPORT_QUEUE(payload, length);
+}
+
+
+/**
+  * @brief  Accumulates one sample and pushes a frame once EXPORT_BLOCK_SAMPLES are collected.
+  * @param  channel: The channel index (0 to EXPORT_CHANNELS - 1).
+  * @param  sample: The sample value.
+  * @retval None
+  * @note   Each channel must be fed from a single task.
+  */
+
+void EXPORT_PUSH_SAMPLE(uint8_t channel, uint16_t sample)
+{
+  if (channel >= EXPORT_CHANNELS)
+    return;
+
+  export_Block[channel][export_Block_Fill[channel]++] = sample;
+  if (export_Block_Fill[channel] == EXPORT_BLOCK_SAMPLES)
+  {
+    EXPORT_PUSH_BLOCK(channel, export_Block[channel], EXPORT_BLOCK_SAMPLES);
+    export_Block_Fill[channel] = 0;
+  }
+}
+
+
+/**
+  * @brief  Copies the exporter counters.
+  * @param  stats: Destination of the counters.
+  * @retval None
+  */
+
+void EXPORT_GET_STATS(EXPORT_Stats *stats)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  *stats = export_Stats;
+  __set_PRIMASK(primask);
+}
+
+
+/**
+  * @brief  Handles the end of a DMA transfer: releases the sent bytes and starts the next chunk.
+  * @param  None
+  * @retval None
+  * @note   Called from DMA1_Stream3_IRQHandler.
+  */
+
+void EXPORT_DMA_IRQHandler(void)
+{
+  if (DMA1->LISR & (DMA_LISR_TCIF3 | DMA_LISR_TEIF3))
+  {
+    DMA1->LIFCR = EXPORT_DMA_FLAGS;
+    export_Tail = (export_Tail + export_Dma_Len) & (EXPORT_RING_SIZE - 1);
+    export_Dma_Len = 0;
+    EXPORT_KICK();
+  }
+}
@@ -0,0 +1,630 @@
+#include "GRAPH.h"
+#include "DWT_DELAY.h"
+#include <string.h>
+
+
+/**
+  * @brief  Resets a graph to the empty, unconfigured state.
+  * @param  graph: The graph.
+  * @retval None
+  */
+
+void GRAPH_INIT(GRAPH_Graph *graph)
+{
+  memset(graph, 0, sizeof(*graph));
+}
+
+
+/**
+  * @brief  Appends a node reading from an existing node.
+  * @param  graph: The graph.
+  * @param  kind: The node kind.
+  * @param  input: Index of the node read from.
+  * @retval The new node, or NULL if the graph is full, compiled or input is invalid.
+  */
+
+static GRAPH_Node *GRAPH_ADD(GRAPH_Graph *graph, GRAPH_Kind kind, int input)
+{
+  GRAPH_Node *node;
+
+  if (graph->compiled || (graph->node_count >= GRAPH_MAX_NODES) || (input < 0) || (input >= graph->node_count))
+    return NULL;
+
+  node = &graph->nodes[graph->node_count++];
+  memset(node, 0, sizeof(*node));
+  node->kind = kind;
+  node->input = input;
+  node->root = graph->nodes[input].root;
+  node->buffer = GRAPH_NONE;
+  return node;
+}
+
+
+/**
+  * @brief  Adds the source node of a channel.
+  * @param  graph: The graph.
+  * @param  channel: The channel (one source per channel).
+  * @retval Node index, or -1 on error.
+  */
+
+int GRAPH_ADD_SOURCE(GRAPH_Graph *graph, uint8_t channel)
+{
+  GRAPH_Node *node;
+
+  if (graph->compiled || (graph->node_count >= GRAPH_MAX_NODES) || (channel >= GRAPH_CHANNELS))
+    return -1;
+  for (uint8_t i = 0; i < graph->node_count; i++)
+    if ((graph->nodes[i].kind == GRAPH_SOURCE) && (graph->nodes[i].root == channel))
+      return -1;
+
+  node = &graph->nodes[graph->node_count++];
+  memset(node, 0, sizeof(*node));
+  node->kind = GRAPH_SOURCE;
+  node->input = GRAPH_NONE;
+  node->root = channel;
+  node->buffer = GRAPH_NONE;
+  node->u.source.channel = channel;
+  return graph->node_count - 1;
+}
+
+
+/**
+  * @brief  Adds a first-order low-pass (exponential moving average) filter.
+  * @param  graph: The graph.
+  * @param  input: Node to filter.
+  * @param  shift: Smoothing, y += (x - y) / 2^shift (1..15).
+  * @retval Node index, or -1 on error.
+  */
+
+int GRAPH_ADD_FILTER(GRAPH_Graph *graph, int input, uint8_t shift)
+{
+  GRAPH_Node *node;
+
+  if ((shift < 1) || (shift > 15) || !(node = GRAPH_ADD(graph, GRAPH_FILTER, input)))
+    return -1;
+  node->u.filter.shift = shift;
+  return graph->node_count - 1;
+}
+
+
+/**
+  * @brief  Adds a decimator emitting the mean of every factor input samples.
+  * @param  graph: The graph.
+  * @param  input: Node to decimate.
+  * @param  factor: Decimation factor (2..255).
+  * @retval Node index, or -1 on error.
+  */
+
+int GRAPH_ADD_DECIMATE(GRAPH_Graph *graph, int input, uint8_t factor)
+{
+  GRAPH_Node *node;
+
+  if ((factor < 2) || !(node = GRAPH_ADD(graph, GRAPH_DECIMATE, input)))
+    return -1;
+  node->u.decimate.factor = factor;
+  return graph->node_count - 1;
+}
+
+
+/**
+  * @brief  Adds a running min/max/mean accumulator, read with GRAPH_READ_STATS.
+  * @param  graph: The graph.
+  * @param  input: Node to measure.
+  * @retval Node index, or -1 on error.
+  */
+
+int GRAPH_ADD_STATS(GRAPH_Graph *graph, int input)
+{
+  GRAPH_Node *node;
+
+  if (!(node = GRAPH_ADD(graph, GRAPH_STATS, input)))
+    return -1;
+  node->u.stats.min = 0xFFFF;
+  return graph->node_count - 1;
+}
+
+
+/**
+  * @brief  Adds a threshold detector with hysteresis.
+  * @param  graph: The graph.
+  * @param  input: Node to watch.
+  * @param  high: Level at or above which the detector becomes active.
+  * @param  low: Level at or below which it becomes inactive again (low < high).
+  * @param  fn: Called on every state change (may be NULL).
+  * @param  ctx: Passed to fn.
+  * @retval Node index, or -1 on error.
+  */
+
+int GRAPH_ADD_DETECT(GRAPH_Graph *graph, int input, uint16_t high, uint16_t low, GRAPH_DetectFn fn, void *ctx)
+{
+  GRAPH_Node *node;
+
+  if ((low >= high) || !(node = GRAPH_ADD(graph, GRAPH_DETECT, input)))
+    return -1;
+  node->u.detect.high = high;
+  node->u.detect.low = low;
+  node->u.detect.fn = fn;
+  node->u.detect.ctx = ctx;
+  return graph->node_count - 1;
+}
+
+
+/**
+  * @brief  Adds a sink handing every block to a callback.
+  * @param  graph: The graph.
+  * @param  input: Node to consume.
+  * @param  fn: Called with each non-empty block; the samples are only valid during the call.
+  * @param  ctx: Passed to fn.
+  * @retval Node index, or -1 on error.
+  */
+
+int GRAPH_ADD_SINK(GRAPH_Graph *graph, int input, GRAPH_SinkFn fn, void *ctx)
+{
+  GRAPH_Node *node;
+
+  if (!fn || !(node = GRAPH_ADD(graph, GRAPH_SINK, input)))
+    return -1;
+  node->u.sink.fn = fn;
+  node->u.sink.ctx = ctx;
+  return graph->node_count - 1;
+}
+
+
+/**
+  * @brief  Schedules the nodes and assigns pool buffers.
+  * @param  graph: The graph.
+  * @retval 0 on success, -1 if the pool is too small.
+  * @note   Nodes always read an earlier node, so insertion order is a topological order. Nodes
+  *         are grouped per source so a block only walks its own channel's nodes, and each group
+  *         gets its own buffers so channels may run from different tasks.
+  *         Only filters and decimators produce new data; stats, detectors and sinks forward
+  *         their input. A producer that is the last reader of a pool buffer overwrites it in
+  *         place, and a buffer returns to the free list after its last reader has run.
+  *         Source data (the caller's block) is never written.
+  */
+
+int GRAPH_COMPILE(GRAPH_Graph *graph)
+{
+  uint8_t value[GRAPH_MAX_NODES];                       // Producer whose data a node outputs
+  uint8_t last[GRAPH_MAX_NODES];                        // Last node reading a producer's data
+  uint8_t owner[GRAPH_MAX_BUFFERS];                     // Producer held in a buffer
+  uint8_t n = 0;
+
+  graph->compiled = 0;
+  for (uint8_t ch = 0; ch < GRAPH_CHANNELS; ch++)
+  {
+    graph->sched_start[ch] = n;
+    for (uint8_t i = 0; i < graph->node_count; i++)
+      if (graph->nodes[i].root == ch)
+        graph->sched[n++] = i;
+  }
+  graph->sched_start[GRAPH_CHANNELS] = n;
+
+  for (uint8_t i = 0; i < graph->node_count; i++)
+  {
+    GRAPH_Node *node = &graph->nodes[i];
+    uint8_t produces = (node->kind == GRAPH_SOURCE) || (node->kind == GRAPH_FILTER) || (node->kind == GRAPH_DECIMATE);
+
+    value[i] = produces ? i : value[node->input];
+    last[i] = i;
+    if (node->input != GRAPH_NONE)
+      last[value[node->input]] = i;
+  }
+
+  memset(owner, GRAPH_NONE, sizeof(owner));
+  graph->buffers_used = 0;
+  for (uint8_t ch = 0; ch < GRAPH_CHANNELS; ch++)
+  {
+    uint8_t base = graph->buffers_used;
+
+    for (uint8_t k = graph->sched_start[ch]; k < graph->sched_start[ch + 1]; k++)
+    {
+      uint8_t i = graph->sched[k];
+      GRAPH_Node *node = &graph->nodes[i];
+
+      node->buffer = GRAPH_NONE;
+      if ((node->kind == GRAPH_FILTER) || (node->kind == GRAPH_DECIMATE))
+      {
+        uint8_t u = value[node->input];
+
+        if ((graph->nodes[u].kind != GRAPH_SOURCE) && (last[u] == i))
+          node->buffer = graph->nodes[u].buffer;        // In place
+        else
+        {
+          for (uint8_t b = base; b < graph->buffers_used; b++)
+            if (owner[b] == GRAPH_NONE)
+            {
+              node->buffer = b;
+              break;
+            }
+          if (node->buffer == GRAPH_NONE)
+          {
+            if (graph->buffers_used >= GRAPH_MAX_BUFFERS)
+              return -1;
+            node->buffer = graph->buffers_used++;
+          }
+        }
+        owner[node->buffer] = i;
+      }
+
+      for (uint8_t b = base; b < graph->buffers_used; b++)
+        if ((owner[b] != GRAPH_NONE) && (last[owner[b]] == i))
+          owner[b] = GRAPH_NONE;
+    }
+  }
+
+  graph->compiled = 1;
+  return 0;
+}
+
+
+/**
+  * @brief  Pushes a block of one channel through its nodes.
+  * @param  graph: The compiled graph.
+  * @param  channel: The source channel.
+  * @param  samples: The block (read only, e.g. a DMA half-buffer).
+  * @param  count: Number of samples.
+  * @retval None
+  */
+
+void GRAPH_RUN(GRAPH_Graph *graph, uint8_t channel, const uint16_t *samples, uint16_t count)
+{
+  const uint16_t *data[GRAPH_MAX_NODES];
+  uint16_t length[GRAPH_MAX_NODES];
+
+  if (!graph->compiled || (channel >= GRAPH_CHANNELS))
+    return;
+
+  while (count)
+  {
+    uint16_t n = (count > GRAPH_BLOCK_SAMPLES) ? GRAPH_BLOCK_SAMPLES : count;
+
+    for (uint8_t k = graph->sched_start[channel]; k < graph->sched_start[channel + 1]; k++)
+    {
+      uint8_t i = graph->sched[k];
+      GRAPH_Node *node = &graph->nodes[i];
+      const uint16_t *in;
+      uint16_t *out;
+      uint16_t m;
+
+      if (node->kind == GRAPH_SOURCE)
+      {
+        data[i] = samples;
+        length[i] = n;
+        continue;
+      }
+      in = data[node->input];
+      m = length[node->input];
+      out = (node->buffer != GRAPH_NONE) ? graph->pool[node->buffer] : NULL;
+
+      switch (node->kind)
+      {
+        case GRAPH_FILTER:
+        {
+          uint8_t shift = node->u.filter.shift;
+          int32_t acc = node->u.filter.acc;
+
+          if (!node->u.filter.primed && m)
+          {
+            acc = (int32_t) in[0] << shift;
+            node->u.filter.primed = 1;
+          }
+          for (uint16_t j = 0; j < m; j++)
+          {
+            acc += in[j] - (acc >> shift);
+            out[j] = acc >> shift;
+          }
+          node->u.filter.acc = acc;
+          data[i] = out;
+          length[i] = m;
+          continue;
+        }
+
+        case GRAPH_DECIMATE:
+        {
+          uint8_t factor = node->u.decimate.factor;
+          uint8_t phase = node->u.decimate.phase;
+          uint32_t acc = node->u.decimate.acc;
+          uint16_t o = 0;
+
+          for (uint16_t j = 0; j < m; j++)
+          {
+            acc += in[j];
+            if (++phase == factor)
+            {
+              out[o++] = acc / factor;                  // o <= j, so in place is safe
+              acc = 0;
+              phase = 0;
+            }
+          }
+          node->u.decimate.phase = phase;
+          node->u.decimate.acc = acc;
+          data[i] = out;
+          length[i] = o;
+          continue;
+        }
+
+        case GRAPH_STATS:
+          if (m)
+          {
+            uint16_t min = 0xFFFF, max = 0;
+            uint32_t sum = 0, primask;
+
+            for (uint16_t j = 0; j < m; j++)
+            {
+              if (in[j] < min) min = in[j];
+              if (in[j] > max) max = in[j];
+              sum += in[j];
+            }
+            primask = __get_PRIMASK();
+            __disable_irq();
+            if (min < node->u.stats.min) node->u.stats.min = min;
+            if (max > node->u.stats.max) node->u.stats.max = max;
+            node->u.stats.count += m;
+            node->u.stats.sum += sum;
+            __set_PRIMASK(primask);
+          }
+          break;
+
+        case GRAPH_DETECT:
+          for (uint16_t j = 0; j < m; j++)
+          {
+            uint8_t active = node->u.detect.active;
+
+            if ((!active && (in[j] >= node->u.detect.high)) || (active && (in[j] <= node->u.detect.low)))
+            {
+              node->u.detect.active = !active;
+              if (node->u.detect.fn)
+                node->u.detect.fn(node->u.detect.ctx, !active, in[j]);
+            }
+          }
+          break;
+
+        case GRAPH_SINK:
+          if (m)
+            node->u.sink.fn(node->u.sink.ctx, in, m);
+          break;
+
+        default:
+          break;
+      }
+
+      data[i] = in;                                     // Pass-through nodes forward their input
+      length[i] = m;
+    }
+
+    samples += n;
+    count -= n;
+  }
+}
+
+
+/**
+  * @brief  Adds one sample to a channel, running the graph every GRAPH_BLOCK_SAMPLES samples.
+  * @param  graph: The compiled graph.
+  * @param  channel: The source channel.
+  * @param  sample: The sample.
+  * @retval None
+  */
+
+void GRAPH_PUSH_SAMPLE(GRAPH_Graph *graph, uint8_t channel, uint16_t sample)
+{
+  if (channel >= GRAPH_CHANNELS)
+    return;
+
+  graph->stage[channel][graph->staged[channel]++] = sample;
+  if (graph->staged[channel] == GRAPH_BLOCK_SAMPLES)
+  {
+    GRAPH_RUN(graph, channel, graph->stage[channel], GRAPH_BLOCK_SAMPLES);
+    graph->staged[channel] = 0;
+  }
+}
+
+
+/**
+  * @brief  Reads the accumulated statistics of a stats node.
+  * @param  graph: The graph.
+  * @param  node: Index of a GRAPH_STATS node.
+  * @param  stats: Receives min/max/mean/count (all 0 if nothing was seen).
+  * @param  reset: Non-zero to restart the accumulation.
+  * @retval 0 on success, -1 if node is not a stats node.
+  */
+
+int GRAPH_READ_STATS(GRAPH_Graph *graph, int node, GRAPH_Stats *stats, uint8_t reset)
+{
+  GRAPH_Node *n;
+  uint64_t sum;
+  uint32_t primask;
+
+  if ((node < 0) || (node >= graph->node_count) || (graph->nodes[node].kind != GRAPH_STATS))
+    return -1;
+  n = &graph->nodes[node];
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  stats->min = n->u.stats.min;
+  stats->max = n->u.stats.max;
+  stats->count = n->u.stats.count;
+  sum = n->u.stats.sum;
+  if (reset)
+  {
+    n->u.stats.min = 0xFFFF;
+    n->u.stats.max = 0;
+    n->u.stats.count = 0;
+    n->u.stats.sum = 0;
+  }
+  __set_PRIMASK(primask);
+
+  if (!stats->count)
+    stats->min = 0;
+  stats->mean = stats->count ? (uint16_t)(sum / stats->count) : 0;
+  return 0;
+}
+
+
+/**
+  * @brief  Copies the running state of every node.
+  * @param  graph: The graph.
+  * @param  state: Receives the state.
+  * @retval None
+  * @note   Taken with interrupts masked so a block running in another task is not seen
+  *         half applied.
+  */
+
+void GRAPH_SAVE_STATE(GRAPH_Graph *graph, GRAPH_State *state)
+{
+  uint32_t primask;
+
+  memset(state, 0, sizeof(*state));
+  primask = __get_PRIMASK();
+  __disable_irq();
+  state->node_count = graph->node_count;
+  for (uint8_t i = 0; i < graph->node_count; i++)
+  {
+    const GRAPH_Node *n = &graph->nodes[i];
+    GRAPH_NodeState *st = &state->nodes[i];
+
+    st->kind = n->kind;
+    if (n->kind == GRAPH_FILTER)
+    {
+      st->flag = n->u.filter.primed;
+      st->acc = n->u.filter.acc;
+    }
+    else if (n->kind == GRAPH_DECIMATE)
+    {
+      st->flag = n->u.decimate.phase;
+      st->acc = (int32_t) n->u.decimate.acc;
+    }
+    else if (n->kind == GRAPH_STATS)
+    {
+      st->min = n->u.stats.min;
+      st->max = n->u.stats.max;
+      st->count = n->u.stats.count;
+      st->sum = n->u.stats.sum;
+    }
+    else if (n->kind == GRAPH_DETECT)
+    {
+      st->flag = n->u.detect.active;
+    }
+  }
+  __set_PRIMASK(primask);
+}
+
+
+/**
+  * @brief  Puts saved running state back into a graph with the same nodes.
+  * @param  graph: The graph, built (and compiled) the same way as when the state was saved.
+  * @param  state: State from GRAPH_SAVE_STATE.
+  * @retval 0 on success, -1 if the node list differs (the graph is left untouched).
+  * @note   Node parameters and callbacks keep their current values; only the accumulators,
+  *         counters and detector states are replaced.
+  */
+
+int GRAPH_LOAD_STATE(GRAPH_Graph *graph, const GRAPH_State *state)
+{
+  uint32_t primask;
+
+  if (state->node_count != graph->node_count)
+    return -1;
+  for (uint8_t i = 0; i < graph->node_count; i++)
+  {
+    if (state->nodes[i].kind != graph->nodes[i].kind)
+      return -1;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  for (uint8_t i = 0; i < graph->node_count; i++)
+  {
+    GRAPH_Node *n = &graph->nodes[i];
+    const GRAPH_NodeState *st = &state->nodes[i];
+
+    if (n->kind == GRAPH_FILTER)
+    {
+      n->u.filter.primed = st->flag;
+      n->u.filter.acc = st->acc;
+    }
+    else if ((n->kind == GRAPH_DECIMATE) && (st->flag < n->u.decimate.factor))
+    {
+      n->u.decimate.phase = st->flag;
+      n->u.decimate.acc = (uint32_t) st->acc;
+    }
+    else if (n->kind == GRAPH_STATS)
+    {
+      n->u.stats.min = st->min;
+      n->u.stats.max = st->max;
+      n->u.stats.count = st->count;
+      n->u.stats.sum = st->sum;
+    }
+    else if (n->kind == GRAPH_DETECT)
+    {
+      n->u.detect.active = st->flag;
+    }
+  }
+  __set_PRIMASK(primask);
+  return 0;
+}
+
+
+/**
+  * @brief  Measures the per-block cost of a source -> filter -> decimate -> stats graph against
+  *         the same processing written inline.
+  * @param  bench: Receives DWT cycles per GRAPH_BLOCK_SAMPLES block for both versions.
+  * @retval None
+  */
+
+void GRAPH_BENCH(GRAPH_Bench *bench)
+{
+  static GRAPH_Graph graph;
+  const uint16_t runs = 64;
+  uint16_t block[GRAPH_BLOCK_SAMPLES], out[GRAPH_BLOCK_SAMPLES];
+  volatile uint32_t sink;
+  uint16_t min = 0xFFFF, max = 0;
+  uint32_t sum = 0;
+  int32_t acc;
+  uint32_t dec = 0, start;
+  uint8_t phase = 0;
+  int src;
+
+  DWT_DELAY_INIT();
+  for (uint16_t j = 0; j < GRAPH_BLOCK_SAMPLES; j++)
+    block[j] = (j * 67) & 0x3FF;
+
+  GRAPH_INIT(&graph);
+  src = GRAPH_ADD_SOURCE(&graph, 0);
+  GRAPH_ADD_STATS(&graph, GRAPH_ADD_DECIMATE(&graph, GRAPH_ADD_FILTER(&graph, src, 3), 4));
+  GRAPH_COMPILE(&graph);
+
+  start = DWT_GET_CYCLES();
+  for (uint16_t r = 0; r < runs; r++)
+    GRAPH_RUN(&graph, 0, block, GRAPH_BLOCK_SAMPLES);
+  bench->graph_cycles = (DWT_GET_CYCLES() - start) / runs;
+
+  acc = (int32_t) block[0] << 3;
+  start = DWT_GET_CYCLES();
+  for (uint16_t r = 0; r < runs; r++)
+  {
+    uint16_t o = 0;
+
+    for (uint16_t j = 0; j < GRAPH_BLOCK_SAMPLES; j++)
+    {
+      acc += block[j] - (acc >> 3);
+      dec += acc >> 3;
+      if (++phase == 4)
+      {
+        out[o++] = dec / 4;
+        dec = 0;
+        phase = 0;
+      }
+    }
+    for (uint16_t j = 0; j < o; j++)
+    {
+      if (out[j] < min) min = out[j];
+      if (out[j] > max) max = out[j];
+      sum += out[j];
+    }
+  }
+  bench->hand_cycles = (DWT_GET_CYCLES() - start) / runs;
+  sink = min + max + sum;                               // Keep the inline version from being optimized out
+  (void) sink;
+}
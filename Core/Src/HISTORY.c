@@ -0,0 +1,237 @@
+#include "HISTORY.h"
+#include <string.h>
+
+static HISTORY_Level history[HISTORY_CHANNELS][HISTORY_LEVELS];
+static uint32_t history_Bucket_End[HISTORY_CHANNELS];  // Tick at which the open level 0 bucket closes
+static const uint16_t history_Factor[HISTORY_LEVELS - 1] = HISTORY_FACTORS;
+
+
+/**
+  * @brief  Resets a bucket to the empty state.
+  * @param  bucket: The bucket.
+  * @retval None
+  */
+
+static inline void HISTORY_CLEAR_BUCKET(HISTORY_Bucket *bucket)
+{
+  bucket->min = 0xFFFF;
+  bucket->max = 0;
+  bucket->count = 0;
+  bucket->sum = 0;
+}
+
+
+/**
+  * @brief  Merges one bucket into another.
+  * @param  dst: The bucket receiving the aggregate.
+  * @param  src: The bucket to merge.
+  * @retval None
+  */
+
+static inline void HISTORY_MERGE(HISTORY_Bucket *dst, const HISTORY_Bucket *src)
+{
+  if (!src->count)
+    return;
+  if (src->min < dst->min) dst->min = src->min;
+  if (src->max > dst->max) dst->max = src->max;
+  dst->count += src->count;
+  dst->sum += src->sum;
+}
+
+
+/**
+  * @brief  Closes the open bucket of a level and cascades it into the level above.
+  * @param  levels: The level array of one channel.
+  * @param  level: The level whose open bucket is closed.
+  * @retval None
+  * @note   A level only closes after factor[level - 1] closes below it, so the amortized cost
+  *         per level 0 bucket is 1 + 1/f0 + 1/(f0*f1) + ... < 2 bucket operations.
+  */
+
+static void HISTORY_CLOSE(HISTORY_Level *levels, uint8_t level)
+{
+  HISTORY_Level *l = &levels[level];
+
+  l->ring[l->head] = l->open;
+  l->head = (l->head + 1) % HISTORY_DEPTH;
+  if (l->filled < HISTORY_DEPTH)
+    l->filled++;
+
+  if (level + 1 < HISTORY_LEVELS)
+  {
+    HISTORY_Level *up = &levels[level + 1];
+    HISTORY_MERGE(&up->open, &l->open);
+    if (++up->merged == history_Factor[level])
+    {
+      HISTORY_CLOSE(levels, level + 1);
+      up->merged = 0;
+    }
+  }
+  HISTORY_CLEAR_BUCKET(&l->open);
+}
+
+
+/**
+  * @brief  Returns the duration of one bucket of a level.
+  * @param  level: The level (0 = finest).
+  * @retval The bucket duration in milliseconds.
+  */
+
+uint32_t HISTORY_BUCKET_MS(uint8_t level)
+{
+  uint32_t ms = HISTORY_BASE_MS;
+
+  for (uint8_t i = 0; (i < level) && (i < HISTORY_LEVELS - 1); i++)
+    ms *= history_Factor[i];
+  return ms;
+}
+
+
+/**
+  * @brief  Empties the history of every channel.
+  * @param  None
+  * @retval None
+  */
+
+void HISTORY_INIT(void)
+{
+  memset(history, 0, sizeof(history));
+  for (uint8_t ch = 0; ch < HISTORY_CHANNELS; ch++)
+  {
+    for (uint8_t level = 0; level < HISTORY_LEVELS; level++)
+      HISTORY_CLEAR_BUCKET(&history[ch][level].open);
+    history_Bucket_End[ch] = 0;
+  }
+}
+
+
+/**
+  * @brief  Adds one sample to a channel history.
+  * @param  channel: The channel index (0 to HISTORY_CHANNELS - 1).
+  * @param  value: The sample value.
+  * @param  tick_ms: The sample time in milliseconds (HAL_GetTick clock).
+  * @retval None
+  * @note   Each sample costs one bucket update; bucket closes happen once per HISTORY_BASE_MS
+  *         whatever the sample rate. Periods without samples are recorded as empty buckets
+  *         (at most HISTORY_DEPTH of them, older ones would be overwritten anyway).
+  *         Each channel must be fed from a single task.
+  */
+
+void HISTORY_ADD(uint8_t channel, uint16_t value, uint32_t tick_ms)
+{
+  HISTORY_Level *levels;
+  HISTORY_Bucket *open;
+  uint32_t primask;
+
+  if (channel >= HISTORY_CHANNELS)
+    return;
+
+  levels = history[channel];
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (!history_Bucket_End[channel])
+    history_Bucket_End[channel] = tick_ms + HISTORY_BASE_MS;
+
+  for (uint16_t gaps = 0; (int32_t)(tick_ms - history_Bucket_End[channel]) >= 0; gaps++)
+  {
+    if (gaps < HISTORY_DEPTH)
+      HISTORY_CLOSE(levels, 0);
+    history_Bucket_End[channel] += HISTORY_BASE_MS;
+    if (gaps >= HISTORY_DEPTH)
+      history_Bucket_End[channel] = tick_ms + HISTORY_BASE_MS;
+  }
+
+  open = &levels[0].open;
+  if (value < open->min) open->min = value;
+  if (value > open->max) open->max = value;
+  open->count++;
+  open->sum += value;
+
+  __set_PRIMASK(primask);
+}
+
+
+/**
+  * @brief  Returns min, max and mean of a channel over the most recent time window.
+  * @param  channel: The channel index.
+  * @param  window_ms: The window length, e.g. 3600000 for "the last hour".
+  * @param  summary: Receives the aggregate.
+  * @retval 0 on success, -1 if the channel is invalid or holds no sample in the window.
+  * @note   The answer uses the finest level whose ring spans the window, plus the open
+  *         buckets of that level and all finer ones, so its cost is bounded by HISTORY_DEPTH
+  *         and independent of the sample rate. The window is rounded up to whole buckets of
+  *         that level; summary->span_ms reports the time actually covered.
+  */
+
+int HISTORY_QUERY(uint8_t channel, uint32_t window_ms, HISTORY_Summary *summary)
+{
+  HISTORY_Level *levels;
+  HISTORY_Bucket acc;
+  uint32_t bucket_ms, primask;
+  uint16_t buckets;
+  uint8_t level = 0;
+
+  if (channel >= HISTORY_CHANNELS)
+    return -1;
+  levels = history[channel];
+
+  while ((level < HISTORY_LEVELS - 1) && ((uint64_t) HISTORY_BUCKET_MS(level) * HISTORY_DEPTH < window_ms))
+    level++;
+  bucket_ms = HISTORY_BUCKET_MS(level);
+  buckets = (window_ms + bucket_ms - 1) / bucket_ms;
+  if (buckets > HISTORY_DEPTH)
+    buckets = HISTORY_DEPTH;
+
+  HISTORY_CLEAR_BUCKET(&acc);
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  for (uint8_t l = 0; l <= level; l++)
+    HISTORY_MERGE(&acc, &levels[l].open);
+  if (buckets > levels[level].filled)
+    buckets = levels[level].filled;
+  for (uint16_t i = 1; i <= buckets; i++)
+    HISTORY_MERGE(&acc, &levels[level].ring[(levels[level].head + HISTORY_DEPTH - i) % HISTORY_DEPTH]);
+
+  __set_PRIMASK(primask);
+
+  if (!acc.count)
+    return -1;
+  summary->min = acc.min;
+  summary->max = acc.max;
+  summary->mean = acc.sum / acc.count;
+  summary->count = acc.count;
+  summary->span_ms = buckets * bucket_ms;
+  return 0;
+}
+
+
+/**
+  * @brief  Copies the most recent closed buckets of one level, oldest first (for sparklines).
+  * @param  channel: The channel index.
+  * @param  level: The level (0 = finest).
+  * @param  buckets: Destination array.
+  * @param  count: Maximum number of buckets to copy.
+  * @retval Number of buckets copied.
+  */
+
+uint16_t HISTORY_TREND(uint8_t channel, uint8_t level, HISTORY_Bucket *buckets, uint16_t count)
+{
+  HISTORY_Level *l;
+  uint32_t primask;
+
+  if ((channel >= HISTORY_CHANNELS) || (level >= HISTORY_LEVELS))
+    return 0;
+  l = &history[channel][level];
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if (count > l->filled)
+    count = l->filled;
+  for (uint16_t i = 0; i < count; i++)
+    buckets[i] = l->ring[(l->head + HISTORY_DEPTH - count + i) % HISTORY_DEPTH];
+  __set_PRIMASK(primask);
+
+  return count;
+}
@@ -0,0 +1,376 @@
+#include "I2C_BUS.h"
+#include "DWT_DELAY.h"
+#include "RTOS_FAST.h"
+
+extern I2C_HandleTypeDef hi2c2;
+
+typedef struct
+{
+  uint8_t address;
+  uint8_t reg;
+  uint8_t *data;
+  uint8_t length;
+} I2C_BUS_Transfer;
+
+static osMutexId_t i2c_bus_Mutex;
+static osMessageQueueId_t i2c_bus_Queue;
+static I2C_BUS_Stats i2c_bus_Stats[I2C_BUS_CLIENTS];
+static uint32_t i2c_bus_Seed;
+
+static const osMutexAttr_t i2c_bus_Mutex_attributes = {
+  .name = "i2cMutex"
+};
+
+static const osThreadAttr_t i2c_bus_Task_attributes = {
+  .name = "I2CBusTask",
+  .stack_size = 128 * 4,
+  .priority = (osPriority_t) osPriorityAboveNormal,
+};
+
+
+/**
+  * @brief  Maps the outcome of a HAL transfer to an I2C_BUS_ result.
+  * @param  status: Value returned by the HAL call.
+  * @retval I2C_BUS_OK, I2C_BUS_LOST, I2C_BUS_BUSY or I2C_BUS_ERROR.
+  * @note   The blocking HAL calls only report ARLO/BERR from HAL_I2C_ER_IRQHandler, and the
+  *         error interrupt is not enabled here: a lost arbitration comes back as a timeout with
+  *         the flag still set in SR1. So SR1 is checked directly, the flags are cleared, and
+  *         the bus is released with a STOP if the peripheral is still master (bus error).
+  */
+
+static int I2C_BUS_RESULT(HAL_StatusTypeDef status)
+{
+  if (READ_BIT(I2C2->SR1, I2C_SR1_ARLO | I2C_SR1_BERR))
+  {
+    if (LL_I2C_IsActiveFlag_MSL(I2C2))
+      LL_I2C_GenerateStopCondition(I2C2);
+    LL_I2C_ClearFlag_ARLO(I2C2);
+    LL_I2C_ClearFlag_BERR(I2C2);
+    return I2C_BUS_LOST;
+  }
+  if (status == HAL_OK)
+    return I2C_BUS_OK;
+  if (status == HAL_BUSY)
+    return I2C_BUS_BUSY;
+  return I2C_BUS_ERROR;
+}
+
+
+/**
+  * @brief  One master transmit attempt through HAL.
+  * @param  ctx: The I2C_BUS_Transfer.
+  * @retval An I2C_BUS_ result.
+  */
+
+static int I2C_BUS_WRITE_ONCE(void *ctx)
+{
+  I2C_BUS_Transfer *t = (I2C_BUS_Transfer *) ctx;
+
+  return I2C_BUS_RESULT(HAL_I2C_Master_Transmit(&hi2c2, t->address, t->data, t->length, I2C_BUS_TIMEOUT));
+}
+
+
+/**
+  * @brief  One register read attempt through HAL.
+  * @param  ctx: The I2C_BUS_Transfer.
+  * @retval An I2C_BUS_ result.
+  */
+
+static int I2C_BUS_READ_ONCE(void *ctx)
+{
+  I2C_BUS_Transfer *t = (I2C_BUS_Transfer *) ctx;
+
+  return I2C_BUS_RESULT(HAL_I2C_Mem_Read(&hi2c2, t->address, t->reg, I2C_MEMADD_SIZE_8BIT, t->data, t->length, I2C_BUS_TIMEOUT));
+}
+
+
+/**
+  * @brief  Waits a random number of slots before a retry.
+  * @param  attempt: Attempts made so far (1 after the first loss).
+  * @retval The wait in microseconds.
+  * @note   xorshift32, seeded from the device UID so boards sharing a bus draw different
+  *         sequences. Waits of a tick or more sleep; shorter ones spin.
+  */
+
+static uint32_t I2C_BUS_BACKOFF(uint32_t attempt)
+{
+  uint32_t window = 1U << ((attempt < 5) ? attempt : 5);
+  uint32_t us;
+
+  if (window > I2C_BUS_BACKOFF_MAX_SLOTS)
+    window = I2C_BUS_BACKOFF_MAX_SLOTS;
+
+  i2c_bus_Seed ^= i2c_bus_Seed << 13;
+  i2c_bus_Seed ^= i2c_bus_Seed >> 17;
+  i2c_bus_Seed ^= i2c_bus_Seed << 5;
+  us = (i2c_bus_Seed % window + 1) * I2C_BUS_BACKOFF_SLOT_US;
+
+  if ((us >= 1000U * portTICK_PERIOD_MS) && (osKernelGetState() == osKernelRunning))
+    RTOS_DELAY(us / (1000U * portTICK_PERIOD_MS));
+  else
+    DWT_DELAY_US(us);
+  return us;
+}
+
+
+/**
+  * @brief  Makes one attempt with the slave-side interrupts held off.
+  * @param  transfer: The attempt.
+  * @param  ctx: Passed to transfer.
+  * @retval An I2C_BUS_ result.
+  * @note   When general-call reception is enabled (SYNC_INIT) the event interrupts would
+  *         otherwise consume the master SB/ADDR/BTF events of the polled transfer. A slave
+  *         reception already in progress is left to finish first, interrupts enabled.
+  *         HAL clears ACK after a read, so it is set again for the next reception.
+  */
+
+static int I2C_BUS_ATTEMPT(I2C_BUS_TransferFn transfer, void *ctx)
+{
+  uint32_t start = DWT_GET_CYCLES();
+  uint32_t events = I2C2->CR2 & (I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN);
+  int status;
+
+  if (events)
+  {
+    while (LL_I2C_IsActiveFlag_BUSY(I2C2))
+    {
+      if (DWT_GET_CYCLES() - start > I2C_BUS_TIMEOUT * (SystemCoreClock / 1000U))
+        return I2C_BUS_BUSY;
+    }
+    CLEAR_BIT(I2C2->CR2, events);
+  }
+
+  status = transfer(ctx);
+
+  if (events)
+  {
+    SET_BIT(I2C2->CR1, I2C_CR1_ACK);
+    SET_BIT(I2C2->CR2, events);
+  }
+  return status;
+}
+
+
+/**
+  * @brief  Runs queued register reads.
+  * @param  argument: Not used
+  * @retval None
+  */
+
+static void I2C_BUS_TASK(void *argument)
+{
+  I2C_BUS_Request *request;
+  int status;
+
+  for(;;)
+  {
+    if (RTOS_QUEUE_GET(i2c_bus_Queue, &request, osWaitForever) != osOK)
+      continue;
+
+    status = I2C_BUS_READ(I2C_BUS_CLIENT_SENSOR, request->address, request->reg, request->data, request->length);
+    request->queued = 0;
+    if (request->done)
+      request->done(request->ctx, status, request->data, request->length);
+  }
+}
+
+
+/**
+  * @brief  Creates the bus lock, the request queue and the bus task.
+  * @param  None
+  * @retval None
+  * @note   Call after osKernelInitialize. Until the scheduler runs the lock is not taken, so
+  *         LCD_INIT can still use the bus from main.
+  */
+
+void I2C_BUS_INIT(void)
+{
+  DWT_DELAY_INIT();
+  i2c_bus_Seed = *(const uint32_t *) UID_BASE ^ *(const uint32_t *) (UID_BASE + 4U) ^ DWT_GET_CYCLES();
+  if (i2c_bus_Seed == 0)
+    i2c_bus_Seed = 1;
+  i2c_bus_Mutex = osMutexNew(&i2c_bus_Mutex_attributes);
+  i2c_bus_Queue = osMessageQueueNew(I2C_BUS_QUEUE_DEPTH, sizeof(I2C_BUS_Request *), NULL);
+  osThreadNew(I2C_BUS_TASK, NULL, &i2c_bus_Task_attributes);
+}
+
+
+/**
+  * @brief  Takes exclusive use of I2C2 for one transaction.
+  * @param  None
+  * @retval None
+  */
+
+void I2C_BUS_LOCK(void)
+{
+  if (i2c_bus_Mutex && (osKernelGetState() == osKernelRunning))
+    RTOS_MUTEX_ACQUIRE(i2c_bus_Mutex, osWaitForever);
+}
+
+
+/**
+  * @brief  Gives I2C2 back after I2C_BUS_LOCK.
+  * @param  None
+  * @retval None
+  */
+
+void I2C_BUS_UNLOCK(void)
+{
+  if (i2c_bus_Mutex && (osKernelGetState() == osKernelRunning))
+    RTOS_MUTEX_RELEASE(i2c_bus_Mutex);
+}
+
+
+/**
+  * @brief  Runs one transaction with arbitration-aware retry.
+  * @param  client: I2C_BUS_CLIENT_ of the caller, for the accounting.
+  * @param  transfer: Makes one attempt and returns an I2C_BUS_ result.
+  * @param  ctx: Passed to transfer.
+  * @retval I2C_BUS_OK, or the result of the last attempt.
+  * @note   Takes the bus lock for the whole transaction, backoff included, so the retry is
+  *         not overtaken by another client of this board. Call from a task (or from main
+  *         before the scheduler starts).
+  */
+
+int I2C_BUS_RUN(uint8_t client, I2C_BUS_TransferFn transfer, void *ctx)
+{
+  I2C_BUS_Stats *stats = &i2c_bus_Stats[client];
+  uint32_t attempt = 0;
+  int status;
+
+  I2C_BUS_LOCK();
+  for (;;)
+  {
+    status = I2C_BUS_ATTEMPT(transfer, ctx);
+    attempt++;
+    if (status == I2C_BUS_LOST)
+      stats->lost++;
+    else if (status == I2C_BUS_BUSY)
+      stats->busy++;
+    else
+      break;
+    if (attempt > I2C_BUS_RETRIES)
+      break;
+    stats->backoff_us += I2C_BUS_BACKOFF(attempt);
+  }
+  I2C_BUS_UNLOCK();
+
+  stats->transactions++;
+  stats->attempts += attempt;
+  if (attempt > stats->max_attempts)
+    stats->max_attempts = attempt;
+  if (status != I2C_BUS_OK)
+    stats->failed++;
+  return status;
+}
+
+
+/**
+  * @brief  Writes bytes to a slave (START, address, bytes, STOP).
+  * @param  client: I2C_BUS_CLIENT_ of the caller.
+  * @param  address: 8-bit slave address.
+  * @param  data: Bytes to send.
+  * @param  length: Number of bytes.
+  * @retval An I2C_BUS_ result.
+  */
+
+int I2C_BUS_WRITE(uint8_t client, uint8_t address, const uint8_t *data, uint8_t length)
+{
+  I2C_BUS_Transfer t = { address, 0, (uint8_t *) data, length };
+
+  return I2C_BUS_RUN(client, I2C_BUS_WRITE_ONCE, &t);
+}
+
+
+/**
+  * @brief  Reads consecutive registers of a slave (register address write, repeated START, read).
+  * @param  client: I2C_BUS_CLIENT_ of the caller.
+  * @param  address: 8-bit slave address.
+  * @param  reg: First register.
+  * @param  data: Receives the bytes.
+  * @param  length: Number of bytes.
+  * @retval An I2C_BUS_ result.
+  */
+
+int I2C_BUS_READ(uint8_t client, uint8_t address, uint8_t reg, uint8_t *data, uint8_t length)
+{
+  I2C_BUS_Transfer t = { address, reg, data, length };
+
+  return I2C_BUS_RUN(client, I2C_BUS_READ_ONCE, &t);
+}
+
+
+/**
+  * @brief  Queues a register read for the bus task.
+  * @param  request: The read; must stay valid until its done callback has run.
+  * @retval 0 if queued, 1 if it was already queued (coalesced), -1 if the queue is full.
+  */
+
+int I2C_BUS_SUBMIT(I2C_BUS_Request *request)
+{
+  int status = 0;
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (request->queued)
+  {
+    request->coalesced++;
+    status = 1;
+  }
+  else
+  {
+    request->queued = 1;
+    request->stamp = DWT_GET_CYCLES();
+  }
+  __set_PRIMASK(primask);
+
+  if ((status == 0) && (RTOS_QUEUE_PUT(i2c_bus_Queue, &request, 0) != osOK))
+  {
+    request->queued = 0;
+    status = -1;
+  }
+  return status;
+}
+
+
+/**
+  * @brief  Queues a register read from an interrupt handler.
+  * @param  request: The read; must stay valid until its done callback has run.
+  * @retval 0 if queued, 1 if it was already queued (coalesced), -1 if the queue is full.
+  * @note   Requests a context switch on exit when the bus task is woken.
+  */
+
+int I2C_BUS_SUBMIT_FROM_ISR(I2C_BUS_Request *request)
+{
+  BaseType_t woken = pdFALSE;
+
+  if (request->queued)
+  {
+    request->coalesced++;
+    return 1;
+  }
+  request->queued = 1;
+  request->stamp = DWT_GET_CYCLES();
+  if (xQueueSendToBackFromISR((QueueHandle_t) i2c_bus_Queue, &request, &woken) != pdPASS)
+  {
+    request->queued = 0;
+    return -1;
+  }
+  portYIELD_FROM_ISR(woken);
+  return 0;
+}
+
+
+/**
+  * @brief  Reads the accounting of a client.
+  * @param  client: I2C_BUS_CLIENT_ value.
+  * @param  stats: Receives the counters.
+  * @retval None
+  * @note   Comparing attempts / transactions and backoff_us between clients shows whether
+  *         one of them is losing the bus more than its share.
+  */
+
+void I2C_BUS_READ_STATS(uint8_t client, I2C_BUS_Stats *stats)
+{
+  *stats = i2c_bus_Stats[client];
+}
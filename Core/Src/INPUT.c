@@ -0,0 +1,164 @@
+#include "INPUT.h"
+#include "RTOS_FAST.h"
+
+#define INPUT_EXTI_LINES              (INPUT_BUTTON_PINS | INPUT_ENCODER_A_PIN)
+
+static osMessageQueueId_t input_Queue;
+static uint16_t input_Buttons;                          // Last reported levels (1 = pressed)
+static uint16_t input_Encoder;                          // TIM4->CNT at the last reported detent
+
+
+/**
+  * @brief  Configures the buttons, the encoder timer, the debounce timer and the event queue.
+  * @param  None
+  * @retval None
+  * @note   Call after osKernelInitialize (the queue is an RTOS object).
+  */
+
+void INPUT_INIT(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  __HAL_RCC_GPIOD_CLK_ENABLE();
+  __HAL_RCC_GPIOE_CLK_ENABLE();
+  __HAL_RCC_SYSCFG_CLK_ENABLE();
+  __HAL_RCC_TIM4_CLK_ENABLE();
+  __HAL_RCC_TIM7_CLK_ENABLE();
+
+  input_Queue = osMessageQueueNew(INPUT_QUEUE_DEPTH, sizeof(INPUT_Event), NULL);
+
+  // Buttons: pulled up, interrupt on both edges
+  GPIO_InitStruct.Pin = INPUT_BUTTON_PINS;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING_FALLING;
+  GPIO_InitStruct.Pull = GPIO_PULLUP;
+  HAL_GPIO_Init(INPUT_BUTTON_PORT, &GPIO_InitStruct);
+
+  /**TIM4 GPIO Configuration
+  PD12     ------> TIM4_CH1
+  PD13     ------> TIM4_CH2
+  */
+  GPIO_InitStruct.Pin = INPUT_ENCODER_A_PIN | INPUT_ENCODER_B_PIN;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Pull = GPIO_PULLUP;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  GPIO_InitStruct.Alternate = GPIO_AF2_TIM4;
+  HAL_GPIO_Init(INPUT_ENCODER_PORT, &GPIO_InitStruct);
+
+  // The input stage stays active in AF mode, so EXTI12 also sees the encoder A edges
+  SYSCFG->EXTICR[3] = (SYSCFG->EXTICR[3] & ~SYSCFG_EXTICR4_EXTI12) | SYSCFG_EXTICR4_EXTI12_PD;
+  EXTI->RTSR |= INPUT_ENCODER_A_PIN;
+  EXTI->FTSR |= INPUT_ENCODER_A_PIN;
+  EXTI->PR = INPUT_ENCODER_A_PIN;
+  EXTI->IMR |= INPUT_ENCODER_A_PIN;
+
+  // TIM4: encoder mode 3 (both inputs, x4), filtered, counts without the CPU
+  TIM4->CR1 = 0;
+  TIM4->ARR = 0xFFFF;
+  TIM4->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0 | (0xF << TIM_CCMR1_IC1F_Pos) | (0xF << TIM_CCMR1_IC2F_Pos);
+  TIM4->CCER = TIM_CCER_CC1E | TIM_CCER_CC2E;
+  TIM4->SMCR = 3U << TIM_SMCR_SMS_Pos;
+  TIM4->CR1 = TIM_CR1_CEN;
+  input_Encoder = TIM4->CNT;
+
+  // TIM7: 10 kHz one-shot, update interrupt when the debounce time has elapsed
+  TIM7->CR1 = TIM_CR1_OPM;
+  TIM7->PSC = (HAL_RCC_GetPCLK1Freq() * 2U) / 10000U - 1U;
+  TIM7->ARR = INPUT_DEBOUNCE_MS * 10U;
+  TIM7->EGR = TIM_EGR_UG;
+  TIM7->SR = 0;
+  TIM7->DIER = TIM_DIER_UIE;
+
+  input_Buttons = ~INPUT_BUTTON_PORT->IDR & INPUT_BUTTON_PINS;
+
+  HAL_NVIC_SetPriority(EXTI2_IRQn, INPUT_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(EXTI2_IRQn);
+  HAL_NVIC_SetPriority(EXTI3_IRQn, INPUT_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(EXTI3_IRQn);
+  HAL_NVIC_SetPriority(EXTI4_IRQn, INPUT_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(EXTI4_IRQn);
+  HAL_NVIC_SetPriority(EXTI15_10_IRQn, INPUT_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+  HAL_NVIC_SetPriority(TIM7_IRQn, INPUT_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(TIM7_IRQn);
+}
+
+
+/**
+  * @brief  Waits for the next input event.
+  * @param  event: Receives the event.
+  * @param  timeout: Maximum wait in ticks (0 polls).
+  * @retval 0 if an event was received, -1 on timeout.
+  */
+
+int INPUT_WAIT(INPUT_Event *event, uint32_t timeout)
+{
+  return (RTOS_QUEUE_GET(input_Queue, event, timeout) == osOK) ? 0 : -1;
+}
+
+
+/**
+  * @brief  Starts debouncing on the first edge of an input line.
+  * @param  pin: The EXTI line that fired.
+  * @retval None
+  * @note   Called from HAL_GPIO_EXTI_Callback. All input lines stay masked until TIM7 expires,
+  *         so a bouncing contact costs one interrupt.
+  */
+
+void INPUT_EXTI_CALLBACK(uint16_t pin)
+{
+  if (!(pin & INPUT_EXTI_LINES))
+    return;
+
+  EXTI->IMR &= ~INPUT_EXTI_LINES;
+  TIM7->CNT = 0;
+  TIM7->CR1 |= TIM_CR1_CEN;
+}
+
+
+/**
+  * @brief  Queues the settled changes once the debounce time has elapsed.
+  * @param  None
+  * @retval None
+  * @note   Called from TIM7_IRQHandler. Edges seen while masked are discarded; the levels and
+  *         the encoder count are read directly, so nothing is lost.
+  */
+
+void INPUT_TIMER_IRQHandler(void)
+{
+  BaseType_t woken = pdFALSE;
+  uint16_t buttons, changed;
+  int16_t detents;
+  INPUT_Event event;
+
+  if (!(TIM7->SR & TIM_SR_UIF))
+    return;
+  TIM7->SR = 0;
+
+  buttons = ~INPUT_BUTTON_PORT->IDR & INPUT_BUTTON_PINS;
+  changed = buttons ^ input_Buttons;
+  input_Buttons = buttons;
+  for (uint8_t b = 0; b < INPUT_BUTTONS; b++)
+  {
+    uint16_t mask = 1U << (INPUT_BUTTON_FIRST_PIN + b);
+    if (!(changed & mask))
+      continue;
+    event.type = (buttons & mask) ? INPUT_PRESS : INPUT_RELEASE;
+    event.button = b;
+    event.value = 0;
+    xQueueSendToBackFromISR((QueueHandle_t) input_Queue, &event, &woken);
+  }
+
+  detents = (int16_t)(uint16_t)(TIM4->CNT - input_Encoder) / INPUT_ENCODER_COUNTS;
+  if (detents)
+  {
+    input_Encoder += detents * INPUT_ENCODER_COUNTS;
+    event.type = INPUT_ROTATE;
+    event.button = 0;
+    event.value = detents;
+    xQueueSendToBackFromISR((QueueHandle_t) input_Queue, &event, &woken);
+  }
+
+  EXTI->PR = INPUT_EXTI_LINES;
+  EXTI->IMR |= INPUT_EXTI_LINES;
+  portYIELD_FROM_ISR(woken);
+}
@@ -0,0 +1,99 @@
+#include "LCD_CPP.h"
+
+#if LCD_CPP_DRIVER
+
+#include "LCD.hpp"
+
+using lcd::Display;
+
+
+/**
+  * @brief  Initializes the LCD through the C++ driver.
+  * @param  None
+  * @retval None
+  * @note   Use either LCD_INIT or LCD_CPP_INIT: both drivers keep their own shadow frame.
+  */
+
+extern "C" void LCD_CPP_INIT(void)
+{
+  Display::init();
+}
+
+
+/**
+  * @brief  Sets the cursor position on the LCD screen.
+  * @param  row: The row where the cursor will be set (0 or 1).
+  * @param  col: The column where the cursor will be set (0 to 15).
+  * @retval None
+  * @note   The row offset comes from a constexpr table instead of the switch in LCD_SET_CURSOR.
+  */
+
+extern "C" void LCD_CPP_SET_CURSOR(int row, int col)
+{
+  Display::setCursor(static_cast<uint8_t>(row), static_cast<uint8_t>(col));
+}
+
+
+/**
+  * @brief  Sends a string of characters to be displayed on the LCD screen.
+  * @param  str: Pointer to the string to be displayed.
+  * @retval None
+  */
+
+extern "C" void LCD_CPP_SEND_STRING(const char *str)
+{
+  Display::print(str);
+}
+
+
+/**
+  * @brief  Writes a full row, sending only the cells that differ from what is on screen.
+  * @param  row: The row to be written (0 or 1).
+  * @param  str: Pointer to the text, padded with spaces to the row length.
+  * @retval None
+  */
+
+extern "C" void LCD_CPP_WRITE_ROW(int row, const char *str)
+{
+  if (row == 0)
+    Display::writeRow<0>(str);
+  else if (row == 1)
+    Display::writeRow<1>(str);
+}
+
+
+/**
+  * @brief  Measures the cost of one character written through the C and the C++ driver.
+  * @param  c_cycles_per_char: Receives the DWT cycles per character of LCD_SET_CURSOR + LCD_SEND_STRING.
+  * @param  cpp_cycles_per_char: Receives the DWT cycles per character of the templated driver.
+  * @retval None
+  * @note   Both drivers write LCD_BENCH_TEXT to the first row LCD_BENCH_ROUNDS times over the
+  *         selected transport, so the figures include bus time. Run it before the scheduler
+  *         starts (or from a single task) so that no other task touches the LCD meanwhile.
+  */
+
+extern "C" void LCD_CPP_BENCH(uint32_t *c_cycles_per_char, uint32_t *cpp_cycles_per_char)
+{
+  const uint32_t chars = LCD_BENCH_ROUNDS * (sizeof(LCD_BENCH_TEXT) - 1);
+  uint32_t start;
+
+  DWT_DELAY_INIT();
+
+  start = DWT_GET_CYCLES();
+  for (int i = 0; i < LCD_BENCH_ROUNDS; i++)
+  {
+    LCD_SET_CURSOR(0, 0);
+    LCD_SEND_STRING((char *) LCD_BENCH_TEXT);
+  }
+  *c_cycles_per_char = (DWT_GET_CYCLES() - start) / chars;
+
+  start = DWT_GET_CYCLES();
+  for (int i = 0; i < LCD_BENCH_ROUNDS; i++)
+  {
+    Display::setCursor<0, 0>();
+    Display::print(LCD_BENCH_TEXT);
+  }
+  *cpp_cycles_per_char = (DWT_GET_CYCLES() - start) / chars;
+}
+
+#endif /* LCD_CPP_DRIVER */
@@ -0,0 +1,103 @@
+#include "LCD_I2C.h"
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_GPIO
+
+#include "DWT_DELAY.h"
+
+#if LCD_GPIO_BUS_WIDTH == 8
+#define LCD_GPIO_BUS_SHIFT            LCD_GPIO_D0_PIN_NUM
+#elif LCD_GPIO_BUS_WIDTH == 4
+#define LCD_GPIO_BUS_SHIFT            (LCD_GPIO_D0_PIN_NUM + 4)
+#else
+#error "LCD_GPIO_BUS_WIDTH must be 4 or 8"
+#endif
+
+#define LCD_GPIO_BUS_MASK             (((1UL << LCD_GPIO_BUS_WIDTH) - 1UL) << LCD_GPIO_BUS_SHIFT)
+
+
+/**
+  * @brief  Places one bus word on the data lines and strobes the enable pin.
+  * @param  bits: The bus word (a nibble in 4-bit mode, a full byte in 8-bit mode).
+  * @param  rs: LCD_RS_CMD for an instruction, LCD_RS_DATA for a character.
+  * @retval None
+  * @note   RS and the data lines are updated with a single BSRR write, so the LCD never sees
+  *         a half-updated bus and no read-modify-write of ODR is needed.
+  */
+
+static void LCD_GPIO_STROBE(uint8_t bits, uint8_t rs)
+{
+  uint32_t set   = ((uint32_t)bits << LCD_GPIO_BUS_SHIFT) & LCD_GPIO_BUS_MASK;
+  uint32_t reset = LCD_GPIO_BUS_MASK & ~set;
+
+  if (rs) set   |= LCD_GPIO_RS_PIN;
+  else    reset |= LCD_GPIO_RS_PIN;
+
+  LCD_GPIO_PORT->BSRR = set | (reset << 16);
+  DWT_DELAY_NS(LCD_GPIO_SETUP_NS);
+  LCD_GPIO_PORT->BSRR = LCD_GPIO_EN_PIN;
+  DWT_DELAY_NS(LCD_GPIO_EN_PULSE_NS);
+  LCD_GPIO_PORT->BSRR = (uint32_t)LCD_GPIO_EN_PIN << 16;
+  DWT_DELAY_NS(LCD_GPIO_EN_PULSE_NS);
+}
+
+
+/**
+  * @brief  Configures the LCD GPIO pins and the DWT cycle counter used for bus timing.
+  * @param  None
+  * @retval None
+  */
+
+void LCD_TRANSPORT_INIT(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  DWT_DELAY_INIT();
+  __HAL_RCC_GPIOE_CLK_ENABLE();
+
+  LCD_GPIO_PORT->BSRR = (LCD_GPIO_BUS_MASK | LCD_GPIO_RS_PIN | LCD_GPIO_EN_PIN) << 16;
+
+  GPIO_InitStruct.Pin = LCD_GPIO_BUS_MASK | LCD_GPIO_RS_PIN | LCD_GPIO_EN_PIN;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(LCD_GPIO_PORT, &GPIO_InitStruct);
+}
+
+
+/**
+  * @brief  Writes one instruction or character to the LCD over the parallel bus.
+  * @param  value: The instruction or character code.
+  * @param  rs: LCD_RS_CMD for an instruction, LCD_RS_DATA for a character.
+  * @retval None
+  * @note   In 4-bit mode the upper nibble is sent first, exactly like the I2C backpack does.
+  *         The function returns once the LCD has had time to execute the write, so the
+  *         caller never needs to poll the busy flag (RW is tied to ground).
+  */
+
+void LCD_TRANSPORT_WRITE(uint8_t value, uint8_t rs)
+{
+#if LCD_GPIO_BUS_WIDTH == 8
+  LCD_GPIO_STROBE(value, rs);
+#else
+  LCD_GPIO_STROBE(value >> 4, rs);
+  LCD_GPIO_STROBE(value & 0x0F, rs);
+#endif
+
+  if ((rs == LCD_RS_CMD) && (value <= LCD_CMD_RETURN_HOME))
+    DWT_DELAY_US(LCD_GPIO_HOME_EXEC_US);
+  else
+    DWT_DELAY_US(LCD_GPIO_EXEC_US);
+}
+
+
+/**
+  * @brief  Flushes pending writes (none: every GPIO write completes before returning).
+  * @param  None
+  * @retval None
+  */
+
+void LCD_TRANSPORT_FLUSH(void)
+{
+}
+
+#endif /* LCD_TRANSPORT == LCD_TRANSPORT_GPIO */
@@ -1,41 +1,276 @@
 #include "LCD_I2C.h"
+#include "DWT_DELAY.h"
+#include "I2C_BUS.h"
+#include <string.h>
+
+static char lcd_Shadow[LCD_ROWS][LCD_CLEAR_ROW_LENGTH];
+static int lcd_Row = -1;
+static int lcd_Col;
+
 
 /**
-  * @brief  Sends a command to the LCD screen.
-  * @param  cmd: The command to be sent.
+  * @brief  Builds the four backpack bytes that clock one value into the LCD in 4-bit mode.
+  * @param  value: The instruction or character code.
+  * @param  rs: LCD_RS_CMD for an instruction, LCD_RS_DATA for a character.
+  * @param  lcd_Buffer: Destination array of LCD_BUFFER_SIZE bytes.
   * @retval None
-  * @note   This function prepares and sends a command to the LCD screen via the I2C bus.
-  *         The function divides the command into upper and lower 4-bit parts, puts them 
-  *         into an LCD buffer, and sends them sequentially to trigger the control (enable) 
-  *         and selection (RS) signals of the LCD screen.
-  *         The control signals indicate to the LCD screen that it is a command, 
-  *         and the enable bit triggers the reading of the command by the LCD screen.
+  * @note   This function divides the value into upper and lower 4-bit parts and combines
+  *         them with the control (enable) and selection (RS) signals of the LCD screen.
+  *         The RS signal tells the LCD screen whether it is a command or data,
+  *         and the enable bit triggers the reading of the value by the LCD screen.
+  *         The PCF8574 (I2C) and 74HC595 (SPI) backpacks share the same pin map, so both
+  *         transports use this encoding.
   *
-  * @note   For the LCD_SEND_CMD function:
-  *         - The upper_data variable holds the upper 4 bits of the command.
-  *         - The lower_data variable holds the lower 4 bits of the command.
-  *         - The lcd_Buffer is a buffer array used for constructing the data to be sent.
+  * @note   For the LCD_BACKPACK_ENCODE function:
+  *         - The upper_data variable holds the upper 4 bits of the value.
+  *         - The lower_data variable holds the lower 4 bits of the value.
   *         - The LCD_BUFFER_SIZE specifies the size of the lcd_Buffer array.
   *         - The UPPER_BITS_MASK is a bitmask to extract the upper 4 bits of a byte.
-  *         - The ENABLE_BIT_MASK, RS_EN_OFF_MASK, and RS_BIT_MASK are masks for control bits.
-  *         - The TIMEOUT is the maximum time to wait for the I2C transmission to complete.
+  *         - The EN_BIT_MASK/RS_EN_OFF_MASK (command) and RS_EN_ON_MASK/RS_BIT_MASK (data)
+  *           are masks for control bits.
   */
 
-void LCD_SEND_CMD(char cmd)
+void LCD_BACKPACK_ENCODE(uint8_t value, uint8_t rs, uint8_t *lcd_Buffer)
 {
-  uint8_t lcd_Buffer[LCD_BUFFER_SIZE];
-  char upper_data, lower_data;
-  upper_data = (cmd & UPPER_BITS_MASK);
-  lower_data = ((cmd << LCD_BUFFER_SIZE) & UPPER_BITS_MASK);
+  uint8_t upper_data, lower_data;
+  uint8_t en_on, en_off;
+  upper_data = (value & UPPER_BITS_MASK);
+  lower_data = ((value << LCD_BUFFER_SIZE) & UPPER_BITS_MASK);
+  en_on  = (rs == LCD_RS_DATA) ? RS_EN_ON_MASK : EN_BIT_MASK;
+  en_off = (rs == LCD_RS_DATA) ? RS_BIT_MASK : RS_EN_OFF_MASK;
 
   // Constructing the LCD buffer with control (enable) and selection (RS) signals
-  lcd_Buffer[0]  = upper_data|EN_BIT_MASK;      //en=1, rs=0
-  lcd_Buffer[1]  = upper_data|RS_EN_OFF_MASK;   //en=0, rs=0
-  lcd_Buffer[2]  = lower_data|EN_BIT_MASK;      //en=1, rs=0
-  lcd_Buffer[3]  = lower_data|RS_EN_OFF_MASK;   //en=0, rs=0
+  lcd_Buffer[0]  = upper_data|en_on;    //en=1
+  lcd_Buffer[1]  = upper_data|en_off;   //en=0
+  lcd_Buffer[2]  = lower_data|en_on;    //en=1
+  lcd_Buffer[3]  = lower_data|en_off;   //en=0
+}
+
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_I2C
+
+/**
+  * @brief  Sends a buffer to the backpack with the LL byte pump (master transmitter, polling).
+  * @param  data: Bytes to send.
+  * @param  length: Number of bytes.
+  * @retval An I2C_BUS_ result: I2C_BUS_BUSY if another master holds the bus, I2C_BUS_LOST if
+  *         arbitration was lost, I2C_BUS_ERROR on NACK or timeout.
+  * @note   Same bus sequence as HAL_I2C_Master_Transmit (START, address, bytes, wait BTF, STOP)
+  *         without the handle lock, state machine and tick-based timeouts per flag.
+  *         I2C2 is still configured by MX_I2C2_Init. After an arbitration loss the peripheral
+  *         has already dropped to slave mode, so no STOP is generated; after a bus error it
+  *         is still master and releases the bus with a STOP.
+  */
+
+static int LCD_I2C_PUMP(const uint8_t *data, uint8_t length)
+{
+  uint32_t start;
+  int status;
+
+  start = DWT_GET_CYCLES();
+  while (LL_I2C_IsActiveFlag_BUSY(I2C2))
+  {
+    if (DWT_GET_CYCLES() - start > TIMEOUT * (SystemCoreClock / 1000U))
+      return I2C_BUS_BUSY;
+  }
+
+  LL_I2C_GenerateStartCondition(I2C2);
+  status = I2C_BUS_WAIT(I2C_SR1_SB, start);
+  if (status == I2C_BUS_OK)
+  {
+    LL_I2C_TransmitData8(I2C2, SLAVE_ADDRESS_LCD);
+    status = I2C_BUS_WAIT(I2C_SR1_ADDR, start);
+    if (status == I2C_BUS_OK)
+    {
+      LL_I2C_ClearFlag_ADDR(I2C2);
+      for (uint8_t i = 0; (i < length) && (status == I2C_BUS_OK); i++)
+      {
+        status = I2C_BUS_WAIT(I2C_SR1_TXE, start);
+        if (status == I2C_BUS_OK)
+          LL_I2C_TransmitData8(I2C2, data[i]);
+      }
+      if (status == I2C_BUS_OK)
+        status = I2C_BUS_WAIT(I2C_SR1_BTF, start);
+    }
+  }
+
+  LL_I2C_ClearFlag_AF(I2C2);
+  if (LL_I2C_IsActiveFlag_ARLO(I2C2))
+    LL_I2C_ClearFlag_ARLO(I2C2);
+  else
+    LL_I2C_GenerateStopCondition(I2C2);
+  LL_I2C_ClearFlag_BERR(I2C2);
+  return status;
+}
+
+
+/**
+  * @brief  One LCD_I2C_PUMP attempt, in the form I2C_BUS_RUN retries.
+  * @param  ctx: The LCD_BUFFER_SIZE backpack bytes.
+  * @retval An I2C_BUS_ result.
+  */
+
+static int LCD_I2C_PUMP_ONCE(void *ctx)
+{
+  return LCD_I2C_PUMP((const uint8_t *) ctx, LCD_BUFFER_SIZE);
+}
+
+/**
+  * @brief  Initializes the I2C transport.
+  * @param  None
+  * @retval None
+  * @note   I2C2 is already configured by MX_I2C2_Init; only the cycle counter used for the
+  *         LCD_I2C_PUMP timeouts is started (once, other modules time with it too).
+  */
+
+void LCD_TRANSPORT_INIT(void)
+{
+  DWT_DELAY_INIT();
+}
+
+
+/**
+  * @brief  Writes one instruction or character to the LCD through the PCF8574 backpack.
+  * @param  value: The instruction or character code.
+  * @param  rs: LCD_RS_CMD for an instruction, LCD_RS_DATA for a character.
+  * @retval None
+  * @note   The TIMEOUT is the maximum time to wait for the I2C transmission to complete.
+  */
+
+void LCD_TRANSPORT_WRITE(uint8_t value, uint8_t rs)
+{
+  uint8_t lcd_Buffer[LCD_BUFFER_SIZE];
+  int status;
+
+  LCD_BACKPACK_ENCODE(value, rs, lcd_Buffer);
 
   // Transmitting the buffer via the I2C bus to the LCD screen with the specified address
-  HAL_I2C_Master_Transmit (&hi2c2, SLAVE_ADDRESS_LCD, (uint8_t *) lcd_Buffer, LCD_BUFFER_SIZE, TIMEOUT);
+  // (one character per bus hold, so queued sensor reads wait at most one LCD byte;
+  // arbitration losses against another master are retried by the bus manager)
+#if LCD_I2C_FAST_PATH
+  status = I2C_BUS_RUN(I2C_BUS_CLIENT_LCD, LCD_I2C_PUMP_ONCE, lcd_Buffer);
+#else
+  status = I2C_BUS_WRITE(I2C_BUS_CLIENT_LCD, SLAVE_ADDRESS_LCD, lcd_Buffer, LCD_BUFFER_SIZE);
+#endif
+
+  // Byte lost for good: the panel no longer matches the shadow, so the next LCD_WRITE_ROW
+  // repositions the cursor and redraws everything
+  if (status != I2C_BUS_OK)
+  {
+    memset(lcd_Shadow, 0, sizeof(lcd_Shadow));
+    lcd_Row = -1;
+  }
+}
+
+
+/**
+  * @brief  Measures the cost of one LCD byte through HAL and through the LL byte pump.
+  * @param  hal_cycles: Receives DWT cycles per LCD byte with HAL_I2C_Master_Transmit.
+  * @param  ll_cycles: Receives DWT cycles per LCD byte with LCD_I2C_PUMP.
+  * @retval None
+  * @note   Sends the (idempotent) entry mode set instruction. At 100 kHz both paths spend
+  *         most of their time waiting on the bus, so the difference is the per-call overhead.
+  */
+
+void LCD_I2C_BENCH(uint32_t *hal_cycles, uint32_t *ll_cycles)
+{
+  const uint8_t runs = 8;
+  uint8_t lcd_Buffer[LCD_BUFFER_SIZE];
+  uint32_t start;
+
+  LCD_BACKPACK_ENCODE(LCD_INIT_CMD_ENTRY_MODE_SET, LCD_RS_CMD, lcd_Buffer);
+  I2C_BUS_LOCK();
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < runs; i++)
+    HAL_I2C_Master_Transmit(&hi2c2, SLAVE_ADDRESS_LCD, lcd_Buffer, LCD_BUFFER_SIZE, TIMEOUT);
+  *hal_cycles = (DWT_GET_CYCLES() - start) / runs;
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < runs; i++)
+    LCD_I2C_PUMP(lcd_Buffer, LCD_BUFFER_SIZE);
+  *ll_cycles = (DWT_GET_CYCLES() - start) / runs;
+  I2C_BUS_UNLOCK();
+}
+
+
+/**
+  * @brief  Flushes pending writes (none: every I2C write is blocking).
+  * @param  None
+  * @retval None
+  */
+
+void LCD_TRANSPORT_FLUSH(void)
+{
+}
+
+#endif /* LCD_TRANSPORT == LCD_TRANSPORT_I2C */
+
+
+/**
+  * @brief  Queues a command on the transport and keeps the shadow frame in step.
+  * @param  cmd: The command to be sent.
+  * @retval None
+  * @note   Clear display and return home reset the tracked cursor, set DDRAM address
+  *         commands move it, and cursor shift commands make it unknown until the next
+  *         set-address. Display shift commands do not touch DDRAM and are ignored.
+  */
+
+static void LCD_WRITE_CMD(uint8_t cmd)
+{
+  if (cmd & LCD_CMD_SET_DDRAM_ADDR)
+  {
+    lcd_Row = ((cmd & LCD_DDRAM_ROW_SECOND) != 0);
+    lcd_Col = cmd & ~(LCD_CMD_SET_DDRAM_ADDR | LCD_DDRAM_ROW_SECOND);
+  }
+  else if (cmd == LCD_INIT_CMD_CLEAR_DISPLAY)
+  {
+    memset(lcd_Shadow, ' ', sizeof(lcd_Shadow));
+    lcd_Row = 0;
+    lcd_Col = 0;
+  }
+  else if ((cmd & ~LCD_CMD_RETURN_HOME_X) == LCD_CMD_RETURN_HOME)
+  {
+    lcd_Row = 0;
+    lcd_Col = 0;
+  }
+  else if ((cmd & LCD_CMD_SHIFT_MASK) == LCD_CMD_CURSOR_SHIFT)
+  {
+    lcd_Row = -1;
+  }
+
+  LCD_TRANSPORT_WRITE(cmd, LCD_RS_CMD);
+}
+
+
+/**
+  * @brief  Queues a character on the transport and records it in the shadow frame.
+  * @param  data: The character to be sent.
+  * @retval None
+  */
+
+static void LCD_WRITE_DATA(uint8_t data)
+{
+  if ((lcd_Row >= 0) && (lcd_Col < LCD_CLEAR_ROW_LENGTH))
+    lcd_Shadow[lcd_Row][lcd_Col] = data;
+  lcd_Col++;
+
+  LCD_TRANSPORT_WRITE(data, LCD_RS_DATA);
+}
+
+
+/**
+  * @brief  Sends a command to the LCD screen.
+  * @param  cmd: The command to be sent.
+  * @retval None
+  * @note   The command is handed to the transport selected by LCD_TRANSPORT
+  *         (I2C backpack, direct GPIO bus or SPI shift register) with RS low.
+  */
+
+void LCD_SEND_CMD(char cmd)
+{
+  LCD_WRITE_CMD((uint8_t) cmd);
+  LCD_TRANSPORT_FLUSH();
 }
 
 
@@ -43,36 +278,14 @@ void LCD_SEND_CMD(char cmd)
   * @brief  Sends data to the LCD screen.
   * @param  data: The data to be sent.
   * @retval None
-  * @note   This function prepares and sends data to the LCD screen via the I2C bus.
-  *         The function divides the data into upper and lower 4-bit parts, puts them 
-  *         into an LCD buffer, and sends them sequentially to trigger the control (enable) 
-  *         and selection (RS) signals of the LCD screen.
-  *         The control signals indicate to the LCD screen that it is data, 
-  *         and the enable bit triggers the reading of the data by the LCD screen.
-  *
-  * @note   For the LCD_SEND_DATA function:
-  *         - The upper_data variable holds the upper 4 bits of the data.
-  *         - The lower_data variable holds the lower 4 bits of the data.
-  *         - The lcd_Buffer is a buffer array used for constructing the data to be sent.
-  *         - The LCD_BUFFER_SIZE specifies the size of the lcd_Buffer array.
-  *         - The UPPER_BITS_MASK is a bitmask to extract the upper 4 bits of a byte.
-  *         - The RS_EN_ON_MASK and RS_BIT_MASK are masks for control bits.
-  *         - The TIMEOUT is the maximum time to wait for the I2C transmission to complete.
+  * @note   The character is handed to the transport selected by LCD_TRANSPORT
+  *         (I2C backpack, direct GPIO bus or SPI shift register) with RS high.
   */
 
 void LCD_SEND_DATA(char data)
 {
-  uint8_t lcd_Buffer[LCD_BUFFER_SIZE];
-  char upper_data, lower_data;
-  upper_data = (data & UPPER_BITS_MASK);
-  lower_data = ((data << LCD_BUFFER_SIZE) & UPPER_BITS_MASK);
-  
-  // Constructing the LCD buffer with control (enable) and selection (RS) signals
-  lcd_Buffer[0]  = upper_data|RS_EN_ON_MASK;  //en=1, rs=1
-  lcd_Buffer[1]  = upper_data|RS_BIT_MASK;    //en=0, rs=1
-  lcd_Buffer[2]  = lower_data|RS_EN_ON_MASK;  //en=1, rs=1
-  lcd_Buffer[3]  = lower_data|RS_BIT_MASK;    //en=0, rs=1
-  HAL_I2C_Master_Transmit (&hi2c2, SLAVE_ADDRESS_LCD, (uint8_t *) lcd_Buffer, LCD_BUFFER_SIZE, TIMEOUT);
+  LCD_WRITE_DATA((uint8_t) data);
+  LCD_TRANSPORT_FLUSH();
 }
 
 
@@ -91,11 +304,12 @@ void LCD_SEND_DATA(char data)
 void LCD_CLEAR(void)
 {
   // Set the cursor to the beginning of the first row
-  LCD_SEND_CMD(LCD_CURSOR_ROW_FIRST);
+  LCD_WRITE_CMD(LCD_CURSOR_ROW_FIRST);
 
   // Send space (' ') characters to clear the display
   for (char i = 0; i < LCD_CLEAR_ROW_LENGTH; i++)
-    LCD_SEND_DATA(' ');
+    LCD_WRITE_DATA(' ');
+  LCD_TRANSPORT_FLUSH();
 }
 
 
@@ -126,13 +340,15 @@ void LCD_SET_CURSOR(int row, int col)
   * @brief  Initializes the LCD screen.
   * @param  None
   * @retval None
-  * @note   This function initializes the LCD screen. It follows a step-by-step process for proper
-  *         initialization, including setting the LCD to 4-bit mode, configuring display settings,
+  * @note   This function initializes the selected transport and then the LCD screen. It follows
+  *         a step-by-step process for proper initialization, including setting the LCD to 4-bit mode
+  *         (or 8-bit mode for an 8-bit GPIO bus), configuring display settings,
   *         and enabling the display.
   *
   * @note   For the LCD_INIT function:
   *         - The LCD_INIT_CMD_8BIT is a command for initializing the LCD in 8-bit mode.
   *         - The LCD_INIT_CMD_4BIT is a command for switching the LCD to 4-bit mode.
+  *         - The LCD_INIT_CMD_FUNCTION_SET_8BIT replaces LCD_INIT_CMD_FUNCTION_SET on an 8-bit bus.
   *         - The DELAY_50MS, DELAY_5MS, DELAY_1MS, and DELAY_10MS are delay values for waiting
   *           specific durations during the initialization process.
   *         - The LCD_INIT_CMD_FUNCTION_SET, LCD_INIT_CMD_DISPLAY_OFF, LCD_INIT_CMD_CLEAR_DISPLAY,
@@ -143,6 +359,21 @@ void LCD_SET_CURSOR(int row, int col)
 
 void LCD_INIT(void)
 {
+  LCD_TRANSPORT_INIT();
+
+#if (LCD_TRANSPORT == LCD_TRANSPORT_GPIO) && (LCD_GPIO_BUS_WIDTH == 8)
+  // Initialisation en mode 8 bits
+  HAL_Delay(DELAY_50MS);
+  LCD_SEND_CMD(LCD_INIT_CMD_8BIT);
+  HAL_Delay(DELAY_5MS);
+  LCD_SEND_CMD(LCD_INIT_CMD_8BIT);
+  HAL_Delay(DELAY_1MS);
+  LCD_SEND_CMD(LCD_INIT_CMD_8BIT);
+  HAL_Delay(DELAY_10MS);
+
+  // dislay initialisation
+  LCD_SEND_CMD (LCD_INIT_CMD_FUNCTION_SET_8BIT); // Function set --> DL=1 (8 bit mode), N = 1 (2 line display) F = 0 (5x8 characters)
+#else
   // Initialisation en mode 4 bits
   HAL_Delay(DELAY_50MS);
   LCD_SEND_CMD(LCD_INIT_CMD_8BIT);
@@ -156,6 +387,7 @@ void LCD_INIT(void)
 
   // dislay initialisation
   LCD_SEND_CMD (LCD_INIT_CMD_FUNCTION_SET); // Function set --> DL=0 (4 bit mode), N = 1 (2 line display) F = 0 (5x8 characters)
+#endif
   HAL_Delay(DELAY_1MS);
   LCD_SEND_CMD (LCD_INIT_CMD_DISPLAY_OFF); //Display on/off control --> D=0,C=0, B=0  ---> display off
   HAL_Delay(DELAY_1MS);
@@ -177,11 +409,46 @@ void LCD_INIT(void)
   *
   * @note   For the LCD_SEND_STRING function:
   *         - The *str is a pointer to the input string.
+  *         - The characters are batched and flushed to the transport once at the end.
   */
 
 void LCD_SEND_STRING(char *str)
 {
-  while (*str) LCD_SEND_DATA(*str++);
+  while (*str) LCD_WRITE_DATA(*str++);
+  LCD_TRANSPORT_FLUSH();
+}
+
+
+/**
+  * @brief  Writes a full row, sending only the cells that differ from what is on screen.
+  * @param  row: The row to be written (0 or 1).
+  * @param  str: Pointer to the text; it is padded with spaces (or cut) to LCD_CLEAR_ROW_LENGTH.
+  * @retval None
+  * @note   The driver keeps a shadow copy of the display RAM. Each run of changed cells
+  *         costs one set-cursor command plus its characters, and an unchanged row costs
+  *         no bus traffic at all. For a periodically refreshed value this usually leaves
+  *         only the changing digits on the wire.
+  */
+
+void LCD_WRITE_ROW(int row, const char *str)
+{
+  uint8_t cursor = (row == 0) ? LCD_CURSOR_ROW_FIRST : LCD_CURSOR_ROW_SECOND;
+
+  if ((row < 0) || (row >= LCD_ROWS))
+    return;
+
+  for (int col = 0; col < LCD_CLEAR_ROW_LENGTH; col++)
+  {
+    char c = *str ? *str++ : ' ';
+
+    if (lcd_Shadow[row][col] == c)
+      continue;
+
+    if ((lcd_Row != row) || (lcd_Col != col))
+      LCD_WRITE_CMD(cursor | col);
+    LCD_WRITE_DATA(c);
+  }
+  LCD_TRANSPORT_FLUSH();
 }
 
 /**
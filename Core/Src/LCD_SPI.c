@@ -0,0 +1,171 @@
+#include "LCD_I2C.h"
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_SPI
+
+#include "DWT_DELAY.h"
+#include <string.h>
+
+#define LCD_SPI_STATES_SIZE           (LCD_SPI_BUFFER_BYTES * LCD_SPI_STATES_PER_BYTE)
+#define LCD_SPI_DMA_STREAM            DMA2_Stream5      // TIM1_UP request
+#define LCD_SPI_DMA_CHANNEL           6
+#define LCD_SPI_DMA_FLAGS             (DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | \
+                                       DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5)
+
+static uint8_t lcd_States[2][LCD_SPI_STATES_SIZE];
+static uint16_t lcd_Fill;
+static uint8_t lcd_Active;
+static uint8_t lcd_Home_Pending;
+
+
+/**
+  * @brief  Waits until the DMA stream has sent its last backpack state.
+  * @param  None
+  * @retval None
+  * @note   The stream clears its EN bit on transfer complete. The LCD_SPI_TIMEOUT guard keeps
+  *         a stalled timer from blocking the caller forever.
+  */
+
+static void LCD_SPI_WAIT(void)
+{
+  uint32_t start = HAL_GetTick();
+
+  while ((LCD_SPI_DMA_STREAM->CR & DMA_SxCR_EN) && ((HAL_GetTick() - start) < LCD_SPI_TIMEOUT));
+}
+
+
+/**
+  * @brief  Starts the DMA transfer of the active buffer and switches to the other one.
+  * @param  None
+  * @retval None
+  * @note   TIM1 is stopped and restarted with an update event (UG) so that the first state
+  *         is written to SPI1->DR at the very start of a timer period. Every state is then
+  *         shifted out and latched at a fixed point of its own period, which keeps the latch
+  *         edge away from the shifting byte.
+  */
+
+static void LCD_SPI_START(void)
+{
+  LCD_SPI_WAIT();
+
+  TIM1->CR1 &= ~TIM_CR1_CEN;
+  DMA2->HIFCR = LCD_SPI_DMA_FLAGS;
+  LCD_SPI_DMA_STREAM->M0AR = (uint32_t) lcd_States[lcd_Active];
+  LCD_SPI_DMA_STREAM->NDTR = lcd_Fill;
+  LCD_SPI_DMA_STREAM->CR |= DMA_SxCR_EN;
+  TIM1->EGR = TIM_EGR_UG;
+  TIM1->CR1 |= TIM_CR1_CEN;
+
+  lcd_Active ^= 1;
+  lcd_Fill = 0;
+}
+
+
+/**
+  * @brief  Configures SPI1, TIM1 and the DMA stream used to feed the 74HC595 backpack.
+  * @param  None
+  * @retval None
+  * @note   The peripherals are programmed at register level because only the GPIO, TIM and
+  *         DMA HAL modules are part of this project.
+  */
+
+void LCD_TRANSPORT_INIT(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  DWT_DELAY_INIT();
+  __HAL_RCC_GPIOA_CLK_ENABLE();
+  __HAL_RCC_SPI1_CLK_ENABLE();
+  __HAL_RCC_TIM1_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+
+  /**SPI1 / TIM1 GPIO Configuration
+  PA5     ------> SPI1_SCK  (595 SRCLK)
+  PA7     ------> SPI1_MOSI (595 SER)
+  PA8     ------> TIM1_CH1  (595 RCLK)
+  */
+  GPIO_InitStruct.Pin = GPIO_PIN_5|GPIO_PIN_7;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+  GPIO_InitStruct.Alternate = GPIO_AF5_SPI1;
+  HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+  GPIO_InitStruct.Pin = GPIO_PIN_8;
+  GPIO_InitStruct.Alternate = GPIO_AF1_TIM1;
+  HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+  // SPI1: master, mode 0, MSB first, PCLK2/4 = 9 MHz, software NSS
+  SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_BR_0;
+  SPI1->CR1 |= SPI_CR1_SPE;
+
+  // DMA2 Stream5 channel 6 (TIM1_UP): memory to SPI1->DR, byte wide
+  LCD_SPI_DMA_STREAM->CR = 0;
+  LCD_SPI_DMA_STREAM->PAR = (uint32_t) &SPI1->DR;
+  LCD_SPI_DMA_STREAM->CR = (LCD_SPI_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PL_1 |
+                           DMA_SxCR_MINC | DMA_SxCR_DIR_0;
+
+  // TIM1: one period per backpack state, CH1 in PWM mode 2 drives the latch high late in the period
+  TIM1->PSC = 0;
+  TIM1->ARR = LCD_SPI_STATE_TICKS - 1;
+  TIM1->CCR1 = LCD_SPI_LATCH_TICKS;
+  TIM1->CCMR1 = TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1M_0 | TIM_CCMR1_OC1PE;
+  TIM1->CCER = TIM_CCER_CC1E;
+  TIM1->BDTR = TIM_BDTR_MOE;
+  TIM1->DIER = TIM_DIER_UDE;
+  TIM1->EGR = TIM_EGR_UG;
+}
+
+
+/**
+  * @brief  Expands one instruction or character into backpack states in the active buffer.
+  * @param  value: The instruction or character code.
+  * @param  rs: LCD_RS_CMD for an instruction, LCD_RS_DATA for a character.
+  * @retval None
+  * @note   The four nibble/enable states come from LCD_BACKPACK_ENCODE. The last (enable low)
+  *         state is repeated up to LCD_SPI_STATES_PER_BYTE so the LCD gets its execution time
+  *         without any CPU involvement. A full buffer is started immediately while the
+  *         other one keeps filling. Clear display and return home flush at once and wait
+  *         for their longer execution time on the next write.
+  */
+
+void LCD_TRANSPORT_WRITE(uint8_t value, uint8_t rs)
+{
+  uint8_t *state;
+
+  if (lcd_Home_Pending)
+  {
+    LCD_SPI_WAIT();
+    DWT_DELAY_US(LCD_SPI_HOME_EXEC_US);
+    lcd_Home_Pending = 0;
+  }
+
+  state = &lcd_States[lcd_Active][lcd_Fill];
+  LCD_BACKPACK_ENCODE(value, rs, state);
+  memset(&state[LCD_BUFFER_SIZE], state[LCD_BUFFER_SIZE - 1], LCD_SPI_STATES_PER_BYTE - LCD_BUFFER_SIZE);
+  lcd_Fill += LCD_SPI_STATES_PER_BYTE;
+
+  if ((rs == LCD_RS_CMD) && (value <= LCD_CMD_RETURN_HOME_X + LCD_CMD_RETURN_HOME))
+  {
+    LCD_SPI_START();
+    lcd_Home_Pending = 1;
+  }
+  else if (lcd_Fill >= LCD_SPI_STATES_SIZE)
+    LCD_SPI_START();
+}
+
+
+/**
+  * @brief  Starts the transfer of any states queued since the last flush.
+  * @param  None
+  * @retval None
+  * @note   The function returns as soon as the DMA is running; the CPU does not wait for
+  *         the LCD unless it writes again before the previous buffer has drained.
+  */
+
+void LCD_TRANSPORT_FLUSH(void)
+{
+  if (lcd_Fill)
+    LCD_SPI_START();
+}
+
+#endif /* LCD_TRANSPORT == LCD_TRANSPORT_SPI */
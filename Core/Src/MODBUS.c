@@ -0,0 +1,458 @@
+#include "MODBUS.h"
+#include "SNAPSHOT.h"
+#include "TIME.h"
+#include "DWT_DELAY.h"
+#include <string.h>
+
+#define MODBUS_RX_FLAGS               (DMA_LIFCR_CTCIF1 | DMA_LIFCR_CHTIF1 | DMA_LIFCR_CTEIF1 | \
+                                       DMA_LIFCR_CDMEIF1 | DMA_LIFCR_CFEIF1)
+#define MODBUS_TX_FLAGS               (DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | \
+                                       DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6)
+#define MODBUS_LINE_ERRORS            (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE)
+
+static uint8_t modbus_Rx[MODBUS_FRAME_MAX];
+static uint8_t modbus_Tx[MODBUS_FRAME_MAX];
+static uint8_t modbus_Pending[MODBUS_FRAME_MAX];        // Write request waiting for MODBUS_SERVICE
+static volatile uint16_t modbus_Pending_Len;
+static uint16_t modbus_Crc_Table[256];
+static SNAPSHOT_Handle modbus_Snapshot;
+static MODBUS_Image modbus_Image_Copy[2];
+static MODBUS_Stats modbus_Stats;
+
+
+static inline uint16_t MODBUS_GET16(const uint8_t *p)
+{
+  return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+
+static inline void MODBUS_PUT16(uint8_t *p, uint16_t value)
+{
+  p[0] = (uint8_t) (value >> 8);
+  p[1] = (uint8_t) value;
+}
+
+
+/**
+  * @brief  Turns reception on for the next request.
+  * @param  None
+  * @retval None
+  * @note   Bytes that arrived while reception was off (the echo of our own response on a
+  *         two-wire line) are discarded with the error flags.
+  */
+
+static void MODBUS_RX_START(void)
+{
+  MODBUS_RX_STREAM->CR &= ~DMA_SxCR_EN;
+  while (MODBUS_RX_STREAM->CR & DMA_SxCR_EN)
+    ;
+  (void) USART6->SR;
+  (void) USART6->DR;
+  DMA2->LIFCR = MODBUS_RX_FLAGS;
+  MODBUS_RX_STREAM->M0AR = (uint32_t) modbus_Rx;
+  MODBUS_RX_STREAM->NDTR = MODBUS_FRAME_MAX;
+  MODBUS_RX_STREAM->CR |= DMA_SxCR_EN;
+  USART6->CR1 |= USART_CR1_RE;
+}
+
+
+/**
+  * @brief  Appends the CRC to a response in modbus_Tx and starts sending it.
+  * @param  length: Response length without the CRC.
+  * @retval None
+  * @note   Reception resumes from the transmission-complete interrupt, once the driver is off.
+  */
+
+static void MODBUS_TX_START(uint16_t length)
+{
+  uint16_t crc = MODBUS_CRC16(modbus_Tx, length);
+
+  modbus_Tx[length++] = (uint8_t) crc;                  // CRC low byte first
+  modbus_Tx[length++] = (uint8_t) (crc >> 8);
+
+  MODBUS_DE_PORT->BSRR = MODBUS_DE_PIN;
+  DMA2->HIFCR = MODBUS_TX_FLAGS;
+  MODBUS_TX_STREAM->M0AR = (uint32_t) modbus_Tx;
+  MODBUS_TX_STREAM->NDTR = length;
+  USART6->SR = ~USART_SR_TC & 0x3FF;                   // rc_w0: clears TC only
+  USART6->CR1 |= USART_CR1_TCIE;
+  MODBUS_TX_STREAM->CR |= DMA_SxCR_EN;
+  modbus_Stats.responses++;
+}
+
+
+/**
+  * @brief  Builds an exception response in modbus_Tx.
+  * @param  function: Function code of the request.
+  * @param  code: MODBUS_EX_xxx.
+  * @retval Response length without the CRC.
+  */
+
+static uint16_t MODBUS_EXCEPTION(uint8_t function, uint8_t code)
+{
+  modbus_Tx[0] = MODBUS_ADDRESS;
+  modbus_Tx[1] = function | 0x80;
+  modbus_Tx[2] = code;
+  modbus_Stats.exceptions++;
+  return 3;
+}
+
+
+/**
+  * @brief  Handles a received request in interrupt context.
+  * @param  length: Request length including the CRC.
+  * @retval Response length in modbus_Tx without the CRC, 0 for no response now (not for us,
+  *         broadcast, or a write handed to MODBUS_SERVICE).
+  */
+
+static uint16_t MODBUS_REQUEST(uint16_t length)
+{
+  const uint8_t *req = modbus_Rx;
+  uint8_t function;
+
+  if (length < 4)
+    return 0;
+  if ((req[0] != MODBUS_ADDRESS) && (req[0] != 0))
+  {
+    modbus_Stats.other++;
+    return 0;
+  }
+  if (MODBUS_CRC16(req, length - 2) != (uint16_t) (req[length - 2] | (req[length - 1] << 8)))
+  {
+    modbus_Stats.crc_errors++;
+    return 0;
+  }
+  modbus_Stats.frames++;
+  function = req[1];
+
+  if ((function == 0x03) || (function == 0x04))
+  {
+    MODBUS_Image image;
+    uint16_t regs = (function == 0x03) ? MODBUS_HOLDING_REGS : MODBUS_INPUT_REGS;
+
+    if (req[0] == 0)
+      return 0;                                         // Reads are never broadcast
+    if (length != 8)
+      return MODBUS_EXCEPTION(function, MODBUS_EX_VALUE);
+    uint16_t start = MODBUS_GET16(req + 2);
+    uint16_t count = MODBUS_GET16(req + 4);
+    if ((count == 0) || (count > 125))
+      return MODBUS_EXCEPTION(function, MODBUS_EX_VALUE);
+    if ((uint32_t) start + count > regs)
+      return MODBUS_EXCEPTION(function, MODBUS_EX_ADDRESS);
+
+    SNAPSHOT_READ(&modbus_Snapshot, &image);
+    modbus_Tx[0] = MODBUS_ADDRESS;
+    modbus_Tx[1] = function;
+    modbus_Tx[2] = (uint8_t) (2 * count);
+    memcpy(&modbus_Tx[3], ((function == 0x03) ? image.holding : image.input) + 2 * start, 2 * count);
+    return (uint16_t) (3 + 2 * count);
+  }
+
+  if ((function == 0x06) || (function == 0x10))
+  {
+    memcpy(modbus_Pending, req, length);
+    modbus_Pending_Len = length;
+    return 0;
+  }
+
+  return (req[0] == 0) ? 0 : MODBUS_EXCEPTION(function, MODBUS_EX_FUNCTION);
+}
+
+
+/**
+  * @brief  Applies a pending write request and builds its response in modbus_Tx.
+  * @param  params: Active configuration parameters.
+  * @retval Response length without the CRC.
+  */
+
+static uint16_t MODBUS_WRITE(const CONFIG_Params *params)
+{
+  const uint8_t *req = modbus_Pending;
+  uint16_t length = modbus_Pending_Len;
+  uint8_t function = req[1];
+  const uint8_t *values;
+  uint16_t start, count;
+  uint16_t regs[MODBUS_HOLDING_REGS];
+  MODBUS_Image image;
+
+  if (function == 0x06)
+  {
+    if (length != 8)
+      return MODBUS_EXCEPTION(function, MODBUS_EX_VALUE);
+    start = MODBUS_GET16(req + 2);
+    count = 1;
+    values = req + 4;
+  }
+  else
+  {
+    start = MODBUS_GET16(req + 2);
+    count = MODBUS_GET16(req + 4);
+    if ((length < 9) || (count == 0) || (count > 123) || (req[6] != 2 * count) || (length != 9 + 2 * count))
+      return MODBUS_EXCEPTION(function, MODBUS_EX_VALUE);
+    values = req + 7;
+  }
+  if ((uint32_t) start + count > MODBUS_HOLDING_REGS)
+    return MODBUS_EXCEPTION(function, MODBUS_EX_ADDRESS);
+
+  // Registers not written keep their current values
+  SNAPSHOT_READ(&modbus_Snapshot, &image);
+  for (uint16_t r = 0; r < MODBUS_HOLDING_REGS; r++)
+    regs[r] = MODBUS_GET16(&image.holding[2 * r]);
+  for (uint16_t i = 0; i < count; i++)
+    regs[start + i] = MODBUS_GET16(values + 2 * i);
+
+  if (start < MODBUS_HR_TIME)
+  {
+    CONFIG_Params next = *params;
+
+    for (uint8_t ch = 0; ch < CONFIG_CHANNELS; ch++)
+    {
+      next.period_ms[ch] = regs[MODBUS_HR_PERIOD + ch];
+      next.gain[ch] = (int16_t) regs[MODBUS_HR_GAIN + ch];
+      next.offset[ch] = (int16_t) regs[MODBUS_HR_OFFSET + ch];
+      next.limit[ch] = regs[MODBUS_HR_LIMIT + ch];
+    }
+    next.filter_shift = (uint8_t) regs[MODBUS_HR_FILTER_SHIFT];
+    next.decimate = (uint8_t) regs[MODBUS_HR_DECIMATE];
+    if ((regs[MODBUS_HR_FILTER_SHIFT] > 0xFF) || (regs[MODBUS_HR_DECIMATE] > 0xFF) ||
+        (CONFIG_VALIDATE(&next) != 0))
+      return MODBUS_EXCEPTION(function, MODBUS_EX_VALUE);
+
+    CONFIG_Params *edit = CONFIG_EDIT();
+    if (edit == NULL)
+      return MODBUS_EXCEPTION(function, MODBUS_EX_BUSY);   // Previous change still being picked up
+    *edit = next;
+    if (CONFIG_COMMIT() != 0)
+      return MODBUS_EXCEPTION(function, MODBUS_EX_FAILURE);
+  }
+  if ((uint32_t) start + count > MODBUS_HR_TIME)
+  {
+    uint32_t unix_s = ((uint32_t) regs[MODBUS_HR_TIME] << 16) | regs[MODBUS_HR_TIME + 1];
+    if (TIME_SET(unix_s) != 0)
+      return MODBUS_EXCEPTION(function, MODBUS_EX_VALUE);
+  }
+  modbus_Stats.writes++;
+
+  memcpy(modbus_Tx, req, 6);                            // Echo of address, function, start, count/value
+  modbus_Tx[0] = MODBUS_ADDRESS;
+  return 6;
+}
+
+
+/**
+  * @brief  Sets up USART6, its DMA streams and the driver-enable output, and starts listening.
+  * @param  None
+  * @retval None
+  * @note   Register level, like the exporter (no UART HAL in this project).
+  */
+
+void MODBUS_INIT(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  __HAL_RCC_GPIOC_CLK_ENABLE();
+  __HAL_RCC_USART6_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
+
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint16_t crc = (uint16_t) i;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    modbus_Crc_Table[i] = crc;
+  }
+  memset(&modbus_Stats, 0, sizeof(modbus_Stats));
+  modbus_Pending_Len = 0;
+  SNAPSHOT_INIT(&modbus_Snapshot, &modbus_Image_Copy[0], &modbus_Image_Copy[1], sizeof(MODBUS_Image));
+
+  /**USART6 GPIO Configuration
+  PC6     ------> USART6_TX
+  PC7     ------> USART6_RX
+  PC8     ------> RS-485 DE
+  */
+  HAL_GPIO_WritePin(MODBUS_DE_PORT, MODBUS_DE_PIN, GPIO_PIN_RESET);
+  GPIO_InitStruct.Pin = MODBUS_DE_PIN;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(MODBUS_DE_PORT, &GPIO_InitStruct);
+  GPIO_InitStruct.Pin = GPIO_PIN_6 | GPIO_PIN_7;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Pull = GPIO_PULLUP;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+  GPIO_InitStruct.Alternate = GPIO_AF8_USART6;
+  HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+  // USART6: 8 data bits + even parity (M = 1, PCE), oversampling by 16, DMA both ways
+  USART6->CR1 = 0;
+  USART6->BRR = (HAL_RCC_GetPCLK2Freq() + (MODBUS_BAUDRATE / 2)) / MODBUS_BAUDRATE;
+  USART6->CR3 = USART_CR3_DMAR | USART_CR3_DMAT;
+  USART6->CR1 = USART_CR1_UE | USART_CR1_M | USART_CR1_PCE | USART_CR1_TE | USART_CR1_IDLEIE;
+
+  // DMA2 Stream1 (RX): USART6->DR to modbus_Rx. DMA2 Stream6 (TX): modbus_Tx to USART6->DR.
+  MODBUS_RX_STREAM->CR = 0;
+  MODBUS_RX_STREAM->PAR = (uint32_t) &USART6->DR;
+  MODBUS_RX_STREAM->CR = (MODBUS_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC;
+  MODBUS_TX_STREAM->CR = 0;
+  MODBUS_TX_STREAM->PAR = (uint32_t) &USART6->DR;
+  MODBUS_TX_STREAM->CR = (MODBUS_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_DIR_0;
+
+  HAL_NVIC_SetPriority(USART6_IRQn, MODBUS_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(USART6_IRQn);
+  MODBUS_RX_START();
+}
+
+
+/**
+  * @brief  Refreshes the register image from the channel snapshot and the configuration, and
+  *         applies a write request handed over by the interrupt.
+  * @param  params: Active configuration parameters.
+  * @retval None
+  * @note   Call from one task only, after CHANNEL_PROCESS.
+  */
+
+void MODBUS_SERVICE(const CONFIG_Params *params)
+{
+  MODBUS_Image image;
+  CHANNEL_Snapshot snap;
+  TIME_Mono mono;
+  uint32_t uptime = HAL_GetTick() / 1000;
+  uint32_t latency_us = modbus_Stats.latency_max_cycles / (SystemCoreClock / 1000000U);
+  uint32_t unix_s;
+
+  if (modbus_Pending_Len)
+  {
+    uint16_t length = MODBUS_WRITE(params);
+
+    if (modbus_Pending[0] == 0)
+      length = 0;                                       // Broadcast: applied, not answered
+    modbus_Pending_Len = 0;
+    if (length)
+      MODBUS_TX_START(length);
+    else
+      MODBUS_RX_START();
+  }
+
+  memset(&image, 0, sizeof(image));
+  CHANNEL_READ_SNAPSHOT(&snap);
+  MODBUS_PUT16(&image.input[2 * MODBUS_IR_CHANNELS], snap.count);
+  MODBUS_PUT16(&image.input[2 * MODBUS_IR_PASS], (uint16_t) (snap.pass >> 16));
+  MODBUS_PUT16(&image.input[2 * MODBUS_IR_PASS + 2], (uint16_t) snap.pass);
+  MODBUS_PUT16(&image.input[2 * MODBUS_IR_UPTIME], (uint16_t) (uptime >> 16));
+  MODBUS_PUT16(&image.input[2 * MODBUS_IR_UPTIME + 2], (uint16_t) uptime);
+  MODBUS_PUT16(&image.input[2 * MODBUS_IR_LATENCY], (uint16_t) (latency_us >> 16));
+  MODBUS_PUT16(&image.input[2 * MODBUS_IR_LATENCY + 2], (uint16_t) latency_us);
+  for (uint8_t ch = 0; ch < snap.count; ch++)
+  {
+    uint8_t *p = &image.input[2 * (MODBUS_IR_CHANNEL_BASE + MODBUS_IR_CHANNEL_STRIDE * ch)];
+    MODBUS_PUT16(p, snap.raw[ch]);
+    MODBUS_PUT16(p + 2, snap.filtered[ch]);
+    MODBUS_PUT16(p + 4, (uint16_t) snap.scaled[ch]);
+    MODBUS_PUT16(p + 6, snap.flags[ch]);
+  }
+
+  for (uint8_t ch = 0; ch < CONFIG_CHANNELS; ch++)
+  {
+    MODBUS_PUT16(&image.holding[2 * (MODBUS_HR_PERIOD + ch)], params->period_ms[ch]);
+    MODBUS_PUT16(&image.holding[2 * (MODBUS_HR_GAIN + ch)], (uint16_t) params->gain[ch]);
+    MODBUS_PUT16(&image.holding[2 * (MODBUS_HR_OFFSET + ch)], (uint16_t) params->offset[ch]);
+    MODBUS_PUT16(&image.holding[2 * (MODBUS_HR_LIMIT + ch)], params->limit[ch]);
+  }
+  MODBUS_PUT16(&image.holding[2 * MODBUS_HR_FILTER_SHIFT], params->filter_shift);
+  MODBUS_PUT16(&image.holding[2 * MODBUS_HR_DECIMATE], params->decimate);
+  TIME_MONO_NOW(&mono);
+  unix_s = (uint32_t) (TIME_TO_WALL_US(&mono) / 1000000);
+  MODBUS_PUT16(&image.holding[2 * MODBUS_HR_TIME], (uint16_t) (unix_s >> 16));
+  MODBUS_PUT16(&image.holding[2 * MODBUS_HR_TIME + 2], (uint16_t) unix_s);
+
+  SNAPSHOT_PUBLISH(&modbus_Snapshot, &image);
+}
+
+
+/**
+  * @brief  Computes the Modbus CRC-16 (poly 0xA001 reflected, init 0xFFFF).
+  * @param  data: The bytes.
+  * @param  length: Number of bytes.
+  * @retval The CRC, sent low byte first.
+  */
+
+uint16_t MODBUS_CRC16(const uint8_t *data, uint32_t length)
+{
+  uint16_t crc = 0xFFFF;
+
+  while (length--)
+    crc = (crc >> 8) ^ modbus_Crc_Table[(crc ^ *data++) & 0xFF];
+  return crc;
+}
+
+
+/**
+  * @brief  Copies the slave counters.
+  * @param  stats: Receives the counters.
+  * @retval None
+  */
+
+void MODBUS_READ_STATS(MODBUS_Stats *stats)
+{
+  *stats = modbus_Stats;
+}
+
+
+/**
+  * @brief  USART6 interrupt: end of a request (idle line) or end of a response (TC).
+  * @param  None
+  * @retval None
+  * @note   Read requests are answered from here; the latency from the idle detection to the
+  *         start of the response is tracked in cycles.
+  */
+
+void MODBUS_IRQHandler(void)
+{
+  uint32_t sr = USART6->SR;
+
+  if ((sr & USART_SR_IDLE) && (USART6->CR1 & USART_CR1_RE))
+  {
+    uint32_t start = DWT_GET_CYCLES();
+    uint16_t length, response;
+
+    (void) USART6->DR;                                  // SR then DR read clears IDLE and errors
+    USART6->CR1 &= ~USART_CR1_RE;
+    MODBUS_RX_STREAM->CR &= ~DMA_SxCR_EN;
+    while (MODBUS_RX_STREAM->CR & DMA_SxCR_EN)
+      ;
+    length = MODBUS_FRAME_MAX - MODBUS_RX_STREAM->NDTR;
+
+    if (sr & MODBUS_LINE_ERRORS)
+    {
+      modbus_Stats.line_errors++;
+      response = 0;
+    }
+    else
+    {
+      response = MODBUS_REQUEST(length);
+    }
+
+    if (response)
+    {
+      MODBUS_TX_START(response);
+      if (DWT_GET_CYCLES() - start > modbus_Stats.latency_max_cycles)
+        modbus_Stats.latency_max_cycles = DWT_GET_CYCLES() - start;
+    }
+    else if (!modbus_Pending_Len)
+    {
+      MODBUS_RX_START();
+    }
+  }
+  else if (sr & USART_SR_IDLE)
+  {
+    (void) USART6->DR;
+  }
+
+  if ((sr & USART_SR_TC) && (USART6->CR1 & USART_CR1_TCIE))
+  {
+    USART6->CR1 &= ~USART_CR1_TCIE;
+    MODBUS_DE_PORT->BSRR = (uint32_t) MODBUS_DE_PIN << 16;
+    MODBUS_RX_START();
+  }
+}
@@ -0,0 +1,180 @@
+#include "PERSIST.h"
+#include "CHECKSUM.h"
+#include <string.h>
+
+static uint16_t persist_Offset[PERSIST_MAX_RECORDS];    // Of slot 0; slot 1 follows it
+static uint16_t persist_Length[PERSIST_MAX_RECORDS];
+static uint32_t persist_Sequence[PERSIST_MAX_RECORDS];  // Of the newest valid slot (0: none)
+static uint8_t persist_Latest[PERSIST_MAX_RECORDS];     // Slot holding that sequence
+static uint8_t persist_Count;
+static uint16_t persist_Used;
+static PERSIST_Stats persist_Stats;
+
+
+/**
+  * @brief  Returns the address of one slot of a record.
+  * @param  id: Record from PERSIST_DEFINE.
+  * @param  slot: 0 or 1.
+  * @retval The slot header, followed by the data.
+  */
+
+static PERSIST_Header *PERSIST_SLOT(int id, uint8_t slot)
+{
+  uint16_t size = (uint16_t) ((sizeof(PERSIST_Header) + persist_Length[id] + 3U) & ~3U);
+
+  return (PERSIST_Header *) (PERSIST_BASE + persist_Offset[id] + slot * size);
+}
+
+
+/**
+  * @brief  Checks one slot of a record.
+  * @param  id: Record from PERSIST_DEFINE.
+  * @param  slot: 0 or 1.
+  * @retval The slot sequence number if the slot is valid, otherwise 0.
+  */
+
+static uint32_t PERSIST_CHECK(int id, uint8_t slot)
+{
+  const PERSIST_Header *h = PERSIST_SLOT(id, slot);
+  PERSIST_Header copy = *h;
+  CHECKSUM_Ctx ctx;
+
+  if ((copy.magic != PERSIST_MAGIC) || (copy.id != id) || (copy.length != persist_Length[id]) ||
+      (copy.sequence == 0))
+    return 0;
+  copy.crc = 0;
+  CHECKSUM_BEGIN(&ctx);
+  CHECKSUM_UPDATE(&ctx, &copy, sizeof(copy));
+  CHECKSUM_UPDATE(&ctx, h + 1, copy.length);
+  return (CHECKSUM_FINISH(&ctx) == h->crc) ? copy.sequence : 0;
+}
+
+
+/**
+  * @brief  Turns on the backup SRAM, its write access and its regulator.
+  * @param  None
+  * @retval None
+  * @note   The content is left as it is; records are found again with PERSIST_DEFINE/PERSIST_LOAD.
+  */
+
+void PERSIST_INIT(void)
+{
+  __HAL_RCC_PWR_CLK_ENABLE();
+  HAL_PWR_EnableBkUpAccess();
+  __HAL_RCC_BKPSRAM_CLK_ENABLE();
+  HAL_PWREx_EnableBkUpReg();                            // Keeps the content on VBAT
+
+  persist_Count = 0;
+  persist_Used = 0;
+  memset(&persist_Stats, 0, sizeof(persist_Stats));
+}
+
+
+/**
+  * @brief  Reserves the two slots of a record and finds its newest valid copy.
+  * @param  length: Data bytes of the record.
+  * @retval The record id, or -1 if the backup SRAM or the record table is full.
+  * @note   Records must be defined in the same order on every boot to be found again.
+  */
+
+int PERSIST_DEFINE(uint16_t length)
+{
+  uint16_t size = (uint16_t) ((sizeof(PERSIST_Header) + length + 3U) & ~3U);
+  int id = persist_Count;
+
+  if ((persist_Count >= PERSIST_MAX_RECORDS) || (persist_Used + 2U * size > PERSIST_SIZE))
+    return -1;
+
+  persist_Offset[id] = persist_Used;
+  persist_Length[id] = length;
+  persist_Used += 2U * size;
+  persist_Count++;
+
+  uint32_t seq0 = PERSIST_CHECK(id, 0);
+  uint32_t seq1 = PERSIST_CHECK(id, 1);
+  persist_Latest[id] = (seq1 > seq0) ? 1 : 0;
+  persist_Sequence[id] = (seq1 > seq0) ? seq1 : seq0;
+  return id;
+}
+
+
+/**
+  * @brief  Copies out the newest valid copy of a record.
+  * @param  id: Record from PERSIST_DEFINE.
+  * @param  data: Receives the record data.
+  * @retval 0 on success, -1 if the record has never been saved or both slots are corrupt.
+  */
+
+int PERSIST_LOAD(int id, void *data)
+{
+  if ((id < 0) || (id >= persist_Count))
+    return -1;
+  if (persist_Sequence[id] == 0)
+  {
+    persist_Stats.invalid++;
+    return -1;
+  }
+  memcpy(data, PERSIST_SLOT(id, persist_Latest[id]) + 1, persist_Length[id]);
+  persist_Stats.restored++;
+  return 0;
+}
+
+
+/**
+  * @brief  Saves a record into the slot not holding its newest copy.
+  * @param  id: Record from PERSIST_DEFINE.
+  * @param  data: Record data (the length given to PERSIST_DEFINE).
+  * @retval 0 on success, -1 for an unknown record.
+  * @note   Not reentrant per record: each record is saved from one task only. The data is
+  *         written before the header, and the slot only becomes the newest once the header
+  *         (with its CRC) is complete.
+  */
+
+int PERSIST_SAVE(int id, const void *data)
+{
+  CHECKSUM_Ctx ctx;
+  PERSIST_Header header;
+  uint8_t slot;
+  PERSIST_Header *h;
+
+  if ((id < 0) || (id >= persist_Count))
+    return -1;
+
+  slot = (persist_Sequence[id] == 0) ? 0 : (uint8_t) (persist_Latest[id] ^ 1U);
+  h = PERSIST_SLOT(id, slot);
+  header.magic = PERSIST_MAGIC;
+  header.id = (uint16_t) id;
+  header.length = persist_Length[id];
+  header.sequence = persist_Sequence[id] + 1;
+  header.crc = 0;
+
+  h->magic = 0;                                         // Invalid until the new header is in
+  memcpy(h + 1, data, header.length);
+  CHECKSUM_BEGIN(&ctx);
+  CHECKSUM_UPDATE(&ctx, &header, sizeof(header));
+  CHECKSUM_UPDATE(&ctx, h + 1, header.length);
+  header.crc = CHECKSUM_FINISH(&ctx);
+  h->id = header.id;
+  h->length = header.length;
+  h->sequence = header.sequence;
+  h->crc = header.crc;
+  __DSB();
+  h->magic = PERSIST_MAGIC;
+
+  persist_Latest[id] = slot;
+  persist_Sequence[id] = header.sequence;
+  persist_Stats.saves++;
+  return 0;
+}
+
+
+/**
+  * @brief  Copies the save / restore counters.
+  * @param  stats: Receives the counters.
+  * @retval None
+  */
+
+void PERSIST_READ_STATS(PERSIST_Stats *stats)
+{
+  *stats = persist_Stats;
+}
@@ -0,0 +1,160 @@
+#include "PULSE.h"
+#include "SNAPSHOT.h"
+#include <string.h>
+
+static uint32_t pulse_Capture[2 * PULSE_CAPTURE_DEPTH];  // { CCR1, CCR2 } per rising edge
+static uint16_t pulse_Capture_Read;                     // Next pair to consume
+static uint16_t pulse_Count_Last;                       // TIM3->CNT at the previous service
+static uint64_t pulse_Total;
+static uint64_t pulse_Window_Start_Total;
+static uint32_t pulse_Window_Start_Ms;
+static uint32_t pulse_Period_Sum;                       // Sum over the pairs of the current window
+static uint32_t pulse_High_Sum;
+static uint16_t pulse_Periods;
+static uint32_t pulse_Windows;
+static SNAPSHOT_Handle pulse_Snapshot;
+static PULSE_Result pulse_Result_Copy[2];
+
+
+/**
+  * @brief  Configures the edge counter (TIM3) and the period/duty capture (TIM5 + DMA).
+  * @param  None
+  * @retval None
+  * @note   Both timers run without interrupts; the CPU only reads them in PULSE_SERVICE.
+  */
+
+void PULSE_INIT(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  __HAL_RCC_GPIOA_CLK_ENABLE();
+  __HAL_RCC_GPIOD_CLK_ENABLE();
+  __HAL_RCC_TIM3_CLK_ENABLE();
+  __HAL_RCC_TIM5_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /**TIM3 / TIM5 GPIO Configuration
+  PD2     ------> TIM3_ETR
+  PA0     ------> TIM5_CH1
+  */
+  GPIO_InitStruct.Pin = GPIO_PIN_2;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  GPIO_InitStruct.Alternate = GPIO_AF2_TIM3;
+  HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
+  GPIO_InitStruct.Pin = GPIO_PIN_0;
+  GPIO_InitStruct.Alternate = GPIO_AF2_TIM5;
+  HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+  // TIM3: external clock mode 2, every filtered ETR rising edge increments CNT
+  TIM3->CR1 = 0;
+  TIM3->PSC = 0;
+  TIM3->ARR = 0xFFFF;
+  TIM3->SMCR = TIM_SMCR_ECE | (PULSE_INPUT_FILTER << TIM_SMCR_ETF_Pos);
+  TIM3->EGR = TIM_EGR_UG;
+  TIM3->CR1 = TIM_CR1_CEN;
+
+  // TIM5: PWM input on TI1. CC1 = rising edge (period), CC2 = falling edge (high time),
+  // slave reset mode on TI1FP1, DMA burst of CCR1..CCR2 through DMAR on each CC1 event
+  TIM5->CR1 = 0;
+  TIM5->PSC = 0;
+  TIM5->ARR = 0xFFFFFFFF;
+  TIM5->CCMR1 = TIM_CCMR1_CC1S_0 | (PULSE_INPUT_FILTER << TIM_CCMR1_IC1F_Pos) | TIM_CCMR1_CC2S_1;
+  TIM5->CCER = TIM_CCER_CC1E | TIM_CCER_CC2E | TIM_CCER_CC2P;
+  TIM5->SMCR = (5U << TIM_SMCR_TS_Pos) | (4U << TIM_SMCR_SMS_Pos);
+  TIM5->DCR = (1U << TIM_DCR_DBL_Pos) | (((uint32_t) &TIM5->CCR1 - (uint32_t) &TIM5->CR1) / 4U);
+  TIM5->DIER = TIM_DIER_CC1DE;
+
+  // DMA1 Stream2 channel 6 (TIM5_CH1): TIM5->DMAR to the capture buffer, words, circular
+  PULSE_DMA_STREAM->CR = 0;
+  while (PULSE_DMA_STREAM->CR & DMA_SxCR_EN);
+  DMA1->LIFCR = DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2;
+  PULSE_DMA_STREAM->PAR = (uint32_t) &TIM5->DMAR;
+  PULSE_DMA_STREAM->M0AR = (uint32_t) pulse_Capture;
+  PULSE_DMA_STREAM->NDTR = 2 * PULSE_CAPTURE_DEPTH;
+  PULSE_DMA_STREAM->CR = (PULSE_DMA_CHANNEL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_PSIZE_1 | DMA_SxCR_MSIZE_1 |
+                         DMA_SxCR_MINC | DMA_SxCR_CIRC | DMA_SxCR_EN;
+
+  TIM5->EGR = TIM_EGR_UG;
+  TIM5->CR1 = TIM_CR1_CEN;
+
+  pulse_Capture_Read = 0;
+  pulse_Count_Last = TIM3->CNT;
+  pulse_Total = 0;
+  pulse_Window_Start_Total = 0;
+  pulse_Window_Start_Ms = HAL_GetTick();
+  pulse_Period_Sum = 0;
+  pulse_High_Sum = 0;
+  pulse_Periods = 0;
+  pulse_Windows = 0;
+  SNAPSHOT_INIT(&pulse_Snapshot, &pulse_Result_Copy[0], &pulse_Result_Copy[1], sizeof(PULSE_Result));
+}
+
+
+/**
+  * @brief  Collects new counts and captures, and closes the window when it is due.
+  * @param  now_ms: Current time (HAL_GetTick).
+  * @retval None
+  * @note   Call at least every 65535 edges (about 65 ms at 1 MHz) so the 16-bit counter
+  *         cannot wrap twice, and often enough that fewer than PULSE_CAPTURE_DEPTH periods
+  *         arrive in between (older captures are overwritten otherwise, the count is not).
+  *         The first capture after reset is the partial period since TIM5 started; it is
+  *         kept, which only matters for the very first window.
+  */
+
+void PULSE_SERVICE(uint32_t now_ms)
+{
+  uint16_t count = TIM3->CNT;
+  uint16_t write = (2 * PULSE_CAPTURE_DEPTH - PULSE_DMA_STREAM->NDTR) / 2;   // Next pair the DMA fills
+  uint16_t fresh = (write + PULSE_CAPTURE_DEPTH - pulse_Capture_Read) % PULSE_CAPTURE_DEPTH;
+
+  pulse_Total += (uint16_t)(count - pulse_Count_Last);
+  pulse_Count_Last = count;
+
+  // Averaging the new pairs into the window (overflow-safe up to ~59 s of summed periods)
+  for (uint16_t i = 0; i < fresh; i++)
+  {
+    uint16_t k = (pulse_Capture_Read + i) % PULSE_CAPTURE_DEPTH;
+    if (pulse_Period_Sum + pulse_Capture[2 * k] < pulse_Period_Sum)
+      break;
+    pulse_Period_Sum += pulse_Capture[2 * k];
+    pulse_High_Sum += pulse_Capture[2 * k + 1];
+    pulse_Periods++;
+  }
+  pulse_Capture_Read = write;
+
+  if (now_ms - pulse_Window_Start_Ms >= PULSE_WINDOW_MS)
+  {
+    PULSE_Result result;
+
+    result.total = pulse_Total;
+    result.window_count = (uint32_t)(pulse_Total - pulse_Window_Start_Total);
+    result.window_ms = now_ms - pulse_Window_Start_Ms;
+    result.count_freq_mhz = (uint32_t)(((uint64_t) result.window_count * 1000000U) / result.window_ms);
+    result.period_freq_mhz = pulse_Period_Sum ?
+        (uint32_t)(((uint64_t) PULSE_CAPTURE_CLOCK_HZ * 1000U * pulse_Periods) / pulse_Period_Sum) : 0;
+    result.duty_permille = pulse_Period_Sum ? (uint16_t)(((uint64_t) pulse_High_Sum * 1000U) / pulse_Period_Sum) : 0;
+    result.periods = pulse_Periods;
+    result.window = ++pulse_Windows;
+    SNAPSHOT_PUBLISH(&pulse_Snapshot, &result);
+
+    pulse_Window_Start_Total = pulse_Total;
+    pulse_Window_Start_Ms = now_ms;
+    pulse_Period_Sum = 0;
+    pulse_High_Sum = 0;
+    pulse_Periods = 0;
+  }
+}
+
+
+/**
+  * @brief  Copies the result of the last completed window, without locking.
+  * @param  result: Receives the result (all zero before the first window).
+  * @retval Number of copy attempts.
+  */
+
+uint32_t PULSE_READ(PULSE_Result *result)
+{
+  return SNAPSHOT_READ(&pulse_Snapshot, result);
+}
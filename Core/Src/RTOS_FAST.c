@@ -0,0 +1,94 @@
+#include "RTOS_FAST.h"
+#include "DWT_DELAY.h"
+
+#define RTOS_FAST_BENCH_RUNS          16
+
+
+/**
+  * @brief  Measures the per-call cost of the hot RTOS operations through CMSIS-RTOS2 and the shims.
+  * @param  bench: Receives DWT cycles per operation pair, { CMSIS-RTOS2, shim }.
+  * @retval None
+  * @note   Call from a task. Every operation is uncontended and never blocks. The bench objects
+  *         are created on the first call and kept.
+  */
+
+void RTOS_FAST_BENCH(RTOS_FAST_Bench *bench)
+{
+  static osMutexId_t mutex;
+  static osSemaphoreId_t semaphore;
+  static osMessageQueueId_t queue;
+  osThreadId_t self = osThreadGetId();
+  uint32_t msg = 0, start;
+
+  DWT_DELAY_INIT();
+  if (!mutex)
+  {
+    mutex = osMutexNew(NULL);
+    semaphore = osSemaphoreNew(1, 0, NULL);
+    queue = osMessageQueueNew(1, sizeof(msg), NULL);
+  }
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < RTOS_FAST_BENCH_RUNS; i++)
+  {
+    osMutexAcquire(mutex, osWaitForever);
+    osMutexRelease(mutex);
+  }
+  bench->mutex[0] = (DWT_GET_CYCLES() - start) / RTOS_FAST_BENCH_RUNS;
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < RTOS_FAST_BENCH_RUNS; i++)
+  {
+    RTOS_MUTEX_ACQUIRE(mutex, osWaitForever);
+    RTOS_MUTEX_RELEASE(mutex);
+  }
+  bench->mutex[1] = (DWT_GET_CYCLES() - start) / RTOS_FAST_BENCH_RUNS;
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < RTOS_FAST_BENCH_RUNS; i++)
+  {
+    osSemaphoreRelease(semaphore);
+    osSemaphoreAcquire(semaphore, 0);
+  }
+  bench->semaphore[0] = (DWT_GET_CYCLES() - start) / RTOS_FAST_BENCH_RUNS;
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < RTOS_FAST_BENCH_RUNS; i++)
+  {
+    RTOS_SEMAPHORE_RELEASE(semaphore);
+    RTOS_SEMAPHORE_ACQUIRE(semaphore, 0);
+  }
+  bench->semaphore[1] = (DWT_GET_CYCLES() - start) / RTOS_FAST_BENCH_RUNS;
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < RTOS_FAST_BENCH_RUNS; i++)
+  {
+    osThreadFlagsSet(self, 1U);
+    osThreadFlagsWait(1U, osFlagsWaitAny, 0);
+  }
+  bench->notify[0] = (DWT_GET_CYCLES() - start) / RTOS_FAST_BENCH_RUNS;
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < RTOS_FAST_BENCH_RUNS; i++)
+  {
+    RTOS_NOTIFY(self);
+    RTOS_NOTIFY_WAIT(0);
+  }
+  bench->notify[1] = (DWT_GET_CYCLES() - start) / RTOS_FAST_BENCH_RUNS;
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < RTOS_FAST_BENCH_RUNS; i++)
+  {
+    osMessageQueuePut(queue, &msg, 0, 0);
+    osMessageQueueGet(queue, &msg, NULL, 0);
+  }
+  bench->queue[0] = (DWT_GET_CYCLES() - start) / RTOS_FAST_BENCH_RUNS;
+
+  start = DWT_GET_CYCLES();
+  for (uint8_t i = 0; i < RTOS_FAST_BENCH_RUNS; i++)
+  {
+    RTOS_QUEUE_PUT(queue, &msg, 0);
+    RTOS_QUEUE_GET(queue, &msg, 0);
+  }
+  bench->queue[1] = (DWT_GET_CYCLES() - start) / RTOS_FAST_BENCH_RUNS;
+}
@@ -0,0 +1,199 @@
+#include "RTT.h"
+#include <string.h>
+
+RTT_Control _SEGGER_RTT __attribute__((used));          // Well-known name, looked up by RTT readers
+static char rtt_Terminal[RTT_TERMINAL_SIZE];
+static char rtt_Trace[RTT_TRACE_SIZE];
+static char rtt_Samples[RTT_SAMPLES_SIZE];
+static char rtt_Down[RTT_DOWN_SIZE];
+static RTT_Stats rtt_Stats;
+
+
+/**
+  * @brief  Fills in the control block and publishes its ID.
+  * @param  None
+  * @retval None
+  * @note   Call before the first write. The ID goes in last, after a barrier, so a reader
+  *         scanning RAM never finds a half-built control block.
+  */
+
+void RTT_INIT(void)
+{
+  static const char id[] = RTT_ID;
+  RTT_Control *c = &_SEGGER_RTT;
+
+  memset(c, 0, sizeof(*c));
+  memset(&rtt_Stats, 0, sizeof(rtt_Stats));
+  c->max_up = RTT_UP_CHANNELS;
+  c->max_down = RTT_DOWN_CHANNELS;
+  c->up[RTT_TERMINAL] = (RTT_Buffer) { "Terminal", rtt_Terminal, sizeof(rtt_Terminal), 0, 0, RTT_MODE_SKIP };
+  c->up[RTT_TRACE] = (RTT_Buffer) { "Trace", rtt_Trace, sizeof(rtt_Trace), 0, 0, RTT_MODE_SKIP };
+  c->up[RTT_SAMPLES] = (RTT_Buffer) { "Samples", rtt_Samples, sizeof(rtt_Samples), 0, 0, RTT_MODE_OVERWRITE };
+  c->down[RTT_TERMINAL] = (RTT_Buffer) { "Terminal", rtt_Down, sizeof(rtt_Down), 0, 0, RTT_MODE_SKIP };
+  __DMB();
+  memcpy(c->id, id, sizeof(id));
+  __DMB();
+}
+
+
+/**
+  * @brief  Appends data to an up channel.
+  * @param  channel: Up channel (RTT_TERMINAL, RTT_TRACE, RTT_SAMPLES).
+  * @param  data: The bytes.
+  * @param  length: Number of bytes.
+  * @retval Number of bytes stored.
+  * @note   Lock-free for a single writer per channel (one task or one ISR); channels written
+  *         from several contexts go through RTT_WRITE_SHARED. Never waits: when the reader is
+  *         behind, the channel mode decides what is lost. In overwrite mode the read index
+  *         is moved by the writer too, so a reader racing it may see a torn oldest record.
+  */
+
+uint32_t RTT_WRITE(uint8_t channel, const void *data, uint32_t length)
+{
+  RTT_Buffer *b;
+  const uint8_t *src = data;
+  uint32_t size, wr, rd, space, first;
+
+  if (channel >= RTT_UP_CHANNELS)
+    return 0;
+  b = &_SEGGER_RTT.up[channel];
+  size = b->size;
+  wr = b->wr;
+  rd = b->rd;
+  if (size == 0)
+    return 0;
+
+  space = (rd > wr) ? (rd - wr - 1) : (size - 1 - (wr - rd));
+  if (length > space)
+  {
+    if (b->flags == RTT_MODE_SKIP)
+    {
+      rtt_Stats.dropped[channel] += length;
+      return 0;
+    }
+    if (b->flags == RTT_MODE_TRIM)
+    {
+      rtt_Stats.dropped[channel] += length - space;
+      length = space;
+    }
+    else
+    {
+      if (length > size - 1)
+      {
+        src += length - (size - 1);                     // Only the newest bytes fit
+        rtt_Stats.dropped[channel] += length - (size - 1);
+        length = size - 1;
+      }
+      rtt_Stats.dropped[channel] += length - space;
+      b->rd = (wr + length + 1) % size;                 // Oldest bytes given up
+    }
+  }
+
+  first = size - wr;
+  if (first > length)
+    first = length;
+  memcpy(b->buffer + wr, src, first);
+  memcpy(b->buffer, src + first, length - first);
+  __DMB();                                              // Data visible before the index
+  b->wr = (wr + length) % size;
+  rtt_Stats.written[channel] += length;
+  return length;
+}
+
+
+/**
+  * @brief  RTT_WRITE for channels with several writers.
+  * @param  channel: Up channel.
+  * @param  data: The bytes.
+  * @param  length: Number of bytes.
+  * @retval Number of bytes stored.
+  * @note   Interrupts are masked for the copy only.
+  */
+
+uint32_t RTT_WRITE_SHARED(uint8_t channel, const void *data, uint32_t length)
+{
+  uint32_t primask = __get_PRIMASK();
+  uint32_t n;
+
+  __disable_irq();
+  n = RTT_WRITE(channel, data, length);
+  __set_PRIMASK(primask);
+  return n;
+}
+
+
+/**
+  * @brief  Appends a string to an up channel (shared writers allowed).
+  * @param  channel: Up channel.
+  * @param  text: Zero-terminated string.
+  * @retval Number of bytes stored.
+  */
+
+uint32_t RTT_WRITE_STRING(uint8_t channel, const char *text)
+{
+  return RTT_WRITE_SHARED(channel, text, strlen(text));
+}
+
+
+/**
+  * @brief  Takes data the reader left in a down channel.
+  * @param  channel: Down channel (RTT_TERMINAL).
+  * @param  data: Receives the bytes.
+  * @param  length: Room in data.
+  * @retval Number of bytes taken (0 if none waiting).
+  * @note   Single reader per channel.
+  */
+
+uint32_t RTT_READ(uint8_t channel, void *data, uint32_t length)
+{
+  RTT_Buffer *b;
+  uint8_t *dst = data;
+  uint32_t rd, wr, n = 0;
+
+  if (channel >= RTT_DOWN_CHANNELS)
+    return 0;
+  b = &_SEGGER_RTT.down[channel];
+  if (b->size == 0)
+    return 0;
+
+  rd = b->rd;
+  wr = b->wr;
+  __DMB();                                              // Index read before the data
+  while ((rd != wr) && (n < length))
+  {
+    dst[n++] = (uint8_t) b->buffer[rd];
+    rd = (rd + 1 == b->size) ? 0 : rd + 1;
+  }
+  b->rd = rd;
+  return n;
+}
+
+
+/**
+  * @brief  Copies the per-channel byte counters.
+  * @param  stats: Receives the counters.
+  * @retval None
+  */
+
+void RTT_READ_STATS(RTT_Stats *stats)
+{
+  *stats = rtt_Stats;
+}
+
+
+#if RTT_STDOUT
+/**
+  * @brief  Sends stdout / stderr (printf) to the terminal channel instead of __io_putchar.
+  * @param  file: Not used.
+  * @param  ptr: The bytes.
+  * @param  len: Number of bytes.
+  * @retval len; bytes that did not fit are dropped rather than waited for.
+  */
+
+int _write(int file, char *ptr, int len)
+{
+  (void) file;
+  RTT_WRITE_SHARED(RTT_TERMINAL, ptr, (uint32_t) len);
+  return len;
+}
+#endif
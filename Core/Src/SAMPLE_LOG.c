@@ -0,0 +1,400 @@
+#include "SAMPLE_LOG.h"
+#include "CHECKSUM.h"
+#include <stddef.h>
+#include <string.h>
+
+static SAMPLE_LOG_SectorIndex sample_Log_Index[SAMPLE_LOG_SECTORS];
+static SAMPLE_LOG_Block sample_Log_Open[SAMPLE_LOG_CHANNELS][2];    // Double-buffered blocks
+static volatile uint8_t sample_Log_Ready[SAMPLE_LOG_CHANNELS][2];   // Full, waiting for SERVICE
+static uint8_t sample_Log_Fill[SAMPLE_LOG_CHANNELS];                // Buffer being filled
+static uint8_t sample_Log_Sector;                                   // Sector being written
+static uint8_t sample_Log_Spare;                                    // Next sector erased, not stamped yet
+static uint32_t sample_Log_Time_Offset;                             // Log time = tick + offset
+
+_Static_assert(sizeof(SAMPLE_LOG_Block) == SAMPLE_LOG_BLOCK_SIZE, "log block must fill its slot");
+
+
+/**
+  * @brief  Returns the address of a slot in the log area.
+  * @param  sector: The log sector (0 to SAMPLE_LOG_SECTORS - 1).
+  * @param  slot: The slot in the sector (0 is the sector header).
+  * @retval A pointer into flash.
+  */
+
+const SAMPLE_LOG_Block *SAMPLE_LOG_BLOCK_AT(uint8_t sector, uint16_t slot)
+{
+  return (const SAMPLE_LOG_Block *)(SAMPLE_LOG_BASE + sector * SAMPLE_LOG_SECTOR_SIZE + slot * SAMPLE_LOG_BLOCK_SIZE);
+}
+
+
+/**
+  * @brief  Returns the sparse per-sector index used by the query engine.
+  * @param  None
+  * @retval Pointer to SAMPLE_LOG_SECTORS index entries.
+  */
+
+const SAMPLE_LOG_SectorIndex *SAMPLE_LOG_INDEX(void)
+{
+  return sample_Log_Index;
+}
+
+
+/**
+  * @brief  Returns the current log time.
+  * @param  None
+  * @retval Milliseconds on a clock that keeps increasing across resets.
+  * @note   HAL_GetTick restarts at every reset, so SAMPLE_LOG_INIT sets the offset past the
+  *         newest logged sample. Blocks are then ordered by time in flash.
+  */
+
+uint32_t SAMPLE_LOG_NOW(void)
+{
+  return HAL_GetTick() + sample_Log_Time_Offset;
+}
+
+
+/**
+  * @brief  Converts a log time of the current boot back to a HAL tick.
+  * @param  log_time: Log time (ms), e.g. a block t_first / t_last.
+  * @retval The tick, to be turned into wall-clock time with TIME_TICK_TO_WALL_MS.
+  * @note   Only meaningful for times logged since the last reset (at or after the log time
+  *         SAMPLE_LOG_INIT started from).
+  */
+
+uint32_t SAMPLE_LOG_TICK(uint32_t log_time)
+{
+  return log_time - sample_Log_Time_Offset;
+}
+
+
+/**
+  * @brief  Checks the magic and CRC of a block.
+  * @param  block: The block in flash.
+  * @retval 1 if the block is complete and intact, 0 otherwise.
+  */
+
+int SAMPLE_LOG_BLOCK_VALID(const SAMPLE_LOG_Block *block)
+{
+  CHECKSUM_Ctx ctx;
+  SAMPLE_LOG_BlockHeader header = block->header;
+
+  if ((header.magic != SAMPLE_LOG_BLOCK_MAGIC) || (header.count > SAMPLE_LOG_BLOCK_SAMPLES))
+    return 0;
+  header.crc = 0;
+  CHECKSUM_BEGIN(&ctx);
+  CHECKSUM_UPDATE(&ctx, &header, sizeof(header));
+  CHECKSUM_UPDATE(&ctx, block->samples, sizeof(block->samples));
+  return CHECKSUM_FINISH(&ctx) == block->header.crc;
+}
+
+
+/**
+  * @brief  Checks the magic and summary CRC of a block header.
+  * @param  block: The block in flash.
+  * @retval 1 if the header time range and min/max/sum summary are intact, 0 otherwise.
+  * @note   Enough to answer from the summary: the magic is programmed last, so a block that
+  *         carries it was written completely.
+  */
+
+int SAMPLE_LOG_SUMMARY_VALID(const SAMPLE_LOG_Block *block)
+{
+  const SAMPLE_LOG_BlockHeader *h = &block->header;
+
+  if ((h->magic != SAMPLE_LOG_BLOCK_MAGIC) || (h->count > SAMPLE_LOG_BLOCK_SAMPLES))
+    return 0;
+  return CHECKSUM_BLOCK(h, offsetof(SAMPLE_LOG_BlockHeader, summary_crc)) == h->summary_crc;
+}
+
+
+/**
+  * @brief  Checks that a range of flash is fully erased.
+  * @param  addr: Start of the range (word aligned).
+  * @param  size: Length of the range in bytes.
+  * @retval 1 if every word reads SAMPLE_LOG_ERASED, 0 otherwise.
+  */
+
+static int SAMPLE_LOG_BLANK(uint32_t addr, uint32_t size)
+{
+  const uint32_t *words = (const uint32_t *) addr;
+
+  for (uint32_t i = 0; i < size / 4; i++)
+    if (words[i] != SAMPLE_LOG_ERASED)
+      return 0;
+  return 1;
+}
+
+
+/**
+  * @brief  Rebuilds the index entry of one sector from flash.
+  * @param  sector: The log sector.
+  * @retval None
+  * @note   Blocks are programmed in order, so the first blank slot is found by binary search.
+  *         A slot only counts as blank if the whole block is erased: a block is programmed
+  *         back to front, so a write torn at power loss leaves its first word erased and must
+  *         not be programmed over. Such slots are kept as used; queries skip them on the CRC.
+  */
+
+static void SAMPLE_LOG_SCAN_SECTOR(uint8_t sector)
+{
+  const SAMPLE_LOG_SectorHeader *sh = (const SAMPLE_LOG_SectorHeader *) SAMPLE_LOG_BLOCK_AT(sector, 0);
+  SAMPLE_LOG_SectorIndex *index = &sample_Log_Index[sector];
+  uint16_t lo = 1, hi = SAMPLE_LOG_BLOCKS_PER_SECTOR;
+
+  memset(index, 0, sizeof(*index));
+  if ((sh->magic != SAMPLE_LOG_SECTOR_MAGIC) || (sh->sequence == SAMPLE_LOG_ERASED))
+    return;
+  index->sequence = sh->sequence;
+
+  while (lo < hi)
+  {
+    uint16_t mid = (lo + hi) / 2;
+    if (SAMPLE_LOG_BLANK((uint32_t) SAMPLE_LOG_BLOCK_AT(sector, mid), SAMPLE_LOG_BLOCK_SIZE))
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  index->blocks = lo - 1;
+
+  // Time bounds from the first and last intact blocks
+  for (lo = 1; (lo <= index->blocks) && !SAMPLE_LOG_BLOCK_VALID(SAMPLE_LOG_BLOCK_AT(sector, lo)); lo++);
+  for (hi = index->blocks; (hi > lo) && !SAMPLE_LOG_BLOCK_VALID(SAMPLE_LOG_BLOCK_AT(sector, hi)); hi--);
+  if (lo <= index->blocks)
+  {
+    index->t_last_first = SAMPLE_LOG_BLOCK_AT(sector, lo)->header.t_last;
+    index->t_last_last = SAMPLE_LOG_BLOCK_AT(sector, hi)->header.t_last;
+  }
+}
+
+
+/**
+  * @brief  Erases a log sector, dropping its data from the index.
+  * @param  sector: The log sector.
+  * @retval None
+  * @note   Stalls the CPU for up to 2 s (see SAMPLE_LOG.h); only SAMPLE_LOG_SERVICE calls it,
+  *         once per sector.
+  */
+
+static void SAMPLE_LOG_ERASE(uint8_t sector)
+{
+  FLASH_EraseInitTypeDef erase = {0};
+  uint32_t error;
+
+  erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+  erase.Sector = SAMPLE_LOG_FIRST_SECTOR + sector;
+  erase.NbSectors = 1;
+  erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+  memset(&sample_Log_Index[sector], 0, sizeof(sample_Log_Index[sector]));
+  HAL_FLASH_Unlock();
+  HAL_FLASHEx_Erase(&erase, &error);
+  HAL_FLASH_Lock();
+}
+
+
+/**
+  * @brief  Stamps an erased sector with a new sequence number, making it the one written.
+  * @param  sector: The log sector.
+  * @param  sequence: The sequence number to write.
+  * @retval None
+  */
+
+static void SAMPLE_LOG_STAMP(uint8_t sector, uint32_t sequence)
+{
+  uint32_t addr = (uint32_t) SAMPLE_LOG_BLOCK_AT(sector, 0);
+
+  HAL_FLASH_Unlock();
+  HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr + 4, sequence);
+  HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, SAMPLE_LOG_SECTOR_MAGIC);
+  HAL_FLASH_Lock();
+
+  memset(&sample_Log_Index[sector], 0, sizeof(sample_Log_Index[sector]));
+  sample_Log_Index[sector].sequence = sequence;
+  sample_Log_Sector = sector;
+}
+
+
+/**
+  * @brief  Scans the log area, rebuilds the sector index and resumes the log clock.
+  * @param  None
+  * @retval None
+  * @note   Must run after CHECKSUM_INIT. A blank log area gets its first sector stamped.
+  *         The sector after the one being written is checked word by word, so an erase cut
+  *         short by a reset is redone rather than taken as a spare.
+  */
+
+void SAMPLE_LOG_INIT(void)
+{
+  uint32_t newest = 0;
+  uint8_t found = 0;
+
+  for (uint8_t s = 0; s < SAMPLE_LOG_SECTORS; s++)
+  {
+    SAMPLE_LOG_SCAN_SECTOR(s);
+    if (sample_Log_Index[s].sequence && (!found || (sample_Log_Index[s].sequence > sample_Log_Index[sample_Log_Sector].sequence)))
+    {
+      sample_Log_Sector = s;
+      found = 1;
+    }
+  }
+
+  if (!found)
+  {
+    if (!SAMPLE_LOG_BLANK(SAMPLE_LOG_BASE, SAMPLE_LOG_SECTOR_SIZE))
+      SAMPLE_LOG_ERASE(0);
+    SAMPLE_LOG_STAMP(0, 1);
+  }
+  sample_Log_Spare = SAMPLE_LOG_BLANK((uint32_t) SAMPLE_LOG_BLOCK_AT((sample_Log_Sector + 1) % SAMPLE_LOG_SECTORS, 0),
+                                      SAMPLE_LOG_SECTOR_SIZE);
+
+  for (uint8_t s = 0; s < SAMPLE_LOG_SECTORS; s++)
+    if (sample_Log_Index[s].blocks && (sample_Log_Index[s].t_last_last > newest))
+      newest = sample_Log_Index[s].t_last_last;
+  sample_Log_Time_Offset = newest + 1 - HAL_GetTick();
+
+  memset(sample_Log_Open, 0, sizeof(sample_Log_Open));
+  memset((void *) sample_Log_Ready, 0, sizeof(sample_Log_Ready));
+}
+
+
+/**
+  * @brief  Adds one sample to the open block of a channel.
+  * @param  channel: The channel index (0 to SAMPLE_LOG_CHANNELS - 1).
+  * @param  value: The sample value.
+  * @retval None
+  * @note   Only RAM is touched here, so the acquisition tasks never wait for flash. A block
+  *         is handed to SAMPLE_LOG_SERVICE when it is full or when its time span would
+  *         overflow the 16-bit sample offsets, and filling continues in the second buffer.
+  *         Samples are dropped only if SERVICE is two blocks behind.
+  *         t_last is the end of the time covered by the block, which is also the moment it
+  *         becomes ready. That keeps blocks ordered by t_last in flash, which the query
+  *         engine relies on.
+  */
+
+void SAMPLE_LOG_APPEND(uint8_t channel, uint16_t value)
+{
+  SAMPLE_LOG_Block *block;
+  SAMPLE_LOG_BlockHeader *h;
+  uint32_t now = SAMPLE_LOG_NOW();
+  uint8_t b;
+
+  if (channel >= SAMPLE_LOG_CHANNELS)
+    return;
+
+  b = sample_Log_Fill[channel];
+  h = &sample_Log_Open[channel][b].header;
+  if (!sample_Log_Ready[channel][b] && h->count && ((now - h->t_first) > SAMPLE_LOG_MAX_BLOCK_SPAN))
+  {
+    h->t_last = now - 1;                                // Block covers everything up to this sample
+    sample_Log_Ready[channel][b] = 1;
+    b ^= 1;
+    sample_Log_Fill[channel] = b;
+  }
+  if (sample_Log_Ready[channel][b])
+    return;
+
+  block = &sample_Log_Open[channel][b];
+  h = &block->header;
+  if (!h->count)
+  {
+    memset(block, 0, sizeof(*block));
+    h->channel = channel;
+    h->t_first = now;
+    h->min = 0xFFFF;
+  }
+  block->samples[h->count].value = value;
+  block->samples[h->count].dt = now - h->t_first;
+  h->count++;
+  h->t_last = now;
+  if (value < h->min) h->min = value;
+  if (value > h->max) h->max = value;
+  h->sum += value;
+
+  if (h->count == SAMPLE_LOG_BLOCK_SAMPLES)
+  {
+    sample_Log_Ready[channel][b] = 1;
+    sample_Log_Fill[channel] = b ^ 1;
+  }
+}
+
+
+/**
+  * @brief  Programs one completed block into the next free slot.
+  * @param  block: The block to program.
+  * @retval None
+  * @note   The header is programmed last and its magic word very last, so a torn write never
+  *         looks like a valid block.
+  */
+
+static void SAMPLE_LOG_WRITE(SAMPLE_LOG_Block *block)
+{
+  SAMPLE_LOG_SectorIndex *index = &sample_Log_Index[sample_Log_Sector];
+  const uint32_t *words = (const uint32_t *) block;
+  uint32_t addr;
+
+  if (index->blocks >= SAMPLE_LOG_BLOCKS_PER_SECTOR - 1)
+  {
+    uint8_t next = (sample_Log_Sector + 1) % SAMPLE_LOG_SECTORS;
+    if (!sample_Log_Spare)
+      SAMPLE_LOG_ERASE(next);                           // Not erased ahead (reset since)
+    SAMPLE_LOG_STAMP(next, index->sequence + 1);
+    sample_Log_Spare = 0;
+    index = &sample_Log_Index[sample_Log_Sector];
+  }
+
+  block->header.magic = SAMPLE_LOG_BLOCK_MAGIC;
+  block->header.summary_crc = CHECKSUM_BLOCK(&block->header, offsetof(SAMPLE_LOG_BlockHeader, summary_crc));
+  block->header.crc = 0;
+  block->header.crc = CHECKSUM_BLOCK(block, sizeof(*block));
+  addr = (uint32_t) SAMPLE_LOG_BLOCK_AT(sample_Log_Sector, index->blocks + 1);
+
+  HAL_FLASH_Unlock();
+  for (int i = SAMPLE_LOG_BLOCK_SIZE / 4 - 1; i >= 0; i--)
+    HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr + 4 * i, words[i]);
+  HAL_FLASH_Lock();
+
+  if (!index->blocks)
+    index->t_last_first = block->header.t_last;
+  index->t_last_last = block->header.t_last;
+  index->blocks++;
+}
+
+
+/**
+  * @brief  Programs the blocks completed by SAMPLE_LOG_APPEND into flash.
+  * @param  None
+  * @retval None
+  * @note   Called periodically from a low-priority task. Ready blocks of all channels are
+  *         written oldest t_last first, so flash stays ordered by t_last. Once the sector
+  *         being written is SAMPLE_LOG_ERASE_AHEAD_BLOCKS full, the next one is erased here
+  *         (its oldest data is dropped half a sector early).
+  */
+
+void SAMPLE_LOG_SERVICE(void)
+{
+  for (;;)
+  {
+    SAMPLE_LOG_Block *oldest = NULL;
+    volatile uint8_t *ready = NULL;
+
+    for (uint8_t ch = 0; ch < SAMPLE_LOG_CHANNELS; ch++)
+      for (uint8_t b = 0; b < 2; b++)
+        if (sample_Log_Ready[ch][b] && (!oldest || (sample_Log_Open[ch][b].header.t_last < oldest->header.t_last)))
+        {
+          oldest = &sample_Log_Open[ch][b];
+          ready = &sample_Log_Ready[ch][b];
+        }
+
+    if (!oldest)
+      break;
+    SAMPLE_LOG_WRITE(oldest);
+    oldest->header.count = 0;
+    __DMB();
+    *ready = 0;
+  }
+
+  if (!sample_Log_Spare && (sample_Log_Index[sample_Log_Sector].blocks >= SAMPLE_LOG_ERASE_AHEAD_BLOCKS))
+  {
+    SAMPLE_LOG_ERASE((sample_Log_Sector + 1) % SAMPLE_LOG_SECTORS);
+    sample_Log_Spare = 1;
+  }
+}
@@ -0,0 +1,177 @@
+#include "SAMPLE_LOG.h"
+#include "DWT_DELAY.h"
+#include <string.h>
+
+
+/**
+  * @brief  Maps a log time onto one of the output points.
+  * @param  t: The sample time (t1 <= t <= t2).
+  * @param  t1: Start of the query range.
+  * @param  span: Length of the query range in ms.
+  * @param  count: Number of output points.
+  * @retval The point index.
+  */
+
+static inline uint32_t SAMPLE_QUERY_POINT(uint32_t t, uint32_t t1, uint64_t span, uint16_t count)
+{
+  return (uint32_t)(((uint64_t)(t - t1) * count) / span);
+}
+
+
+/**
+  * @brief  Adds one value (or a pre-aggregated block) to an output point.
+  * @param  point: The output point.
+  * @param  min: Minimum of the values to add.
+  * @param  max: Maximum of the values to add.
+  * @param  sum: Sum of the values to add.
+  * @param  n: Number of values.
+  * @retval None
+  */
+
+static inline void SAMPLE_QUERY_MERGE(SAMPLE_LOG_Point *point, uint16_t min, uint16_t max, uint32_t sum, uint32_t n)
+{
+  if (min < point->min) point->min = min;
+  if (max > point->max) point->max = max;
+  point->sum += sum;
+  point->count += n;
+}
+
+
+/**
+  * @brief  Finds the first block of a sector whose t_last is not before t1.
+  * @param  sector: The log sector.
+  * @param  blocks: Number of programmed blocks in the sector.
+  * @param  t1: The time to search for.
+  * @retval Slot number (blocks + 1 if every block ends before t1).
+  */
+
+static uint16_t SAMPLE_QUERY_SEARCH(uint8_t sector, uint16_t blocks, uint32_t t1)
+{
+  uint16_t lo = 1, hi = blocks + 1;
+
+  while (lo < hi)
+  {
+    uint16_t mid = (lo + hi) / 2;
+    if (SAMPLE_LOG_BLOCK_AT(sector, mid)->header.t_last < t1)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+
+/**
+  * @brief  Returns a channel's samples between t1 and t2, decimated to a fixed number of points.
+  * @param  channel: The channel index.
+  * @param  t1: Start of the range (log time, ms, inclusive).
+  * @param  t2: End of the range (log time, ms, inclusive).
+  * @param  points: Receives count points of min/max/mean, evenly spaced over [t1, t2].
+  * @param  count: Number of output points (e.g. 100 for a plot).
+  * @param  stats: Optional, receives the work done and the elapsed DWT cycles (may be NULL).
+  * @retval Number of samples found in the range, or -1 on bad arguments.
+  * @note   Blocks are ordered by t_last and never span more than SAMPLE_LOG_MAX_BLOCK_SPAN, so:
+  *         - whole sectors outside the range are skipped from the RAM index,
+  *         - the first useful block of a sector is found by binary search,
+  *         - the scan stops once a block must start after t2,
+  *         - a block lying inside the range and inside one output point is answered from its
+  *           header summary without touching its samples (only the 20-byte header is
+  *           CRC-checked).
+  *         Other blocks are CRC-checked whole, then decoded in place, one at a time; no
+  *         sample is copied to RAM. A block torn at power loss (or damaged later) is left
+  *         out wherever it sits in the log.
+  *         Points with no samples are returned with count 0.
+  */
+
+int SAMPLE_LOG_QUERY(uint8_t channel, uint32_t t1, uint32_t t2, SAMPLE_LOG_Point *points,
+                     uint16_t count, SAMPLE_LOG_QueryStats *stats)
+{
+  const SAMPLE_LOG_SectorIndex *index = SAMPLE_LOG_INDEX();
+  SAMPLE_LOG_QueryStats local;
+  uint8_t order[SAMPLE_LOG_SECTORS];
+  uint64_t span;
+  uint32_t found = 0;
+
+  if (!points || !count || (t2 < t1))
+    return -1;
+  if (!stats)
+    stats = &local;
+  memset(stats, 0, sizeof(*stats));
+  stats->cycles = DWT_GET_CYCLES();
+
+  span = (uint64_t) t2 - t1 + 1;
+  for (uint16_t i = 0; i < count; i++)
+  {
+    memset(&points[i], 0, sizeof(points[i]));
+    points[i].min = 0xFFFF;
+  }
+
+  // Visit sectors oldest first (insertion sort on the sequence number)
+  for (uint8_t i = 0; i < SAMPLE_LOG_SECTORS; i++)
+  {
+    uint8_t j = i;
+    while (j && (index[order[j - 1]].sequence > index[i].sequence))
+    {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  for (uint8_t k = 0; k < SAMPLE_LOG_SECTORS; k++)
+  {
+    uint8_t s = order[k];
+    uint16_t blocks = index[s].blocks;
+
+    if (!index[s].sequence || !blocks || (index[s].t_last_last < t1) ||
+        ((index[s].t_last_first > SAMPLE_LOG_MAX_BLOCK_SPAN) && (index[s].t_last_first - SAMPLE_LOG_MAX_BLOCK_SPAN > t2)))
+      continue;
+    stats->sectors_scanned++;
+
+    for (uint16_t slot = SAMPLE_QUERY_SEARCH(s, blocks, t1); slot <= blocks; slot++)
+    {
+      const SAMPLE_LOG_Block *block = SAMPLE_LOG_BLOCK_AT(s, slot);
+      const SAMPLE_LOG_BlockHeader *h = &block->header;
+
+      if (h->magic != SAMPLE_LOG_BLOCK_MAGIC)
+        continue;                                       // Torn write: header times are not set
+      if ((h->t_last > SAMPLE_LOG_MAX_BLOCK_SPAN) && (h->t_last - SAMPLE_LOG_MAX_BLOCK_SPAN > t2))
+        break;
+      stats->blocks_scanned++;
+
+      if ((h->channel != channel) || (h->t_first > t2) || (h->t_last < t1))
+        continue;
+
+      if ((h->t_first >= t1) && (h->t_last <= t2) &&
+          (SAMPLE_QUERY_POINT(h->t_first, t1, span, count) == SAMPLE_QUERY_POINT(h->t_last, t1, span, count)))
+      {
+        if (!SAMPLE_LOG_SUMMARY_VALID(block))
+          continue;                                     // Corrupt header, anywhere in the log
+        SAMPLE_QUERY_MERGE(&points[SAMPLE_QUERY_POINT(h->t_first, t1, span, count)], h->min, h->max, h->sum, h->count);
+        found += h->count;
+        stats->blocks_summarized++;
+        continue;
+      }
+
+      if (!SAMPLE_LOG_BLOCK_VALID(block))
+        continue;                                       // Corrupt block, anywhere in the log
+      for (uint8_t i = 0; i < h->count; i++)
+      {
+        uint32_t t = h->t_first + block->samples[i].dt;
+        uint16_t v = block->samples[i].value;
+        if ((t < t1) || (t > t2))
+          continue;
+        SAMPLE_QUERY_MERGE(&points[SAMPLE_QUERY_POINT(t, t1, span, count)], v, v, v, 1);
+        found++;
+      }
+      stats->blocks_decoded++;
+    }
+  }
+
+  for (uint16_t i = 0; i < count; i++)
+    if (points[i].count)
+      points[i].mean = points[i].sum / points[i].count;
+
+  stats->cycles = DWT_GET_CYCLES() - stats->cycles;
+  return found;
+}
@@ -0,0 +1,154 @@
+#include "SENSOR.h"
+#include "CHANNEL.h"
+#include "DWT_DELAY.h"
+#include <string.h>
+
+typedef struct
+{
+  I2C_BUS_Request request;
+  uint16_t pin;
+  uint8_t channel;
+  uint32_t reads;
+  uint32_t errors;
+  uint32_t latency_min;
+  uint32_t latency_max;
+  uint64_t latency_sum;
+} SENSOR_Sensor;
+
+static SENSOR_Sensor sensor_List[SENSOR_MAX];
+static uint8_t sensor_Count;
+
+
+/**
+  * @brief  Stores a completed read in the sensor's channel (bus task context).
+  * @param  ctx: The sensor.
+  * @param  status: I2C_BUS_OK if the read succeeded.
+  * @param  data: Result registers, big-endian 16-bit value first.
+  * @param  length: Number of bytes read.
+  * @retval None
+  * @note   If data-ready is still asserted (a new conversion finished during the read, or
+  *         the edge was masked while queued) the read is queued again straight away.
+  */
+
+static void SENSOR_DONE(void *ctx, int status, const uint8_t *data, uint8_t length)
+{
+  SENSOR_Sensor *sensor = (SENSOR_Sensor *) ctx;
+  uint32_t latency;
+
+  if ((status != I2C_BUS_OK) || (length < 2))
+  {
+    sensor->errors++;
+    return;
+  }
+
+  CHANNEL_SET(sensor->channel, (uint16_t) ((data[0] << 8) | data[1]), HAL_GetTick());
+
+  latency = DWT_GET_CYCLES() - sensor->request.stamp;
+  if (latency < sensor->latency_min)
+    sensor->latency_min = latency;
+  if (latency > sensor->latency_max)
+    sensor->latency_max = latency;
+  sensor->latency_sum += latency;
+  sensor->reads++;
+
+  if (!(SENSOR_DRDY_PORT->IDR & sensor->pin))
+    I2C_BUS_SUBMIT(&sensor->request);
+}
+
+
+/**
+  * @brief  Configures the data-ready lines.
+  * @param  None
+  * @retval None
+  * @note   Call after I2C_BUS_INIT. The lines are pulled up and interrupt on the falling edge.
+  */
+
+void SENSOR_INIT(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  DWT_DELAY_INIT();
+  __HAL_RCC_GPIOE_CLK_ENABLE();
+
+  GPIO_InitStruct.Pin = SENSOR_DRDY_PINS;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+  GPIO_InitStruct.Pull = GPIO_PULLUP;
+  HAL_GPIO_Init(SENSOR_DRDY_PORT, &GPIO_InitStruct);
+
+  HAL_NVIC_SetPriority(EXTI0_IRQn, SENSOR_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+  HAL_NVIC_SetPriority(EXTI1_IRQn, SENSOR_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+}
+
+
+/**
+  * @brief  Adds a sensor read on data-ready.
+  * @param  address: 8-bit slave address.
+  * @param  reg: Result register (two bytes, big-endian, are read from it).
+  * @param  drdy_pin: Its data-ready line, GPIO_PIN_0 or GPIO_PIN_1 of SENSOR_DRDY_PORT.
+  * @param  channel: Registry channel receiving the values.
+  * @retval The sensor index, or -1 if the list is full or the pin is not a data-ready line.
+  */
+
+int SENSOR_REGISTER(uint8_t address, uint8_t reg, uint16_t drdy_pin, uint8_t channel)
+{
+  SENSOR_Sensor *sensor;
+
+  if ((sensor_Count >= SENSOR_MAX) || !(drdy_pin & SENSOR_DRDY_PINS) || (drdy_pin & (drdy_pin - 1)))
+    return -1;
+
+  sensor = &sensor_List[sensor_Count];
+  memset(sensor, 0, sizeof(*sensor));
+  sensor->request.address = address;
+  sensor->request.reg = reg;
+  sensor->request.length = 2;
+  sensor->request.done = SENSOR_DONE;
+  sensor->request.ctx = sensor;
+  sensor->pin = drdy_pin;
+  sensor->channel = channel;
+  sensor->latency_min = UINT32_MAX;
+  return sensor_Count++;
+}
+
+
+/**
+  * @brief  Queues the read of every sensor whose data-ready line fired.
+  * @param  pin: The EXTI line that fired.
+  * @retval None
+  * @note   Called from HAL_GPIO_EXTI_Callback.
+  */
+
+void SENSOR_EXTI_CALLBACK(uint16_t pin)
+{
+  for (uint8_t i = 0; i < sensor_Count; i++)
+  {
+    if (sensor_List[i].pin == pin)
+      I2C_BUS_SUBMIT_FROM_ISR(&sensor_List[i].request);
+  }
+}
+
+
+/**
+  * @brief  Reads the counters and latency of a sensor.
+  * @param  sensor: Index returned by SENSOR_REGISTER.
+  * @param  stats: Receives the statistics.
+  * @retval 0 on success, -1 for an unknown sensor.
+  */
+
+int SENSOR_READ_STATS(int sensor, SENSOR_Stats *stats)
+{
+  SENSOR_Sensor *s;
+
+  if ((sensor < 0) || (sensor >= sensor_Count))
+    return -1;
+
+  s = &sensor_List[sensor];
+  stats->reads = s->reads;
+  stats->errors = s->errors;
+  stats->coalesced = s->request.coalesced;
+  stats->latency_min = s->reads ? s->latency_min : 0;
+  stats->latency_max = s->latency_max;
+  stats->latency_avg = s->reads ? (uint32_t) (s->latency_sum / s->reads) : 0;
+  return 0;
+}
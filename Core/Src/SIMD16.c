@@ -0,0 +1,366 @@
+#include "SIMD16.h"
+#include "DWT_DELAY.h"
+#include <string.h>
+
+
+/**
+  * @brief  Saturates to the int16 range.
+  * @param  v: The value.
+  * @retval The saturated value.
+  */
+
+static inline int16_t SIMD16_SAT(int32_t v)
+{
+  return (v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : v;
+}
+
+
+/* Portable kernels, also the reference for SIMD16_BENCH ---------------------*/
+
+static void SIMD16_OFFSET_C(int16_t *dst, const int16_t *src, int16_t offset, uint16_t count)
+{
+  for (uint16_t i = 0; i < count; i++)
+    dst[i] = SIMD16_SAT((int32_t) src[i] - offset);
+}
+
+static void SIMD16_SCALE_C(int16_t *dst, const int16_t *src, int16_t gain, uint8_t shift, uint16_t count)
+{
+  int32_t bias = shift ? (1 << (shift - 1)) : 0;
+
+  for (uint16_t i = 0; i < count; i++)
+    dst[i] = SIMD16_SAT(((int32_t) src[i] * gain + bias) >> shift);
+}
+
+static void SIMD16_CALIBRATE_C(int16_t *dst, const int16_t *src, const int16_t *offset, const int16_t *gain, uint16_t count)
+{
+  for (uint16_t i = 0; i < count; i++)
+    dst[i] = SIMD16_SAT(((int32_t) SIMD16_SAT((int32_t) src[i] - offset[i]) * gain[i]) >> SIMD16_CAL_SHIFT);
+}
+
+static void SIMD16_CLAMP_C(int16_t *dst, const int16_t *src, int16_t lo, int16_t hi, uint16_t count)
+{
+  for (uint16_t i = 0; i < count; i++)
+    dst[i] = (src[i] < lo) ? lo : (src[i] > hi) ? hi : src[i];
+}
+
+static int64_t SIMD16_DOT_C(const int16_t *a, const int16_t *b, uint16_t count)
+{
+  int64_t acc = 0;
+
+  for (uint16_t i = 0; i < count; i++)
+    acc += (int32_t) a[i] * b[i];
+  return acc;
+}
+
+static void SIMD16_MINMAX_C(const int16_t *src, uint16_t count, int16_t *min, int16_t *max)
+{
+  int16_t mn = count ? src[0] : 0, mx = mn;
+
+  for (uint16_t i = 1; i < count; i++)
+  {
+    if (src[i] < mn) mn = src[i];
+    if (src[i] > mx) mx = src[i];
+  }
+  *min = mn;
+  *max = mx;
+}
+
+
+#if SIMD16_PACKED
+/* Packed kernels ------------------------------------------------------------*/
+
+// Halfword pairs are moved with memcpy so unaligned arrays are fine (a single LDR/STR on the M4)
+static inline uint32_t SIMD16_LOAD(const int16_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void SIMD16_STORE(int16_t *p, uint32_t v)
+{
+  memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t SIMD16_DUP(int16_t v)
+{
+  return (uint16_t) v * 0x00010001U;
+}
+
+static void SIMD16_OFFSET_P(int16_t *dst, const int16_t *src, int16_t offset, uint16_t count)
+{
+  uint32_t off2 = SIMD16_DUP(offset);
+  uint16_t i = 0;
+
+  for (; i + 1 < count; i += 2)
+    SIMD16_STORE(dst + i, __QSUB16(SIMD16_LOAD(src + i), off2));
+  SIMD16_OFFSET_C(dst + i, src + i, offset, count - i);
+}
+
+static void SIMD16_SCALE_P(int16_t *dst, const int16_t *src, int16_t gain, uint8_t shift, uint16_t count)
+{
+  uint32_t g2 = SIMD16_DUP(gain);
+  int32_t bias = shift ? (1 << (shift - 1)) : 0;
+  uint16_t i = 0;
+
+  for (; i + 1 < count; i += 2)
+  {
+    uint32_t x = SIMD16_LOAD(src + i);
+    int32_t lo = __SSAT((__SMULBB(x, g2) + bias) >> shift, 16);
+    int32_t hi = __SSAT((__SMULTT(x, g2) + bias) >> shift, 16);
+    SIMD16_STORE(dst + i, __PKHBT(lo, hi, 16));
+  }
+  SIMD16_SCALE_C(dst + i, src + i, gain, shift, count - i);
+}
+
+static void SIMD16_CALIBRATE_P(int16_t *dst, const int16_t *src, const int16_t *offset, const int16_t *gain, uint16_t count)
+{
+  uint16_t i = 0;
+
+  for (; i + 1 < count; i += 2)
+  {
+    uint32_t d = __QSUB16(SIMD16_LOAD(src + i), SIMD16_LOAD(offset + i));
+    uint32_t g = SIMD16_LOAD(gain + i);
+    int32_t lo = __SSAT(__SMULBB(d, g) >> SIMD16_CAL_SHIFT, 16);
+    int32_t hi = __SSAT(__SMULTT(d, g) >> SIMD16_CAL_SHIFT, 16);
+    SIMD16_STORE(dst + i, __PKHBT(lo, hi, 16));
+  }
+  SIMD16_CALIBRATE_C(dst + i, src + i, offset + i, gain + i, count - i);
+}
+
+static void SIMD16_CLAMP_P(int16_t *dst, const int16_t *src, int16_t lo, int16_t hi, uint16_t count)
+{
+  uint32_t lo2 = SIMD16_DUP(lo), hi2 = SIMD16_DUP(hi);
+  uint16_t i = 0;
+
+  for (; i + 1 < count; i += 2)
+  {
+    uint32_t x = SIMD16_LOAD(src + i);
+    __SSUB16(x, lo2);                                   // GE set per lane where x >= lo
+    x = __SEL(x, lo2);
+    __SSUB16(x, hi2);                                   // GE set per lane where x >= hi
+    x = __SEL(hi2, x);
+    SIMD16_STORE(dst + i, x);
+  }
+  SIMD16_CLAMP_C(dst + i, src + i, lo, hi, count - i);
+}
+
+static int64_t SIMD16_DOT_P(const int16_t *a, const int16_t *b, uint16_t count)
+{
+  int64_t acc = 0;
+  uint16_t i = 0;
+
+  for (; i + 1 < count; i += 2)
+    acc = __SMLALD(SIMD16_LOAD(a + i), SIMD16_LOAD(b + i), acc);
+  return acc + SIMD16_DOT_C(a + i, b + i, count - i);
+}
+
+static void SIMD16_MINMAX_P(const int16_t *src, uint16_t count, int16_t *min, int16_t *max)
+{
+  uint32_t mn, mx;
+  int16_t tmin, tmax;
+  uint16_t i = 2;
+
+  if (count < 2)
+  {
+    SIMD16_MINMAX_C(src, count, min, max);
+    return;
+  }
+
+  mn = mx = SIMD16_LOAD(src);
+  for (; i + 1 < count; i += 2)
+  {
+    uint32_t x = SIMD16_LOAD(src + i);
+    __SSUB16(x, mn);                                    // GE set per lane where x >= min
+    mn = __SEL(mn, x);
+    __SSUB16(x, mx);                                    // GE set per lane where x >= max
+    mx = __SEL(x, mx);
+  }
+
+  *min = ((int16_t) mn < (int16_t)(mn >> 16)) ? (int16_t) mn : (int16_t)(mn >> 16);
+  *max = ((int16_t) mx > (int16_t)(mx >> 16)) ? (int16_t) mx : (int16_t)(mx >> 16);
+  if (i < count)
+  {
+    SIMD16_MINMAX_C(src + i, 1, &tmin, &tmax);
+    if (tmin < *min) *min = tmin;
+    if (tmax > *max) *max = tmax;
+  }
+}
+#endif /* SIMD16_PACKED */
+
+
+/**
+  * @brief  dst[i] = sat(src[i] - offset).
+  * @param  dst: Output samples (may be src).
+  * @param  src: Input samples.
+  * @param  offset: Offset removed from every sample.
+  * @param  count: Number of samples.
+  * @retval None
+  */
+
+void SIMD16_OFFSET(int16_t *dst, const int16_t *src, int16_t offset, uint16_t count)
+{
+#if SIMD16_PACKED
+  SIMD16_OFFSET_P(dst, src, offset, count);
+#else
+  SIMD16_OFFSET_C(dst, src, offset, count);
+#endif
+}
+
+
+/**
+  * @brief  dst[i] = sat(round(src[i] * gain / 2^shift)).
+  * @param  dst: Output samples (may be src).
+  * @param  src: Input samples.
+  * @param  gain: Signed gain.
+  * @param  shift: Fractional bits of gain (0..16).
+  * @param  count: Number of samples.
+  * @retval None
+  * @note   The packed version moves two samples per load and store, but still multiplies
+  *         one sample at a time (SMULBB, SMULTT) so the rounding matches the C loop bit for
+  *         bit; SMULWB/SMULWT would truncate. Its gain over the C loop is smaller than that
+  *         of the add and compare kernels.
+  */
+
+void SIMD16_SCALE(int16_t *dst, const int16_t *src, int16_t gain, uint8_t shift, uint16_t count)
+{
+#if SIMD16_PACKED
+  SIMD16_SCALE_P(dst, src, gain, shift, count);
+#else
+  SIMD16_SCALE_C(dst, src, gain, shift, count);
+#endif
+}
+
+
+/**
+  * @brief  Per-sample calibration, dst[i] = sat(sat(src[i] - offset[i]) * gain[i] / 2^12).
+  * @param  dst: Output samples (may be src).
+  * @param  src: Input samples.
+  * @param  offset: Per-sample offsets.
+  * @param  gain: Per-sample Q12 gains.
+  * @param  count: Number of samples.
+  * @retval None
+  */
+
+void SIMD16_CALIBRATE(int16_t *dst, const int16_t *src, const int16_t *offset, const int16_t *gain, uint16_t count)
+{
+#if SIMD16_PACKED
+  SIMD16_CALIBRATE_P(dst, src, offset, gain, count);
+#else
+  SIMD16_CALIBRATE_C(dst, src, offset, gain, count);
+#endif
+}
+
+
+/**
+  * @brief  Limits every sample to [lo, hi].
+  * @param  dst: Output samples (may be src).
+  * @param  src: Input samples.
+  * @param  lo: Lower limit.
+  * @param  hi: Upper limit (lo <= hi).
+  * @param  count: Number of samples.
+  * @retval None
+  */
+
+void SIMD16_CLAMP(int16_t *dst, const int16_t *src, int16_t lo, int16_t hi, uint16_t count)
+{
+#if SIMD16_PACKED
+  SIMD16_CLAMP_P(dst, src, lo, hi, count);
+#else
+  SIMD16_CLAMP_C(dst, src, lo, hi, count);
+#endif
+}
+
+
+/**
+  * @brief  Dot product with a 64-bit accumulator.
+  * @param  a: First vector.
+  * @param  b: Second vector.
+  * @param  count: Number of samples.
+  * @retval Sum of a[i] * b[i].
+  */
+
+int64_t SIMD16_DOT(const int16_t *a, const int16_t *b, uint16_t count)
+{
+#if SIMD16_PACKED
+  return SIMD16_DOT_P(a, b, count);
+#else
+  return SIMD16_DOT_C(a, b, count);
+#endif
+}
+
+
+/**
+  * @brief  Finds the smallest and largest sample.
+  * @param  src: Input samples.
+  * @param  count: Number of samples.
+  * @param  min: Receives the minimum (0 if count is 0).
+  * @param  max: Receives the maximum (0 if count is 0).
+  * @retval None
+  */
+
+void SIMD16_MINMAX(const int16_t *src, uint16_t count, int16_t *min, int16_t *max)
+{
+#if SIMD16_PACKED
+  SIMD16_MINMAX_P(src, count, min, max);
+#else
+  SIMD16_MINMAX_C(src, count, min, max);
+#endif
+}
+
+
+/**
+  * @brief  Times the packed kernels against the C loops on one block.
+  * @param  count: Block length (up to 64 samples, e.g. CHANNEL_MAX).
+  * @param  bench: Receives DWT cycles, { packed, C } per kernel (packed is 0 without DSP).
+  * @retval None
+  */
+
+void SIMD16_BENCH(uint16_t count, SIMD16_Bench *bench)
+{
+  int16_t src[64], dst[64], offset[64], gain[64];
+  volatile int64_t dot;
+  int16_t min, max;
+  uint32_t start;
+
+  DWT_DELAY_INIT();
+  memset(bench, 0, sizeof(*bench));
+  if (count > 64)
+    count = 64;
+  for (uint16_t i = 0; i < count; i++)
+  {
+    src[i] = (i * 67) & 0x3FF;
+    offset[i] = i;
+    gain[i] = 4096 - i * 8;
+  }
+
+#if SIMD16_PACKED
+  start = DWT_GET_CYCLES();
+  SIMD16_CALIBRATE_P(dst, src, offset, gain, count);
+  bench->calibrate[0] = DWT_GET_CYCLES() - start;
+  start = DWT_GET_CYCLES();
+  SIMD16_SCALE_P(dst, src, 6406, 16, count);
+  bench->scale[0] = DWT_GET_CYCLES() - start;
+  start = DWT_GET_CYCLES();
+  dot = SIMD16_DOT_P(src, gain, count);
+  bench->dot[0] = DWT_GET_CYCLES() - start;
+  start = DWT_GET_CYCLES();
+  SIMD16_MINMAX_P(src, count, &min, &max);
+  bench->minmax[0] = DWT_GET_CYCLES() - start;
+#endif
+
+  start = DWT_GET_CYCLES();
+  SIMD16_CALIBRATE_C(dst, src, offset, gain, count);
+  bench->calibrate[1] = DWT_GET_CYCLES() - start;
+  start = DWT_GET_CYCLES();
+  SIMD16_SCALE_C(dst, src, 6406, 16, count);
+  bench->scale[1] = DWT_GET_CYCLES() - start;
+  start = DWT_GET_CYCLES();
+  dot = SIMD16_DOT_C(src, gain, count);
+  bench->dot[1] = DWT_GET_CYCLES() - start;
+  start = DWT_GET_CYCLES();
+  SIMD16_MINMAX_C(src, count, &min, &max);
+  bench->minmax[1] = DWT_GET_CYCLES() - start;
+
+  (void) dot;
+}
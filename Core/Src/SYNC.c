@@ -0,0 +1,456 @@
+#include "SYNC.h"
+#include "I2C_BUS.h"
+#include "RTOS_FAST.h"
+#include "stm32f4xx_ll_adc.h"
+#include <string.h>
+
+#define SYNC_IDLE                     0xFF              // No general call in progress
+#define SYNC_DISCARD                  0xFE              // General call that is not a sync
+
+typedef struct
+{
+  uint32_t edge;                                        // Tick of the grid edge that triggered it
+  uint16_t value;
+} SYNC_Sample;
+
+static volatile uint8_t sync_Index = SYNC_IDLE;         // Message bytes received so far
+static uint8_t sync_Message[SYNC_MESSAGE_BYTES];
+static uint16_t sync_LatchPhase;
+static uint32_t sync_LatchTick;
+static volatile int32_t sync_TickOffset;
+static volatile uint32_t sync_Generation = 1;           // Bumped on every applied sync
+static uint8_t sync_Sequence;
+static uint32_t sync_LastSend;
+static uint8_t sync_TickLocked;
+static SYNC_Sample sync_Samples[2][SYNC_ADC_DEPTH];     // ADC1, ADC2, indexed by edge % depth
+static SYNC_Stats sync_Stats;
+
+
+/**
+  * @brief  Latches the grid phase and the tick count at a sync event.
+  * @param  phase: Receives TIM8->CNT.
+  * @param  tick: Receives the RTOS tick count.
+  * @retval None
+  * @note   xTaskGetTickCount is a plain load on this port (portTICK_TYPE_IS_ATOMIC), so it is
+  *         safe above the syscall priority. A tick whose interrupt is still pending has
+  *         already happened on the grid and is counted.
+  */
+
+static inline void SYNC_LATCH(uint16_t *phase, uint32_t *tick)
+{
+  *phase = (uint16_t) TIM8->CNT;
+  *tick = xTaskGetTickCount();
+  if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    (*tick)++;
+}
+
+
+/**
+  * @brief  Returns the tick a grid edge is filed under, from inside its conversion's interrupt.
+  * @param  None
+  * @retval The tick that the lock raises SYNC_ADC_LEAD_US after the latest grid edge.
+  * @note   Before that compare the tick is still the previous one; a conversion interrupt
+  *         held off past it finds the tick already counted (or pending, see SYNC_LATCH).
+  */
+
+static inline uint32_t SYNC_EDGE(void)
+{
+  uint16_t phase;
+  uint32_t tick;
+
+  SYNC_LATCH(&phase, &tick);
+  return (phase < SYNC_ADC_LEAD_US) ? tick + 1U : tick;
+}
+
+
+/**
+  * @brief  Re-locks the RTOS tick to the grid at the next TIM8 compare (CNT = SYNC_ADC_LEAD_US).
+  * @param  None
+  * @retval None
+  */
+
+static void SYNC_LOCK_TICK(void)
+{
+  CLEAR_BIT(TIM8->SR, TIM_SR_CC1IF);
+  SET_BIT(TIM8->DIER, TIM_DIER_CC1IE);
+}
+
+
+/**
+  * @brief  Applies a received sync: steps the grid onto the master's and adopts its tick numbering.
+  * @param  None
+  * @retval None
+  * @note   Both sides express the latch instant as microseconds since their own tick zero
+  *         (tick * 1000 + time since the last grid tick). Their difference, rounded to whole
+  *         ticks, is the tick offset; the remainder (within +-500 us) is the grid skew.
+  *         The step is relative, so the time spent since the latch does not matter.
+  */
+
+static void SYNC_APPLY(void)
+{
+  uint16_t master_phase = sync_Message[2] | (sync_Message[3] << 8);
+  uint32_t master_tick = sync_Message[4] | (sync_Message[5] << 8) | (sync_Message[6] << 16) | ((uint32_t) sync_Message[7] << 24);
+  int32_t since_master = (master_phase + SYNC_GRID_US - SYNC_ADC_LEAD_US) % SYNC_GRID_US;
+  int32_t since_local = (sync_LatchPhase + SYNC_GRID_US - SYNC_ADC_LEAD_US) % SYNC_GRID_US;
+  int64_t diff = (int64_t) (int32_t) (master_tick - sync_LatchTick) * SYNC_GRID_US + since_master - since_local;
+  int32_t offset = (int32_t) ((diff + ((diff >= 0) ? SYNC_GRID_US / 2 : -(SYNC_GRID_US / 2))) / SYNC_GRID_US);
+  int32_t skew = (int32_t) (diff - (int64_t) offset * SYNC_GRID_US);
+  uint32_t magnitude = (skew < 0) ? -skew : skew;
+
+  if (master_phase >= SYNC_GRID_US)
+  {
+    sync_Stats.ignored++;
+    return;
+  }
+
+  TIM8->CNT = (TIM8->CNT + SYNC_GRID_US + skew) % SYNC_GRID_US;
+  SYNC_LOCK_TICK();
+
+  if (sync_Stats.syncs && (magnitude > sync_Stats.skew_max_us))
+    sync_Stats.skew_max_us = magnitude;
+  sync_Stats.skew_us = skew;
+  sync_Stats.sequence = sync_Message[1];
+  sync_Stats.tick_offset = sync_TickOffset + offset;
+  sync_Stats.syncs++;
+  sync_TickOffset += offset;
+  sync_Generation++;
+}
+
+
+/**
+  * @brief  Sends one sync message (general call), latching the grid when the command is acknowledged.
+  * @param  ctx: The SYNC_MESSAGE_BYTES message, command and sequence filled in.
+  * @retval An I2C_BUS_ result.
+  * @note   Register-level, like the LCD byte pump. Interrupts are held off while waiting for the
+  *         acknowledge of the command byte (one byte time) so the latch is not delayed.
+  */
+
+static int SYNC_SEND_ONCE(void *ctx)
+{
+  uint8_t *msg = (uint8_t *) ctx;
+  uint32_t start = DWT_GET_CYCLES();
+  uint32_t primask, tick;
+  uint16_t phase;
+  int status;
+
+  while (LL_I2C_IsActiveFlag_BUSY(I2C2))
+  {
+    if (DWT_GET_CYCLES() - start > I2C_BUS_TIMEOUT * (SystemCoreClock / 1000U))
+      return I2C_BUS_BUSY;
+  }
+
+  LL_I2C_GenerateStartCondition(I2C2);
+  status = I2C_BUS_WAIT(I2C_SR1_SB, start);
+  if (status == I2C_BUS_OK)
+  {
+    LL_I2C_TransmitData8(I2C2, 0x00);
+    status = I2C_BUS_WAIT(I2C_SR1_ADDR, start);
+  }
+  if (status == I2C_BUS_OK)
+  {
+    LL_I2C_ClearFlag_ADDR(I2C2);
+    primask = __get_PRIMASK();
+    __disable_irq();
+    LL_I2C_TransmitData8(I2C2, msg[0]);
+    status = I2C_BUS_WAIT(I2C_SR1_BTF, start);
+    SYNC_LATCH(&phase, &tick);
+    __set_PRIMASK(primask);
+  }
+  if (status == I2C_BUS_OK)
+  {
+    msg[2] = phase;
+    msg[3] = phase >> 8;
+    msg[4] = tick;
+    msg[5] = tick >> 8;
+    msg[6] = tick >> 16;
+    msg[7] = tick >> 24;
+    for (uint8_t i = 1; (i < SYNC_MESSAGE_BYTES) && (status == I2C_BUS_OK); i++)
+    {
+      status = I2C_BUS_WAIT(I2C_SR1_TXE, start);
+      if (status == I2C_BUS_OK)
+        LL_I2C_TransmitData8(I2C2, msg[i]);
+    }
+    if (status == I2C_BUS_OK)
+      status = I2C_BUS_WAIT(I2C_SR1_BTF, start);
+  }
+
+  LL_I2C_ClearFlag_AF(I2C2);
+  if (LL_I2C_IsActiveFlag_ARLO(I2C2))
+    LL_I2C_ClearFlag_ARLO(I2C2);
+  else
+    LL_I2C_GenerateStopCondition(I2C2);
+  LL_I2C_ClearFlag_BERR(I2C2);
+  return status;
+}
+
+
+/**
+  * @brief  Starts the sampling grid and, on the other boards, general-call reception.
+  * @param  None
+  * @retval None
+  * @note   Call after ADC_FAST_INIT (the ADCs stay powered and wait for the TIM8 trigger;
+  *         with ADC_FAST_PATH 0 they are left to HAL and the grid only paces the tasks)
+  *         and after MX_I2C2_Init. General-call acknowledge is set here, on the receiving
+  *         boards only. The tick is locked later, by SYNC_SERVICE: the scheduler start
+  *         reprograms SysTick and would undo a lock taken now.
+  */
+
+void SYNC_INIT(void)
+{
+  DWT_DELAY_INIT();
+  __HAL_RCC_TIM8_CLK_ENABLE();
+
+  // TIM8: 1 MHz, one update per tick (TRGO), compare 1 at the tick position
+  TIM8->CR1 = 0;
+  TIM8->PSC = SYNC_TIMER_CLOCK_HZ / 1000000U - 1U;
+  TIM8->ARR = SYNC_GRID_US - 1U;
+  TIM8->CCR1 = SYNC_ADC_LEAD_US;
+  TIM8->CR2 = TIM_CR2_MMS_1;                            // TRGO on update
+  TIM8->EGR = TIM_EGR_UG;
+  TIM8->SR = 0;
+  TIM8->CR1 = TIM_CR1_CEN;
+
+  HAL_NVIC_SetPriority(TIM8_CC_IRQn, SYNC_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(TIM8_CC_IRQn);
+
+#if SYNC_ADC_TRIGGER
+  memset(sync_Samples, 0xFF, sizeof(sync_Samples));     // No edge filed yet
+  LL_ADC_REG_SetContinuousMode(ADC1, LL_ADC_REG_CONV_SINGLE);
+  LL_ADC_REG_SetTriggerSource(ADC1, LL_ADC_REG_TRIG_EXT_TIM8_TRGO);
+  SET_BIT(ADC1->CR1, ADC_CR1_EOCIE | ADC_CR1_OVRIE);
+  LL_ADC_REG_StartConversionExtTrig(ADC1, LL_ADC_REG_TRIG_EXT_RISING);
+  LL_ADC_REG_SetContinuousMode(ADC2, LL_ADC_REG_CONV_SINGLE);
+  LL_ADC_REG_SetTriggerSource(ADC2, LL_ADC_REG_TRIG_EXT_TIM8_TRGO);
+  SET_BIT(ADC2->CR1, ADC_CR1_EOCIE | ADC_CR1_OVRIE);
+  LL_ADC_REG_StartConversionExtTrig(ADC2, LL_ADC_REG_TRIG_EXT_RISING);
+  HAL_NVIC_SetPriority(ADC_IRQn, SYNC_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(ADC_IRQn);
+#endif
+
+#if !SYNC_ROLE_MASTER
+  // The master leaves general calls off (MX_I2C2_Init): it has nothing to receive
+  LL_I2C_EnableGeneralCall(I2C2);
+  LL_I2C_AcknowledgeNextData(I2C2, LL_I2C_ACK);
+  HAL_NVIC_SetPriority(I2C2_EV_IRQn, SYNC_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(I2C2_EV_IRQn);
+  SET_BIT(I2C2->CR2, I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN);
+#endif
+}
+
+
+/**
+  * @brief  Sends a sync to the other boards.
+  * @param  None
+  * @retval An I2C_BUS_ result.
+  * @note   Master only. Goes through the bus manager (lock, arbitration retry).
+  */
+
+int SYNC_SEND(void)
+{
+  uint8_t msg[SYNC_MESSAGE_BYTES] = { SYNC_COMMAND, ++sync_Sequence };
+  int status;
+
+  status = I2C_BUS_RUN(I2C_BUS_CLIENT_SYNC, SYNC_SEND_ONCE, msg);
+  if (status == I2C_BUS_OK)
+  {
+    sync_Stats.sequence = sync_Sequence;
+    sync_Stats.syncs++;
+  }
+  return status;
+}
+
+
+/**
+  * @brief  Locks the RTOS tick onto the grid on the first pass, then sends a sync every
+  *         SYNC_PERIOD_MS on the master board.
+  * @param  now_ms: Current time (HAL_GetTick).
+  * @retval None
+  * @note   The first lock is taken here on every board, the master included, once the
+  *         scheduler has set SysTick up; the other boards re-lock on every sync they apply.
+  */
+
+void SYNC_SERVICE(uint32_t now_ms)
+{
+  if (!sync_TickLocked)
+  {
+    sync_TickLocked = 1;
+    SYNC_LOCK_TICK();
+  }
+#if SYNC_ROLE_MASTER
+  if (now_ms - sync_LastSend >= SYNC_PERIOD_MS)
+  {
+    sync_LastSend = now_ms;
+    SYNC_SEND();
+  }
+#else
+  (void) now_ms;
+  (void) sync_LastSend;
+#endif
+}
+
+
+/**
+  * @brief  Moves a fixed-period wake time onto the shared grid after a sync.
+  * @param  wake: The RTOS_DELAY_UNTIL reference of the calling task.
+  * @param  period: Its period in ticks.
+  * @param  seen: Generation already applied by the caller (start at 0).
+  * @retval None
+  * @note   The next wake becomes the next master tick that is a multiple of period, so boards
+  *         with the same period sample the same grid edge. Call before RTOS_DELAY_UNTIL.
+  */
+
+void SYNC_ALIGN_WAKE(uint32_t *wake, uint32_t period, uint32_t *seen)
+{
+  uint32_t generation = sync_Generation;
+  uint32_t now;
+
+  if ((*seen == generation) || (period == 0))
+    return;
+
+  *seen = generation;
+  now = osKernelGetTickCount();
+  *wake = now + period - ((now + (uint32_t) sync_TickOffset) % period) - period;
+}
+
+
+/**
+  * @brief  Returns the sample an ADC took at the grid edge of a tick.
+  * @param  adc: ADC1 or ADC2.
+  * @param  tick: The tick (e.g. the wake time of the reading task).
+  * @retval The conversion result, or -1 if that edge was not converted or is more than
+  *         SYNC_ADC_DEPTH ticks old.
+  */
+
+int SYNC_SAMPLE(ADC_TypeDef *adc, uint32_t tick)
+{
+  const SYNC_Sample *slot = &sync_Samples[(adc == ADC2) ? 1 : 0][tick % SYNC_ADC_DEPTH];
+  uint32_t primask = __get_PRIMASK();
+  uint32_t edge;
+  uint16_t value;
+
+  __disable_irq();
+  edge = slot->edge;
+  value = slot->value;
+  __set_PRIMASK(primask);
+  return (edge == tick) ? value : -1;
+}
+
+
+/**
+  * @brief  Reads the sync counters and the residual skew.
+  * @param  stats: Receives the statistics.
+  * @retval None
+  * @note   On the master only syncs and sequence move.
+  */
+
+void SYNC_READ_STATS(SYNC_Stats *stats)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  *stats = sync_Stats;
+  __set_PRIMASK(primask);
+}
+
+
+/**
+  * @brief  Receives general calls (I2C2 event interrupt, slave side).
+  * @param  None
+  * @retval None
+  * @note   Reading SR1 then SR2 clears ADDR, reading DR clears RXNE, and a CR1 write after the
+  *         SR1 read clears STOPF. Masked by I2C_BUS while this board is master.
+  */
+
+void SYNC_I2C_EV_IRQHandler(void)
+{
+  uint32_t sr1 = I2C2->SR1;
+
+  if (sr1 & I2C_SR1_ADDR)
+    sync_Index = (I2C2->SR2 & I2C_SR2_GENCALL) ? 0 : SYNC_DISCARD;
+
+  if (sr1 & I2C_SR1_RXNE)
+  {
+    uint8_t byte = (uint8_t) I2C2->DR;
+
+    if (sync_Index == 0)
+    {
+      if (byte == SYNC_COMMAND)
+        SYNC_LATCH(&sync_LatchPhase, &sync_LatchTick);
+      else
+        sync_Index = SYNC_DISCARD;
+    }
+    if (sync_Index < SYNC_MESSAGE_BYTES)
+      sync_Message[sync_Index++] = byte;
+    else if (sync_Index != SYNC_IDLE)
+      sync_Index = SYNC_DISCARD;
+  }
+
+  if (sr1 & I2C_SR1_STOPF)
+  {
+    SET_BIT(I2C2->CR1, I2C_CR1_PE);
+    if (sync_Index == SYNC_MESSAGE_BYTES)
+      SYNC_APPLY();
+    else if (sync_Index != SYNC_IDLE)
+      sync_Stats.ignored++;
+    sync_Index = SYNC_IDLE;
+  }
+}
+
+
+/**
+  * @brief  Locks the RTOS tick onto the grid (TIM8 compare 1 interrupt).
+  * @param  None
+  * @retval None
+  * @note   Clearing SysTick->VAL restarts the tick period here. If the tick it replaces was
+  *         less than half a period away it is raised now instead, so no tick is lost or doubled.
+  *         SysTick and TIM8 share the PLL, so the lock holds until the next step.
+  */
+
+void SYNC_TIMER_IRQHandler(void)
+{
+  uint32_t remaining;
+
+  if (!(TIM8->SR & TIM_SR_CC1IF))
+    return;
+  CLEAR_BIT(TIM8->SR, TIM_SR_CC1IF);
+  CLEAR_BIT(TIM8->DIER, TIM_DIER_CC1IE);
+
+  remaining = SysTick->VAL;
+  SysTick->VAL = 0;
+  if (remaining < SysTick->LOAD / 2U)
+    SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+}
+
+
+/**
+  * @brief  Files every grid-triggered conversion of ADC1/ADC2 under its edge (ADC interrupt).
+  * @param  None
+  * @retval None
+  * @note   Reading DR clears EOC, so no conversion is left pending and the next trigger is
+  *         taken. An overrun (interrupt held off for a whole grid step, e.g. during a flash
+  *         erase) stops the ADC until OVR is cleared, which is done here so it restarts at
+  *         the next edge.
+  */
+
+void SYNC_ADC_IRQHandler(void)
+{
+  ADC_TypeDef *const adcs[2] = { ADC1, ADC2 };
+
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    ADC_TypeDef *adc = adcs[i];
+
+    if (adc->SR & ADC_SR_OVR)
+    {
+      CLEAR_BIT(adc->SR, ADC_SR_OVR);
+      sync_Stats.adc_overruns++;
+    }
+    if ((adc->SR & ADC_SR_EOC) && (adc->CR1 & ADC_CR1_EOCIE))
+    {
+      uint32_t edge = SYNC_EDGE();
+      SYNC_Sample *slot = &sync_Samples[i][edge % SYNC_ADC_DEPTH];
+      slot->value = (uint16_t) adc->DR;
+      slot->edge = edge;
+    }
+  }
+}
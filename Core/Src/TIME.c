@@ -0,0 +1,425 @@
+#include "TIME.h"
+#include "SNAPSHOT.h"
+#include <string.h>
+
+#define TIME_BKP_MAGIC                0x54494D45U       // "TIME" in RTC->BKP0R: calendar has been set
+#define TIME_SKEW_MAX                 2147484           // 500 ppm in Q32, keeps d * skew within 64 bits
+
+static uint8_t time_Source;
+static uint32_t time_Prediv_S;
+static uint32_t time_Last;                              // Tick of the last correlation attempt
+static uint8_t time_Measured;                           // Rate measurements taken so far (saturates)
+static uint8_t time_Stepped;                            // Calendar set since the last correlation
+static volatile uint8_t time_Set_Pending;
+static volatile uint32_t time_Set_Value;
+static TIME_Map time_Map;                               // Written by TIME_SERVICE only
+static SNAPSHOT_Handle time_Snapshot;
+static TIME_Map time_Map_Copy[2];
+static TIME_Stats time_Stats;
+
+
+/**
+  * @brief  Signed difference between two monotonic points.
+  * @param  a: Later point.
+  * @param  b: Earlier point.
+  * @retval a - b in microseconds (valid within +/- 24 days).
+  */
+
+static inline int64_t TIME_DIFF_US(const TIME_Mono *a, const TIME_Mono *b)
+{
+  return (int64_t) (int32_t) (a->ms - b->ms) * 1000 + ((int32_t) a->us - (int32_t) b->us);
+}
+
+
+/**
+  * @brief  Applies a mapping to a monotonic point.
+  * @param  map: The mapping.
+  * @param  mono: The point.
+  * @retval Unix time in microseconds.
+  */
+
+static inline int64_t TIME_APPLY(const TIME_Map *map, const TIME_Mono *mono)
+{
+  int64_t d = TIME_DIFF_US(mono, &map->base_mono);
+
+  return map->base_wall_us + d + ((d * map->skew_q32) >> 32);
+}
+
+
+static inline uint32_t TIME_BCD(uint32_t value)
+{
+  return ((value / 10) << 4) | (value % 10);
+}
+
+
+static inline uint32_t TIME_BIN(uint32_t bcd)
+{
+  return (bcd >> 4) * 10 + (bcd & 0x0F);
+}
+
+
+/**
+  * @brief  Loads the RTC calendar.
+  * @param  unix_s: Unix time in seconds (2000 to 2099).
+  * @retval None
+  * @note   The sub-second counter restarts with the new second. Backup domain write access
+  *         must be enabled.
+  */
+
+static void TIME_RTC_WRITE(uint32_t unix_s)
+{
+  TIME_Civil c;
+
+  TIME_CIVIL(unix_s, &c);
+  RTC->WPR = 0xCA;
+  RTC->WPR = 0x53;
+  RTC->ISR |= RTC_ISR_INIT;
+  while (!(RTC->ISR & RTC_ISR_INITF))
+    ;
+  RTC->PRER = time_Prediv_S;                            // Synchronous first, then asynchronous
+  RTC->PRER = time_Prediv_S | (TIME_PREDIV_A << RTC_PRER_PREDIV_A_Pos);
+  RTC->TR = (TIME_BCD(c.hour) << RTC_TR_HU_Pos) | (TIME_BCD(c.minute) << RTC_TR_MNU_Pos) |
+            (TIME_BCD(c.second) << RTC_TR_SU_Pos);
+  RTC->DR = (TIME_BCD(c.year - 2000U) << RTC_DR_YU_Pos) | ((uint32_t) c.weekday << RTC_DR_WDU_Pos) |
+            (TIME_BCD(c.month) << RTC_DR_MU_Pos) | (TIME_BCD(c.day) << RTC_DR_DU_Pos);
+  RTC->CR &= ~RTC_CR_FMT;
+  RTC->ISR &= ~RTC_ISR_INIT;
+  RTC->WPR = 0xFF;
+  RTC->BKP0R = TIME_BKP_MAGIC;
+}
+
+
+/**
+  * @brief  Catches the RTC at an edge of its sub-second counter.
+  * @param  mono: Receives the monotonic time of the edge (middle of the bracket).
+  * @param  wall_us: Receives the Unix time of the edge in microseconds.
+  * @retval 0 on success, -1 if no edge was bracketed within TIME_EDGE_MAX_US.
+  * @note   The counter is polled with interrupts enabled; an edge straddled by an interrupt
+  *         gives a wide bracket and the next edge (one sub-second step later) is tried.
+  *         Shadow registers are bypassed, so the calendar is read until two reads agree.
+  */
+
+static int TIME_CAPTURE(TIME_Mono *mono, int64_t *wall_us)
+{
+  for (uint8_t attempt = 0; attempt < TIME_EDGE_TRIES; attempt++)
+  {
+    TIME_Mono start, before, after, old;
+    uint32_t ss0 = RTC->SSR;
+    uint32_t ss, tr, dr;
+
+    TIME_MONO_NOW(&start);
+    old = start;
+    for (;;)
+    {
+      TIME_MONO_NOW(&before);
+      ss = RTC->SSR;
+      TIME_MONO_NOW(&after);
+      if (ss != ss0)
+        break;
+      old = before;
+      if (TIME_DIFF_US(&after, &start) > 1000)
+        return -1;                                      // RTC not running
+    }
+
+    do
+    {
+      tr = RTC->TR;
+      dr = RTC->DR;
+    } while ((tr != RTC->TR) || (dr != RTC->DR));
+    if ((RTC->SSR != ss) || (TIME_DIFF_US(&after, &old) > TIME_EDGE_MAX_US))
+      continue;
+
+    TIME_Civil c = {
+      .year = (uint16_t) (2000U + TIME_BIN((dr & (RTC_DR_YT | RTC_DR_YU)) >> RTC_DR_YU_Pos)),
+      .month = (uint8_t) TIME_BIN((dr & (RTC_DR_MT | RTC_DR_MU)) >> RTC_DR_MU_Pos),
+      .day = (uint8_t) TIME_BIN((dr & (RTC_DR_DT | RTC_DR_DU)) >> RTC_DR_DU_Pos),
+      .hour = (uint8_t) TIME_BIN((tr & (RTC_TR_HT | RTC_TR_HU)) >> RTC_TR_HU_Pos),
+      .minute = (uint8_t) TIME_BIN((tr & (RTC_TR_MNT | RTC_TR_MNU)) >> RTC_TR_MNU_Pos),
+      .second = (uint8_t) TIME_BIN((tr & (RTC_TR_ST | RTC_TR_SU)) >> RTC_TR_SU_Pos),
+    };
+    uint32_t half = (uint32_t) TIME_DIFF_US(&after, &old) / 2;
+    uint32_t us = old.us + half;
+
+    mono->ms = old.ms + us / 1000;
+    mono->us = (uint16_t) (us % 1000);
+    *wall_us = (int64_t) TIME_UNIX(&c) * 1000000 +
+               (int64_t) (time_Prediv_S - ss) * 1000000 / (time_Prediv_S + 1);
+    return 0;
+  }
+  return -1;
+}
+
+
+/**
+  * @brief  Starts the RTC (LSE, or LSI when no 32.768 kHz crystal answers) if it is not
+  *         already running from before the reset.
+  * @param  None
+  * @retval None
+  * @note   Waits up to TIME_LSE_TIMEOUT_MS for the LSE on the first power-up only. A calendar
+  *         that was never set starts at 2000-01-01 00:00:00.
+  */
+
+void TIME_INIT(void)
+{
+  __HAL_RCC_PWR_CLK_ENABLE();
+  HAL_PWR_EnableBkUpAccess();
+
+  if (!(RCC->BDCR & RCC_BDCR_RTCEN))
+  {
+    uint32_t start = HAL_GetTick();
+
+    RCC->BDCR |= RCC_BDCR_LSEON;
+    while (!(RCC->BDCR & RCC_BDCR_LSERDY) && ((HAL_GetTick() - start) < TIME_LSE_TIMEOUT_MS))
+      ;
+    if (RCC->BDCR & RCC_BDCR_LSERDY)
+    {
+      MODIFY_REG(RCC->BDCR, RCC_BDCR_RTCSEL, RCC_BDCR_RTCSEL_0);
+    }
+    else
+    {
+      RCC->BDCR &= ~RCC_BDCR_LSEON;
+      MODIFY_REG(RCC->BDCR, RCC_BDCR_RTCSEL, RCC_BDCR_RTCSEL_1);
+    }
+    RCC->BDCR |= RCC_BDCR_RTCEN;
+  }
+
+  time_Source = ((RCC->BDCR & RCC_BDCR_RTCSEL) == RCC_BDCR_RTCSEL_0) ? TIME_RTC_LSE : TIME_RTC_LSI;
+  if (time_Source == TIME_RTC_LSI)
+  {
+    RCC->CSR |= RCC_CSR_LSION;                          // Not kept across a system reset
+    while (!(RCC->CSR & RCC_CSR_LSIRDY))
+      ;
+  }
+  time_Prediv_S = (time_Source == TIME_RTC_LSE) ? TIME_PREDIV_S_LSE : TIME_PREDIV_S_LSI;
+
+  if (RTC->BKP0R != TIME_BKP_MAGIC)
+    TIME_RTC_WRITE(TIME_UNIX_2000);
+  RTC->WPR = 0xCA;
+  RTC->WPR = 0x53;
+  RTC->CR |= RTC_CR_BYPSHAD;                            // Read the counters, not the shadow copies
+  RTC->WPR = 0xFF;
+
+  memset(&time_Map, 0, sizeof(time_Map));
+  memset(&time_Stats, 0, sizeof(time_Stats));
+  time_Stats.source = time_Source;
+  time_Measured = 0;
+  time_Stepped = 0;
+  time_Set_Pending = 0;
+  time_Last = HAL_GetTick() - TIME_CORRELATE_MS;         // First TIME_SERVICE correlates
+  SNAPSHOT_INIT(&time_Snapshot, &time_Map_Copy[0], &time_Map_Copy[1], sizeof(TIME_Map));
+}
+
+
+/**
+  * @brief  Reads the monotonic clock.
+  * @param  mono: Receives the current HAL tick and microseconds into it.
+  * @retval None
+  * @note   Callable from any context. A TIM2 update not yet counted by the tick interrupt
+  *         is accounted for.
+  */
+
+void TIME_MONO_NOW(TIME_Mono *mono)
+{
+  uint32_t ms, cnt, pending;
+
+  do
+  {
+    ms = HAL_GetTick();
+    cnt = TIM2->CNT;
+    pending = TIM2->SR & TIM_SR_UIF;
+  } while (ms != HAL_GetTick());
+  if (pending && (cnt < 500))
+    ms++;
+
+  mono->ms = ms;
+  mono->us = (uint16_t) cnt;
+}
+
+
+/**
+  * @brief  Applies a pending TIME_SET and correlates the RTC with the monotonic clock when due.
+  * @param  now: Current tick (ms).
+  * @retval 1 if a new mapping was published, otherwise 0.
+  * @note   Call from one task only. Each correlation after the first measures the rate of the
+  *         RTC against the monotonic clock over the interval and filters it into the skew.
+  */
+
+int TIME_SERVICE(uint32_t now)
+{
+  TIME_Mono mono;
+  int64_t wall_us;
+
+  if (time_Set_Pending)
+  {
+    TIME_RTC_WRITE(time_Set_Value);
+    time_Set_Pending = 0;
+    time_Stepped = 1;
+  }
+  else if ((now - time_Last) < TIME_CORRELATE_MS)
+  {
+    return 0;
+  }
+  time_Last = now;
+
+  if (TIME_CAPTURE(&mono, &wall_us) != 0)
+  {
+    time_Stats.missed++;
+    return 0;
+  }
+
+  if ((time_Map.sequence != 0) && !time_Stepped)
+  {
+    int64_t d = TIME_DIFF_US(&mono, &time_Map.base_mono);
+    int64_t residual = wall_us - TIME_APPLY(&time_Map, &mono);
+
+    time_Stats.residual_us = (int32_t) residual;
+    if ((uint32_t) (residual < 0 ? -residual : residual) > time_Stats.residual_max_us)
+      time_Stats.residual_max_us = (uint32_t) (residual < 0 ? -residual : residual);
+
+    // Rate over the interval, unless the RTC jumped (more than 1000 ppm off)
+
+    int64_t gain = wall_us - time_Map.base_wall_us - d;
+    if ((d > 0) && ((gain < 0 ? -gain : gain) < d / 1000))
+    {
+      int64_t measured = (gain * 4294967296LL) / d;
+      int64_t skew = time_Map.skew_q32;
+
+      skew = time_Measured ? skew + ((measured - skew) >> TIME_SKEW_SHIFT) : measured;
+      if (skew > TIME_SKEW_MAX)
+        skew = TIME_SKEW_MAX;
+      else if (skew < -TIME_SKEW_MAX)
+        skew = -TIME_SKEW_MAX;
+      time_Map.skew_q32 = (int32_t) skew;
+      time_Stats.skew_ppb = (int32_t) ((skew * 1000000000LL) >> 32);
+      if (time_Measured < 0xFF)
+        time_Measured++;
+    }
+  }
+  time_Stepped = 0;
+
+  time_Map.base_mono = mono;
+  time_Map.base_wall_us = wall_us;
+  time_Map.sequence++;
+  time_Stats.correlations++;
+  SNAPSHOT_PUBLISH(&time_Snapshot, &time_Map);
+  return 1;
+}
+
+
+/**
+  * @brief  Sets the wall clock.
+  * @param  unix_s: Unix time in seconds.
+  * @retval 0 if accepted, -1 outside the RTC range (2000 to 2099).
+  * @note   Callable from any task; the RTC is written by the next TIME_SERVICE, which then
+  *         correlates at once. The measured rate is kept.
+  */
+
+int TIME_SET(uint32_t unix_s)
+{
+  if ((unix_s < TIME_UNIX_2000) || (unix_s >= 4102444800U))
+    return -1;
+  time_Set_Value = unix_s;
+  time_Set_Pending = 1;
+  return 0;
+}
+
+
+/**
+  * @brief  Copies the current mapping, without locking.
+  * @param  map: Receives the mapping (sequence 0 before the first correlation).
+  * @retval None
+  */
+
+void TIME_READ_MAP(TIME_Map *map)
+{
+  SNAPSHOT_READ(&time_Snapshot, map);
+}
+
+
+/**
+  * @brief  Converts a monotonic point to Unix time.
+  * @param  mono: The point (within 24 days of the last correlation).
+  * @retval Unix time in microseconds, or 0 before the first correlation.
+  */
+
+int64_t TIME_TO_WALL_US(const TIME_Mono *mono)
+{
+  TIME_Map map;
+
+  SNAPSHOT_READ(&time_Snapshot, &map);
+  return map.sequence ? TIME_APPLY(&map, mono) : 0;
+}
+
+
+/**
+  * @brief  Converts a HAL tick (sample timestamp) to Unix time.
+  * @param  tick: The tick.
+  * @retval Unix time in milliseconds, or 0 before the first correlation.
+  */
+
+int64_t TIME_TICK_TO_WALL_MS(uint32_t tick)
+{
+  TIME_Mono mono = { .ms = tick, .us = 0 };
+
+  return TIME_TO_WALL_US(&mono) / 1000;
+}
+
+
+/**
+  * @brief  Splits Unix time into calendar fields.
+  * @param  unix_s: Unix time in seconds.
+  * @param  civil: Receives the date and time (UTC).
+  * @retval None
+  */
+
+void TIME_CIVIL(uint32_t unix_s, TIME_Civil *civil)
+{
+  uint32_t days = unix_s / 86400U;
+  uint32_t rem = unix_s % 86400U;
+  uint32_t z = days + 719468U;                          // Days since 0000-03-01
+  uint32_t era = z / 146097U;
+  uint32_t doe = z - era * 146097U;
+  uint32_t yoe = (doe - doe / 1460U + doe / 36524U - doe / 146096U) / 365U;
+  uint32_t doy = doe - (365U * yoe + yoe / 4U - yoe / 100U);
+  uint32_t mp = (5U * doy + 2U) / 153U;
+  uint32_t month = (mp < 10U) ? mp + 3U : mp - 9U;
+
+  civil->year = (uint16_t) (yoe + era * 400U + (month <= 2U));
+  civil->month = (uint8_t) month;
+  civil->day = (uint8_t) (doy - (153U * mp + 2U) / 5U + 1U);
+  civil->hour = (uint8_t) (rem / 3600U);
+  civil->minute = (uint8_t) ((rem / 60U) % 60U);
+  civil->second = (uint8_t) (rem % 60U);
+  civil->weekday = (uint8_t) ((days + 3U) % 7U + 1U);    // 1970-01-01 was a Thursday
+}
+
+
+/**
+  * @brief  Joins calendar fields into Unix time.
+  * @param  civil: Date and time (UTC, 1970 or later); the weekday is ignored.
+  * @retval Unix time in seconds.
+  */
+
+uint32_t TIME_UNIX(const TIME_Civil *civil)
+{
+  uint32_t y = civil->year - (civil->month <= 2U);
+  uint32_t era = y / 400U;
+  uint32_t yoe = y - era * 400U;
+  uint32_t doy = (153U * (civil->month > 2U ? civil->month - 3U : civil->month + 9U) + 2U) / 5U + civil->day - 1U;
+  uint32_t doe = yoe * 365U + yoe / 4U - yoe / 100U + doy;
+  uint32_t days = era * 146097U + doe - 719468U;
+
+  return days * 86400U + civil->hour * 3600U + civil->minute * 60U + civil->second;
+}
+
+
+/**
+  * @brief  Copies the correlation counters.
+  * @param  stats: Receives the counters.
+  * @retval None
+  */
+
+void TIME_READ_STATS(TIME_Stats *stats)
+{
+  *stats = time_Stats;
+}
@@ -23,19 +23,94 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "LCD_I2C.h"
+#include "LCD_CPP.h"
+#include "EXPORT.h"
+#include "CHECKSUM.h"
+#include "HISTORY.h"
+#include "SAMPLE_LOG.h"
+#include "GRAPH.h"
+#include "CHANNEL.h"
+#include "SIMD16.h"
+#include "ADC_FAST.h"
+#include "RTOS_FAST.h"
+#include "CONFIG.h"
+#include "PULSE.h"
+#include "INPUT.h"
+#include "I2C_BUS.h"
+#include "SENSOR.h"
+#include "SYNC.h"
+#include "PERSIST.h"
+#include "TIME.h"
+#include "RTT.h"
+#include "MODBUS.h"
+#include "ADC_TUNE.h"
+#include "DWT_DELAY.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
+/* Backup-SRAM records, see STATE_RESTORE / STATE_SAVE */
+typedef struct
+{
+  uint32_t boots;
+  uint32_t resets_power;                                // Power-on / brown-out
+  uint32_t resets_pin;                                  // NRST only
+  uint32_t resets_watchdog;                             // IWDG / WWDG
+  uint32_t resets_software;
+  uint32_t uptime_s;                                    // Summed over all boots
+  uint64_t pulse_edges;                                 // PULSE total summed over all boots
+} StateCounters;
+
+/* Records of the RTT trace and sample channels (little-endian, read by Tools/rtt_rx.py) */
+typedef struct
+{
+  uint32_t cycles;                                      // DWT cycle counter
+  uint16_t event;                                       // TRACE_xxx
+  uint16_t arg;
+} TraceRecord;
+
+typedef struct
+{
+  uint32_t tick;
+  uint8_t channel;
+  uint8_t reserved;
+  uint16_t value;
+} SampleRecord;
+
+typedef struct
+{
+  uint32_t config_crc;                                  // CHECKSUM of the parameters the pipeline was built from
+  GRAPH_State pipeline;
+} StatePipeline;
 
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-uint16_t readValue1, readValue2;
-char lcd_buffer1[20];
-char lcd_buffer2[20];
+#define CH_PA1                        0                 // Registry order, see CHANNEL_REGISTER in main
+#define CH_PA2                        1
+#define CH_EXT                        2                 // External ADC read on data-ready
+#define EXT_ADC_ADDRESS               (0x48 << 1)       // ADS1115-style, ALERT/RDY on PE0
+#define EXT_ADC_RESULT_REG            0x00
+#define PAGE_CHANNELS                 0                 // Display pages, selected with the encoder
+#define PAGE_PULSE                    1
+#define PAGE_CONFIG                   2
+#define PAGE_SYNC                     3
+#define PAGE_CLOCK                    4
+#define PAGE_COUNT                    5
+#define STATE_SAVE_MS                 100               // Channel and pipeline records
+#define STATE_COUNTERS_MS             1000              // Counter record
+#define TRACE_CONFIG_APPLIED          1                 // arg: configuration epoch
+#define TRACE_TIME_CORRELATED         2                 // arg: correlation sequence
+#define TRACE_SAMPLE_TIME_TUNED       3                 // arg: channel << 8 | ADC_SAMPLETIME_xxx
+#define TERMINAL_LINE_MAX             24
+#define BENCH_CHECKSUM_BYTES          16384             // Read from the start of flash
+#define HISTORY_TREND_WIDTH           24                // Sparkline buckets of the "hist" command
+#define HISTORY_TREND_RAMP            " .:-=+*#"        // Sparkline characters, lowest first
+#define LOG_QUERY_POINTS              8                 // Points printed by the "log" command
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -52,7 +127,7 @@ TIM_HandleTypeDef htim6;
 osThreadId_t defaultTaskHandle;
 const osThreadAttr_t defaultTask_attributes = {
   .name = "defaultTask",
-  .stack_size = 128 * 4,
+  .stack_size = 512 * 4,
   .priority = (osPriority_t) osPriorityNormal,
 };
 /* Definitions for ADC1Task */
@@ -86,6 +161,26 @@ osThreadId_t adc1TaskHandle;
 osThreadId_t adc2TaskHandle;
 osThreadId_t displayTaskHandle;
 osMutexId_t adcMutexHandle;
+/* Default configuration, replaced at run time through CONFIG_EDIT/CONFIG_COMMIT */
+const CONFIG_Params configDefaults = {
+  .period_ms = { 100, 2000 },
+  .gain = { CHANNEL_GAIN_ONE, CHANNEL_GAIN_ONE },
+  .offset = { 0, 0 },
+  .limit = { 1023, 1023 },
+  .sample_time = { ADC_SAMPLETIME_3CYCLES, ADC_SAMPLETIME_3CYCLES },
+  .filter_shift = 2,
+  .decimate = 4,
+};
+static StateCounters stateCounters;
+static StatePipeline statePipeline;
+static int stateCountersId;
+static int stateChannelsId;
+static int statePipelineId;
+static uint32_t stateUptimeBase;                        // Restored totals, the current boot is added
+static uint64_t statePulseBase;
+static const uint8_t adcInputs[CONFIG_CHANNELS] = { ADC_CHANNEL_1, ADC_CHANNEL_2 };
+static volatile uint8_t lcdBenchPending;                // Set by the "bench" command, run by Display_Task
+static const uint8_t adcKicks[CONFIG_CHANNELS] = { ADC_TUNE_REFERENCE, ADC_CHANNEL_1 }; // VREFINT is ADC1 only
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -101,74 +196,759 @@ extern void ADC2_Task(void *argument);
 extern void Display_Task(void *argument);
 
 /* USER CODE BEGIN PFP */
-void read_val1(void);
-void read_val2(void);
+void read_val1(uint32_t tick);
+void read_val2(uint32_t tick);
+void SAMPLE_TIME_APPLY(ADC_TypeDef *adc, uint8_t ch, const CONFIG_Set *config);
+int SAMPLE_TIME_TUNE(const char *arg);
+int PIPELINE_BUILD(CONFIG_Set *set);
+void STATE_RESTORE(void);
+void STATE_SAVE(uint32_t now, CONFIG_Set *config);
+void TRACE_EVENT(uint16_t event, uint16_t arg);
+void SAMPLE_STREAM(uint8_t channel, uint16_t value);
+void TERMINAL_BENCH(void);
+void TERMINAL_STATS(CONFIG_Set *config);
+int HISTORY_REPORT(const char *arg);
+int SAMPLE_LOG_REPORT(const char *arg);
+void LCD_BENCH_REPORT(void);
+void TERMINAL_SERVICE(CONFIG_Set *config);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
-void read_val1(void)
+/* Per-variant processing: smoothed, decimated statistics of every channel */
+int PIPELINE_BUILD(CONFIG_Set *set)
+{
+  GRAPH_INIT(&set->pipeline);
+  for (uint8_t ch = 0; ch < GRAPH_CHANNELS; ch++)
+  {
+    int src = GRAPH_ADD_SOURCE(&set->pipeline, ch);
+    int filter = GRAPH_ADD_FILTER(&set->pipeline, src, set->params.filter_shift);
+    set->stats[ch] = GRAPH_ADD_STATS(&set->pipeline, GRAPH_ADD_DECIMATE(&set->pipeline, filter, set->params.decimate));
+  }
+  return GRAPH_COMPILE(&set->pipeline);
+}
+
+void read_val1(uint32_t tick)
 {
-   osMutexAcquire(adcMutexHandle, osWaitForever);
+   RTOS_MUTEX_ACQUIRE(adcMutexHandle, osWaitForever);
+#if SYNC_ADC_TRIGGER
+   // Sample taken by the TIM8 grid edge just before this tick
+   int value = SYNC_SAMPLE(ADC1, tick);
+   if (value >= 0)
+     CHANNEL_SET(CH_PA1, value, HAL_GetTick());
+#elif ADC_FAST_PATH
+   int value = ADC_FAST_READ(ADC1);
+   if (value >= 0)
+     CHANNEL_SET(CH_PA1, value, HAL_GetTick());
+#else
+   (void) tick;
    HAL_ADC_Start(&hadc1);
    HAL_ADC_PollForConversion(&hadc1, 1000);
-   readValue1 = HAL_ADC_GetValue(&hadc1);
+   CHANNEL_SET(CH_PA1, HAL_ADC_GetValue(&hadc1), HAL_GetTick());
    HAL_ADC_Stop(&hadc1);
-   osMutexRelease(adcMutexHandle);
+#endif
+   RTOS_MUTEX_RELEASE(adcMutexHandle);
 }
 
-void read_val2(void)
+void read_val2(uint32_t tick)
 {
-   osMutexAcquire(adcMutexHandle, osWaitForever);
+   RTOS_MUTEX_ACQUIRE(adcMutexHandle, osWaitForever);
+#if SYNC_ADC_TRIGGER
+   // Sample taken by the TIM8 grid edge just before this tick
+   int value = SYNC_SAMPLE(ADC2, tick);
+   if (value >= 0)
+     CHANNEL_SET(CH_PA2, value, HAL_GetTick());
+#elif ADC_FAST_PATH
+   int value = ADC_FAST_READ(ADC2);
+   if (value >= 0)
+     CHANNEL_SET(CH_PA2, value, HAL_GetTick());
+#else
+   (void) tick;
    HAL_ADC_Start(&hadc2);
    HAL_ADC_PollForConversion(&hadc2, 1000);
-   readValue2 = HAL_ADC_GetValue(&hadc2);
+   CHANNEL_SET(CH_PA2, HAL_ADC_GetValue(&hadc2), HAL_GetTick());
    HAL_ADC_Stop(&hadc2);
-   osMutexRelease(adcMutexHandle);
+#endif
+   RTOS_MUTEX_RELEASE(adcMutexHandle);
+}
+
+/**
+  * @brief  Programs the sample time a configuration gives a channel into its ADC.
+  * @param  adc: ADC1 for CH_PA1, ADC2 for CH_PA2.
+  * @param  ch: The channel.
+  * @param  config: Configuration set the calling stage runs on.
+  * @retval None
+  * @note   Taken under adcMutex so that it cannot land inside a SAMPLE_TIME_TUNE run.
+  */
+
+void SAMPLE_TIME_APPLY(ADC_TypeDef *adc, uint8_t ch, const CONFIG_Set *config)
+{
+  RTOS_MUTEX_ACQUIRE(adcMutexHandle, osWaitForever);
+  ADC_TUNE_SET_SAMPLE_TIME(adc, adcInputs[ch], config->params.sample_time[ch]);
+  RTOS_MUTEX_RELEASE(adcMutexHandle);
 }
 
-/* ADC1 Task - reads every 100ms */
+/* ADC1 Task - reads every period_ms[CH_PA1] (100 ms by default) on a fixed schedule */
 void ADC1_Task(void *argument)
 {
-  const uint32_t delay_ms = 100;
+  CONFIG_Set *config = CONFIG_ENTER(CONFIG_STAGE_ACQ0);
+  uint32_t wake = osKernelGetTickCount();
+  uint32_t synced = 0;
 
+  SAMPLE_TIME_APPLY(ADC1, CH_PA1, config);
   for(;;)
   {
-    read_val1();
-    osDelay(delay_ms);
+    read_val1(wake);
+    uint16_t value = channel_Registry.raw[CH_PA1];
+    EXPORT_PUSH_SAMPLE(CH_PA1, value);
+    HISTORY_ADD(CH_PA1, value, HAL_GetTick());
+    SAMPLE_LOG_APPEND(CH_PA1, value);
+    SAMPLE_STREAM(CH_PA1, value);
+    GRAPH_PUSH_SAMPLE(&config->pipeline, CH_PA1, value);
+    // Block boundary: pick up a newly committed configuration
+    if (config->pipeline.staged[CH_PA1] == 0)
+    {
+      config = CONFIG_ENTER(CONFIG_STAGE_ACQ0);
+      SAMPLE_TIME_APPLY(ADC1, CH_PA1, config);
+    }
+    // Sample on the same grid edges as the other boards
+    SYNC_ALIGN_WAKE(&wake, config->params.period_ms[CH_PA1], &synced);
+    RTOS_DELAY_UNTIL(&wake, config->params.period_ms[CH_PA1]);
   }
 }
 
-/* ADC2 Task - reads every 500ms */
+/* ADC2 Task - reads every period_ms[CH_PA2] (2 s by default) on a fixed schedule */
 void ADC2_Task(void *argument)
 {
-  const uint32_t delay_ms = 2000;
+  CONFIG_Set *config = CONFIG_ENTER(CONFIG_STAGE_ACQ1);
+  uint32_t wake = osKernelGetTickCount();
+  uint32_t synced = 0;
 
+  SAMPLE_TIME_APPLY(ADC2, CH_PA2, config);
   for(;;)
   {
-    read_val2();
-    osDelay(delay_ms);
+    read_val2(wake);
+    uint16_t value = channel_Registry.raw[CH_PA2];
+    EXPORT_PUSH_SAMPLE(CH_PA2, value);
+    HISTORY_ADD(CH_PA2, value, HAL_GetTick());
+    SAMPLE_LOG_APPEND(CH_PA2, value);
+    SAMPLE_STREAM(CH_PA2, value);
+    GRAPH_PUSH_SAMPLE(&config->pipeline, CH_PA2, value);
+    // Block boundary: pick up a newly committed configuration
+    if (config->pipeline.staged[CH_PA2] == 0)
+    {
+      config = CONFIG_ENTER(CONFIG_STAGE_ACQ1);
+      SAMPLE_TIME_APPLY(ADC2, CH_PA2, config);
+    }
+    // Sample on the same grid edges as the other boards
+    SYNC_ALIGN_WAKE(&wake, config->params.period_ms[CH_PA2], &synced);
+    RTOS_DELAY_UNTIL(&wake, config->params.period_ms[CH_PA2]);
+  }
+}
+
+/**
+  * @brief  Resumes from the backup SRAM: counts the boot and its cause, and puts the channel
+  *         values and the pipeline filters / statistics back as they were at the last save.
+  * @param  None
+  * @retval None
+  * @note   Runs once at boot, after the channels and the configuration are set up and before
+  *         the sampling tasks start. The pipeline state is only taken if it was saved with the
+  *         same parameters (a graph built differently is left cold).
+  */
+
+void STATE_RESTORE(void)
+{
+  CHANNEL_Snapshot snap;
+  CONFIG_Set *config = CONFIG_ENTER(CONFIG_STAGE_PROCESS);
+  char line[80];
+
+  PERSIST_INIT();
+  stateCountersId = PERSIST_DEFINE(sizeof(StateCounters));
+  stateChannelsId = PERSIST_DEFINE(sizeof(CHANNEL_Snapshot));
+  statePipelineId = PERSIST_DEFINE(sizeof(StatePipeline));
+
+  PERSIST_LOAD(stateCountersId, &stateCounters);        // Stays zero on a first boot
+  stateCounters.boots++;
+  if (__HAL_RCC_GET_FLAG(RCC_FLAG_BORRST) || __HAL_RCC_GET_FLAG(RCC_FLAG_PORRST))
+    stateCounters.resets_power++;
+  else if (__HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST) || __HAL_RCC_GET_FLAG(RCC_FLAG_WWDGRST))
+    stateCounters.resets_watchdog++;
+  else if (__HAL_RCC_GET_FLAG(RCC_FLAG_SFTRST))
+    stateCounters.resets_software++;
+  else if (__HAL_RCC_GET_FLAG(RCC_FLAG_PINRST))
+    stateCounters.resets_pin++;
+  __HAL_RCC_CLEAR_RESET_FLAGS();
+  snprintf(line, sizeof(line), "boot %lu: power %lu, pin %lu, watchdog %lu, software %lu\n",
+           (unsigned long) stateCounters.boots, (unsigned long) stateCounters.resets_power,
+           (unsigned long) stateCounters.resets_pin, (unsigned long) stateCounters.resets_watchdog,
+           (unsigned long) stateCounters.resets_software);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+  stateUptimeBase = stateCounters.uptime_s;
+  statePulseBase = stateCounters.pulse_edges;
+  PERSIST_SAVE(stateCountersId, &stateCounters);
+
+  if (PERSIST_LOAD(stateChannelsId, &snap) == 0)
+    CHANNEL_RESTORE(&snap);
+
+  if ((PERSIST_LOAD(statePipelineId, &statePipeline) == 0) &&
+      (statePipeline.config_crc == CHECKSUM_BLOCK(&config->params, sizeof(config->params))))
+    GRAPH_LOAD_STATE(&config->pipeline, &statePipeline.pipeline);
+}
+
+
+/**
+  * @brief  Saves the channel values and pipeline state every STATE_SAVE_MS, and the counters
+  *         every STATE_COUNTERS_MS.
+  * @param  now: Current tick (ms).
+  * @param  config: Active configuration set of the calling stage.
+  * @retval None
+  */
+
+void STATE_SAVE(uint32_t now, CONFIG_Set *config)
+{
+  static uint32_t saved;
+  static uint32_t counted;
+  CHANNEL_Snapshot snap;
+  PULSE_Result pulse;
+
+  if ((now - saved) < STATE_SAVE_MS)
+    return;
+  saved = now;
+
+  CHANNEL_READ_SNAPSHOT(&snap);
+  PERSIST_SAVE(stateChannelsId, &snap);
+  statePipeline.config_crc = CHECKSUM_BLOCK(&config->params, sizeof(config->params));
+  GRAPH_SAVE_STATE(&config->pipeline, &statePipeline.pipeline);
+  PERSIST_SAVE(statePipelineId, &statePipeline);
+
+  if ((now - counted) >= STATE_COUNTERS_MS)
+  {
+    counted = now;
+    PULSE_READ(&pulse);
+    stateCounters.uptime_s = stateUptimeBase + now / 1000;
+    stateCounters.pulse_edges = statePulseBase + pulse.total;
+    PERSIST_SAVE(stateCountersId, &stateCounters);
   }
 }
 
-/* Display Task - updates LCD periodically */
+
+/**
+  * @brief  Appends an event to the RTT trace channel.
+  * @param  event: TRACE_xxx.
+  * @param  arg: Event argument.
+  * @retval None
+  */
+
+void TRACE_EVENT(uint16_t event, uint16_t arg)
+{
+  TraceRecord record = { DWT_GET_CYCLES(), event, arg };
+
+  RTT_WRITE_SHARED(RTT_TRACE, &record, sizeof(record));
+}
+
+
+/**
+  * @brief  Appends a sample to the RTT sample channel (oldest samples are overwritten when
+  *         no reader keeps up).
+  * @param  channel: Registry channel.
+  * @param  value: Raw value.
+  * @retval None
+  */
+
+void SAMPLE_STREAM(uint8_t channel, uint16_t value)
+{
+  SampleRecord record = { HAL_GetTick(), channel, 0, value };
+
+  RTT_WRITE_SHARED(RTT_SAMPLES, &record, sizeof(record));
+}
+
+
+/**
+  * @brief  Tunes the sample time of every channel and reports the result on the RTT terminal.
+  * @param  arg: NULL to measure each input on the ADC that samples it (PA1 on ADC1, PA2 on
+  *         ADC2) and commit the chosen times to the configuration, or a source resistance in
+  *         ohms to run the RC model instead (each channel's input at its current value;
+  *         nothing is committed).
+  * @retval 0 on success, -1 if a conversion failed or the configuration could not be edited.
+  * @note   ADC1 kicks from VREFINT, ADC2 from PA1. Both acquisition tasks wait on adcMutex
+  *         while it runs (about 50 ms at the 9 MHz ADC clock). A channel whose input sits too
+  *         close to its kick input keeps 480 cycles.
+  */
+
+int SAMPLE_TIME_TUNE(const char *arg)
+{
+  ADC_TUNE_Result result[CONFIG_CHANNELS];
+  ADC_TUNE_Model model;
+  CONFIG_Params *params;
+  char line[64];
+  int status[CONFIG_CHANNELS];
+
+  if (arg != NULL)
+  {
+    model.source_ohms = strtoul(arg, NULL, 10);
+    model.cap = 0.0f;
+    model.seed = HAL_GetTick();
+    for (uint8_t ch = 0; ch < CONFIG_CHANNELS; ch++)
+    {
+      model.input = adcInputs[ch];
+      model.level = channel_Registry.raw[ch];
+      if (adcKicks[ch] == ADC_TUNE_REFERENCE)
+        model.reference = (1210.0f * ADC_TUNE_FULL_SCALE) / 3300.0f; // VREFINT typical, 3.3 V supply
+      else
+        model.reference = channel_Registry.raw[CH_PA1];
+      status[ch] = ADC_TUNE_RUN(ADC_TUNE_MODEL_CONVERT, &model, adcInputs[ch], adcKicks[ch], &result[ch]);
+    }
+  }
+  else
+  {
+    RTOS_MUTEX_ACQUIRE(adcMutexHandle, osWaitForever);
+    ADC_TUNE_BEGIN(ADC1);
+    ADC_TUNE_BEGIN(ADC2);
+    status[CH_PA1] = ADC_TUNE_RUN(ADC_TUNE_ADC, ADC1, adcInputs[CH_PA1], adcKicks[CH_PA1], &result[CH_PA1]);
+    status[CH_PA2] = ADC_TUNE_RUN(ADC_TUNE_ADC, ADC2, adcInputs[CH_PA2], adcKicks[CH_PA2], &result[CH_PA2]);
+    ADC_TUNE_END(ADC2);
+    ADC_TUNE_END(ADC1);
+    RTOS_MUTEX_RELEASE(adcMutexHandle);
+  }
+
+  for (uint8_t ch = 0; ch < CONFIG_CHANNELS; ch++)
+  {
+    if (status[ch] == ADC_TUNE_ERROR)
+      return -1;
+    snprintf(line, sizeof(line), "%s: %lu cycles, %lu/s, swing %u%s\n", channel_Registry.name[ch],
+             (unsigned long) ADC_TUNE_CYCLES(result[ch].sample_time), (unsigned long) result[ch].rate_hz,
+             result[ch].swing, (status[ch] == ADC_TUNE_WEAK) ? " (weak)" : "");
+    RTT_WRITE_STRING(RTT_TERMINAL, line);
+  }
+  if (arg != NULL)
+    return 0;
+
+  params = CONFIG_EDIT();
+  if (params == NULL)
+    return -1;
+  for (uint8_t ch = 0; ch < CONFIG_CHANNELS; ch++)
+  {
+    params->sample_time[ch] = result[ch].sample_time;
+    TRACE_EVENT(TRACE_SAMPLE_TIME_TUNED, (uint16_t) ((ch << 8) | result[ch].sample_time));
+  }
+  return CONFIG_COMMIT();
+}
+
+
+/**
+  * @brief  Runs the fast-path benchmarks and prints one line per result on the RTT terminal.
+  * @param  None
+  * @retval None
+  * @note   Runs in the calling task, whose other services wait meanwhile. The benchmarks that
+  *         write text to the panel are left to Display_Task, which owns the LCD and reports
+  *         them on its next pass.
+  */
+
+void TERMINAL_BENCH(void)
+{
+  GRAPH_Bench graph;
+  SIMD16_Bench simd;
+  RTOS_FAST_Bench rtos;
+  uint32_t hw_rate, sw_rate, hal_cycles, ll_cycles;
+  char line[64];
+
+  CHECKSUM_BENCH(BENCH_CHECKSUM_BYTES, &hw_rate, &sw_rate);
+  snprintf(line, sizeof(line), "checksum: CRC unit %lu, table %lu B/s\n", (unsigned long) hw_rate,
+           (unsigned long) sw_rate);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+  GRAPH_BENCH(&graph);
+  snprintf(line, sizeof(line), "graph block: %lu, inline %lu cycles\n", (unsigned long) graph.graph_cycles,
+           (unsigned long) graph.hand_cycles);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+  SIMD16_BENCH(CHANNEL_MAX, &simd);
+  snprintf(line, sizeof(line), "simd16 %u packed/C: cal %lu/%lu, scale %lu/%lu\n", CHANNEL_MAX,
+           (unsigned long) simd.calibrate[0], (unsigned long) simd.calibrate[1], (unsigned long) simd.scale[0],
+           (unsigned long) simd.scale[1]);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+  snprintf(line, sizeof(line), "simd16 %u packed/C: dot %lu/%lu, minmax %lu/%lu\n", CHANNEL_MAX,
+           (unsigned long) simd.dot[0], (unsigned long) simd.dot[1], (unsigned long) simd.minmax[0],
+           (unsigned long) simd.minmax[1]);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+
+  // ADC1 off the grid trigger and its interrupt, as for a tuning run
+  RTOS_MUTEX_ACQUIRE(adcMutexHandle, osWaitForever);
+  ADC_TUNE_BEGIN(ADC1);
+  ADC_FAST_BENCH(&hadc1, &hal_cycles, &ll_cycles);
+  ADC_TUNE_END(ADC1);
+  RTOS_MUTEX_RELEASE(adcMutexHandle);
+  snprintf(line, sizeof(line), "adc sample: HAL %lu, LL %lu cycles\n", (unsigned long) hal_cycles,
+           (unsigned long) ll_cycles);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+#if LCD_TRANSPORT == LCD_TRANSPORT_I2C
+  LCD_I2C_BENCH(&hal_cycles, &ll_cycles);
+  snprintf(line, sizeof(line), "lcd i2c byte: HAL %lu, LL %lu cycles\n", (unsigned long) hal_cycles,
+           (unsigned long) ll_cycles);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+#endif
+
+  RTOS_FAST_BENCH(&rtos);
+  snprintf(line, sizeof(line), "rtos cmsis/shim: mutex %lu/%lu, sem %lu/%lu\n", (unsigned long) rtos.mutex[0],
+           (unsigned long) rtos.mutex[1], (unsigned long) rtos.semaphore[0], (unsigned long) rtos.semaphore[1]);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+  snprintf(line, sizeof(line), "rtos cmsis/shim: notify %lu/%lu, queue %lu/%lu\n", (unsigned long) rtos.notify[0],
+           (unsigned long) rtos.notify[1], (unsigned long) rtos.queue[0], (unsigned long) rtos.queue[1]);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+
+  lcdBenchPending = 1;
+}
+
+
+/**
+  * @brief  Prints the run-time counters of the services on the RTT terminal, one line each.
+  * @param  config: Configuration set of the calling stage; its pipeline stats nodes are read
+  *         and restarted, so each channel line covers the time since the last "stats".
+  * @retval None
+  */
+
+void TERMINAL_STATS(CONFIG_Set *config)
+{
+  EXPORT_Stats export;
+  GRAPH_Stats graph;
+  static const char *const i2c_clients[I2C_BUS_CLIENTS] = { "lcd", "sensor", "sync" };
+  SENSOR_Stats sensor;
+  I2C_BUS_Stats bus;
+  uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+  char line[64];
+
+  for (uint8_t ch = 0; ch < CONFIG_CHANNELS; ch++)
+  {
+    if (GRAPH_READ_STATS(&config->pipeline, config->stats[ch], &graph, 1) != 0)
+      continue;
+    snprintf(line, sizeof(line), "%s pipeline: min %u max %u mean %u (%lu)\n", channel_Registry.name[ch],
+             graph.min, graph.max, graph.mean, (unsigned long) graph.count);
+    RTT_WRITE_STRING(RTT_TERMINAL, line);
+  }
+
+  EXPORT_GET_STATS(&export);
+  snprintf(line, sizeof(line), "export: %lu sent, %lu dropped, ring peak %u/%u B\n",
+           (unsigned long) export.frames_sent, (unsigned long) export.frames_dropped, export.ring_peak,
+           EXPORT_RING_SIZE);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+  snprintf(line, sizeof(line), "history: %u B\n", (unsigned) HISTORY_FOOTPRINT);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+  for (int i = 0; SENSOR_READ_STATS(i, &sensor) == 0; i++)
+  {
+    snprintf(line, sizeof(line), "sensor %d: %lu reads, %lu errors, %lu coalesced\n", i,
+             (unsigned long) sensor.reads, (unsigned long) sensor.errors, (unsigned long) sensor.coalesced);
+    RTT_WRITE_STRING(RTT_TERMINAL, line);
+    snprintf(line, sizeof(line), "sensor %d: drdy latency min/avg/max %lu/%lu/%lu us\n", i,
+             (unsigned long) (sensor.latency_min / cycles_per_us), (unsigned long) (sensor.latency_avg / cycles_per_us),
+             (unsigned long) (sensor.latency_max / cycles_per_us));
+    RTT_WRITE_STRING(RTT_TERMINAL, line);
+  }
+  // Bus share per client: attempts per transaction and backoff time should stay comparable
+  for (uint8_t client = 0; client < I2C_BUS_CLIENTS; client++)
+  {
+    I2C_BUS_READ_STATS(client, &bus);
+    snprintf(line, sizeof(line), "i2c %s: %lu done, %lu attempts (max %lu)\n", i2c_clients[client],
+             (unsigned long) bus.transactions, (unsigned long) bus.attempts, (unsigned long) bus.max_attempts);
+    RTT_WRITE_STRING(RTT_TERMINAL, line);
+    snprintf(line, sizeof(line), "i2c %s: %lu lost, %lu busy, %lu failed, %lu us backoff\n", i2c_clients[client],
+             (unsigned long) bus.lost, (unsigned long) bus.busy, (unsigned long) bus.failed,
+             (unsigned long) bus.backoff_us);
+    RTT_WRITE_STRING(RTT_TERMINAL, line);
+  }
+}
+
+
+/**
+  * @brief  Prints min, max and mean of a channel over a recent window, and a sparkline of the
+  *         bucket means across it.
+  * @param  arg: "<channel> <seconds>", e.g. "0 3600" for the last hour of PA1.
+  * @retval 0 on success, -1 if the channel is invalid or holds no sample in the window.
+  * @note   The sparkline uses the finest level whose last HISTORY_TREND_WIDTH buckets cover
+  *         the window, scaled between the lowest and highest bucket mean shown.
+  */
+
+int HISTORY_REPORT(const char *arg)
+{
+  static const char ramp[] = HISTORY_TREND_RAMP;
+  HISTORY_Bucket buckets[HISTORY_TREND_WIDTH];
+  HISTORY_Summary summary;
+  char line[64], *end;
+  uint32_t window_ms;
+  uint16_t n, lo = 0xFFFF, hi = 0;
+  uint8_t ch, level = 0;
+
+  ch = (uint8_t) strtoul(arg, &end, 10);
+  window_ms = strtoul(end, NULL, 10) * 1000;
+  if ((ch >= HISTORY_CHANNELS) || (HISTORY_QUERY(ch, window_ms, &summary) != 0))
+    return -1;
+  snprintf(line, sizeof(line), "%s %lus: min %u max %u mean %u (%lu)\n", channel_Registry.name[ch],
+           (unsigned long) (summary.span_ms / 1000), summary.min, summary.max, summary.mean,
+           (unsigned long) summary.count);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+
+  while ((level < HISTORY_LEVELS - 1) && ((uint64_t) HISTORY_BUCKET_MS(level) * HISTORY_TREND_WIDTH < window_ms))
+    level++;
+  n = HISTORY_TREND(ch, level, buckets, HISTORY_TREND_WIDTH);
+  for (uint16_t i = 0; i < n; i++)
+  {
+    uint16_t mean = buckets[i].count ? buckets[i].sum / buckets[i].count : 0;
+    if (mean < lo)
+      lo = mean;
+    if (mean > hi)
+      hi = mean;
+  }
+  for (uint16_t i = 0; i < n; i++)
+  {
+    uint16_t mean = buckets[i].count ? buckets[i].sum / buckets[i].count : 0;
+    line[i] = ramp[(hi > lo) ? ((uint32_t) (mean - lo) * (sizeof(ramp) - 2)) / (hi - lo) : 0];
+  }
+  snprintf(line + n, sizeof(line) - n, "| %lus/char\n", (unsigned long) (HISTORY_BUCKET_MS(level) / 1000));
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+  return 0;
+}
+
+
+/**
+  * @brief  Prints a channel's logged samples over a recent window, as LOG_QUERY_POINTS
+  *         min/max/mean points, and the work the query engine did for them.
+  * @param  arg: "<channel> <seconds>", e.g. "1 86400" for the last day of PA2.
+  * @retval 0 on success, -1 on bad arguments.
+  * @note   Runs in the default task, the only one that writes the log.
+  */
+
+int SAMPLE_LOG_REPORT(const char *arg)
+{
+  SAMPLE_LOG_Point points[LOG_QUERY_POINTS];
+  SAMPLE_LOG_QueryStats stats;
+  char line[64], *end;
+  uint32_t now = SAMPLE_LOG_NOW(), window_ms, t1;
+  uint8_t ch;
+  int found;
+
+  ch = (uint8_t) strtoul(arg, &end, 10);
+  window_ms = strtoul(end, NULL, 10) * 1000;
+  if ((ch >= SAMPLE_LOG_CHANNELS) || (window_ms == 0))
+    return -1;
+  t1 = (window_ms < now) ? now - window_ms : 0;
+  found = SAMPLE_LOG_QUERY(ch, t1, now, points, LOG_QUERY_POINTS, &stats);
+  if (found < 0)
+    return -1;
+
+  for (uint8_t i = 0; i < LOG_QUERY_POINTS; i++)
+  {
+    if (points[i].count)
+      snprintf(line, sizeof(line), "%u: min %u max %u mean %u (%lu)\n", i, points[i].min, points[i].max,
+               points[i].mean, (unsigned long) points[i].count);
+    else
+      snprintf(line, sizeof(line), "%u: -\n", i);
+    RTT_WRITE_STRING(RTT_TERMINAL, line);
+  }
+  snprintf(line, sizeof(line), "%d samples, %lu summarized, %lu decoded, %lu cycles\n", found,
+           (unsigned long) stats.blocks_summarized, (unsigned long) stats.blocks_decoded,
+           (unsigned long) stats.cycles);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+  return 0;
+}
+
+
+/**
+  * @brief  Runs the benchmarks that write text to the panel and prints their results.
+  * @param  None
+  * @retval None
+  * @note   Display_Task only: the panel shows the bench text until the next page redraw.
+  */
+
+void LCD_BENCH_REPORT(void)
+{
+#if LCD_CPP_DRIVER
+  uint32_t c_cycles, cpp_cycles;
+  char line[48];
+
+  LCD_CPP_BENCH(&c_cycles, &cpp_cycles);
+  snprintf(line, sizeof(line), "lcd char: C %lu, C++ %lu cycles\n", (unsigned long) c_cycles,
+           (unsigned long) cpp_cycles);
+  RTT_WRITE_STRING(RTT_TERMINAL, line);
+#else
+  RTT_WRITE_STRING(RTT_TERMINAL, "lcd char: C++ driver not built\n");
+#endif
+}
+
+
+/**
+  * @brief  Runs the commands typed into the RTT terminal, one per line:
+  *         "time" prints the Unix time, "time <seconds>" sets it,
+  *         "tune" tunes the ADC sample times, "tune <ohms>" runs the tuning on the RC model,
+  *         "stack" prints the stack each task has never used (uxTaskGetStackHighWaterMark),
+  *         "bench" runs the fast-path benchmarks (TERMINAL_BENCH),
+  *         "stats" prints the service counters (TERMINAL_STATS),
+  *         "hist <channel> <seconds>" prints the history of a channel (HISTORY_REPORT),
+  *         "log <channel> <seconds>" queries the flash sample log (SAMPLE_LOG_REPORT).
+  * @param  config: Configuration set of the calling stage (for "stats").
+  * @retval None
+  */
+
+void TERMINAL_SERVICE(CONFIG_Set *config)
+{
+  static char cmd[TERMINAL_LINE_MAX];
+  static uint8_t len;
+  char c, reply[40];
+
+  while (RTT_READ(RTT_TERMINAL, &c, 1) == 1)
+  {
+    if ((c != '\n') && (c != '\r'))
+    {
+      if (len < sizeof(cmd) - 1)
+        cmd[len++] = c;
+      continue;
+    }
+    if (len == 0)
+      continue;
+    cmd[len] = 0;
+    len = 0;
+
+    if (strcmp(cmd, "time") == 0)
+    {
+      TIME_Mono mono;
+      TIME_MONO_NOW(&mono);
+      snprintf(reply, sizeof(reply), "%lu\n", (unsigned long) (TIME_TO_WALL_US(&mono) / 1000000));
+    }
+    else if (strncmp(cmd, "time ", 5) == 0)
+    {
+      snprintf(reply, sizeof(reply), "%s\n", (TIME_SET(strtoul(cmd + 5, NULL, 10)) == 0) ? "ok" : "error");
+    }
+    else if (strcmp(cmd, "stack") == 0)
+    {
+      snprintf(reply, sizeof(reply), "free %lu/%lu/%lu/%lu B\n",
+               (unsigned long) osThreadGetStackSpace(defaultTaskHandle), (unsigned long) osThreadGetStackSpace(ADC1TaskHandle),
+               (unsigned long) osThreadGetStackSpace(ADC2TaskHandle), (unsigned long) osThreadGetStackSpace(DisplayTaskHandle));
+    }
+    else if ((strcmp(cmd, "tune") == 0) || (strncmp(cmd, "tune ", 5) == 0))
+    {
+      snprintf(reply, sizeof(reply), "%s\n", (SAMPLE_TIME_TUNE((cmd[4] == ' ') ? cmd + 5 : NULL) == 0) ? "ok" : "error");
+    }
+    else if (strcmp(cmd, "stats") == 0)
+    {
+      TERMINAL_STATS(config);
+      snprintf(reply, sizeof(reply), "ok\n");
+    }
+    else if (strncmp(cmd, "hist ", 5) == 0)
+    {
+      snprintf(reply, sizeof(reply), "%s\n", (HISTORY_REPORT(cmd + 5) == 0) ? "ok" : "error");
+    }
+    else if (strncmp(cmd, "log ", 4) == 0)
+    {
+      snprintf(reply, sizeof(reply), "%s\n", (SAMPLE_LOG_REPORT(cmd + 4) == 0) ? "ok" : "error");
+    }
+    else if (strcmp(cmd, "bench") == 0)
+    {
+      TERMINAL_BENCH();
+      snprintf(reply, sizeof(reply), "ok\n");
+    }
+    else
+    {
+      snprintf(reply, sizeof(reply), "unknown: %s\n", cmd);
+    }
+    RTT_WRITE_STRING(RTT_TERMINAL, reply);
+  }
+}
+
+
+/* Display Task - renders the selected page, redrawing early when an input event arrives */
 void Display_Task(void *argument)
 {
   const uint32_t mydelay = 200;
+  uint8_t page = PAGE_CHANNELS;
 
   for(;;)
   {
-    // Display PA1 value on first row
-    LCD_SET_CURSOR(0, 0);
-    uint16_t percent1 = (readValue1 * 100) / 1023;
-    snprintf(lcd_buffer1, sizeof(lcd_buffer1), "PA1 : %3u%%", percent1);
-    LCD_SEND_STRING(lcd_buffer1);
-    // Display PA2 value on second row
-    LCD_SET_CURSOR(1, 0);
-    uint16_t percent2 = (readValue2 * 100) / 1023;
-    snprintf(lcd_buffer2, sizeof(lcd_buffer2), "PA2 : %3u%%", percent2);
-    LCD_SEND_STRING(lcd_buffer2);
-    osDelay(mydelay);
+    char line[20];
+
+    if (lcdBenchPending)
+    {
+      lcdBenchPending = 0;
+      LCD_BENCH_REPORT();
+    }
+
+    if (page == PAGE_CHANNELS)
+    {
+      // Consistent set of values from the last processing pass, read without locking
+      CHANNEL_Snapshot snap;
+      CHANNEL_READ_SNAPSHOT(&snap);
+
+      // Percent of full scale for all channels at once, two per load/store (100/1023 in Q16)
+      int16_t percent[CHANNEL_SNAPSHOT_MAX];
+      SIMD16_SCALE(percent, (const int16_t *) snap.raw, 6406, 16, snap.count);
+
+      // One channel per row (only changed characters go on the bus)
+      for (uint8_t ch = 0; (ch < LCD_ROWS) && (ch < snap.count); ch++)
+      {
+        snprintf(line, sizeof(line), "%s : %3u%%", channel_Registry.name[ch], (unsigned) percent[ch]);
+        LCD_WRITE_ROW(ch, line);
+      }
+    }
+    else if (page == PAGE_PULSE)
+    {
+      PULSE_Result pulse;
+      PULSE_READ(&pulse);
+      snprintf(line, sizeof(line), "F %lu.%03luHz", (unsigned long) (pulse.count_freq_mhz / 1000),
+               (unsigned long) (pulse.count_freq_mhz % 1000));
+      LCD_WRITE_ROW(0, line);
+      snprintf(line, sizeof(line), "D %u.%u%%", pulse.duty_permille / 10, pulse.duty_permille % 10);
+      LCD_WRITE_ROW(1, line);
+    }
+    else if (page == PAGE_SYNC)
+    {
+      SYNC_Stats sync;
+      SYNC_READ_STATS(&sync);
+      snprintf(line, sizeof(line), "Sync %lu #%u", (unsigned long) sync.syncs, sync.sequence);
+      LCD_WRITE_ROW(0, line);
+      snprintf(line, sizeof(line), "Skew %ld/%luus", (long) sync.skew_us, (unsigned long) sync.skew_max_us);
+      LCD_WRITE_ROW(1, line);
+    }
+    else if (page == PAGE_CLOCK)
+    {
+      // Wall clock from the last correlation, without touching the RTC
+      TIME_Mono mono;
+      TIME_Civil civil;
+      TIME_Stats rtc;
+      TIME_MONO_NOW(&mono);
+      TIME_CIVIL((uint32_t) (TIME_TO_WALL_US(&mono) / 1000000), &civil);
+      TIME_READ_STATS(&rtc);
+      snprintf(line, sizeof(line), "%04u-%02u-%02u %s", civil.year, civil.month, civil.day,
+               (rtc.source == TIME_RTC_LSE) ? "LSE" : "LSI");
+      LCD_WRITE_ROW(0, line);
+      snprintf(line, sizeof(line), "%02u:%02u:%02u %ldppm", civil.hour, civil.minute, civil.second,
+               (long) (rtc.skew_ppb / 1000));
+      LCD_WRITE_ROW(1, line);
+    }
+    else
+    {
+      snprintf(line, sizeof(line), "Config %lu", (unsigned long) CONFIG_EPOCH());
+      LCD_WRITE_ROW(0, line);
+      snprintf(line, sizeof(line), "Up %lus #%lu", (unsigned long) (HAL_GetTick() / 1000),
+               (unsigned long) stateCounters.boots);
+      LCD_WRITE_ROW(1, line);
+    }
+
+    // Sleeps until the refresh is due or the operator turns the encoder / presses a button;
+    // ignored events only use up what is left of the refresh period
+    INPUT_Event event;
+    uint32_t deadline = osKernelGetTickCount() + mydelay;
+    uint32_t left = mydelay;
+    while (INPUT_WAIT(&event, left) == 0)
+    {
+      if (event.type == INPUT_ROTATE)
+      {
+        page = (uint8_t) ((page + PAGE_COUNT + (event.value % PAGE_COUNT)) % PAGE_COUNT);
+        break;
+      }
+      if ((event.type == INPUT_PRESS) && (event.button == 0))
+      {
+        page = (uint8_t) ((page + 1) % PAGE_COUNT);
+        break;
+      }
+      left = deadline - osKernelGetTickCount();
+      if ((int32_t) left <= 0)
+        break;
+    }
   }
 }
 /* USER CODE END 0 */
@@ -207,7 +987,24 @@ int main(void)
   MX_I2C2_Init();
   MX_TIM6_Init();
   /* USER CODE BEGIN 2 */
+  DWT_DELAY_INIT();                                     // Once: the cycle counter is shared
+  RTT_INIT();
   LCD_INIT();
+#if ADC_FAST_PATH
+  ADC_FAST_INIT(&hadc1);
+  ADC_FAST_INIT(&hadc2);
+#endif
+  SYNC_INIT();
+  CHANNEL_INIT();
+  CHANNEL_REGISTER("PA1", configDefaults.gain[CH_PA1], configDefaults.offset[CH_PA1], configDefaults.limit[CH_PA1]);
+  CHANNEL_REGISTER("PA2", configDefaults.gain[CH_PA2], configDefaults.offset[CH_PA2], configDefaults.limit[CH_PA2]);
+  CHANNEL_REGISTER("EXT", CHANNEL_GAIN_ONE, 0, 0xFFFF);
+  CONFIG_INIT(&configDefaults, PIPELINE_BUILD);
+  EXPORT_INIT();
+  HISTORY_INIT();
+  PULSE_INIT();
+  TIME_INIT();
+  MODBUS_INIT();
   /* USER CODE END 2 */
 
   /* Init scheduler */
@@ -218,6 +1015,9 @@ int main(void)
 
   /* USER CODE BEGIN RTOS_MUTEX */
   /* add mutexes, ... */
+  CHECKSUM_INIT();
+  STATE_RESTORE();
+  SAMPLE_LOG_INIT();
   /* USER CODE END RTOS_MUTEX */
 
   /* USER CODE BEGIN RTOS_SEMAPHORES */
@@ -229,6 +1029,10 @@ int main(void)
   /* USER CODE END RTOS_TIMERS */
 
   /* USER CODE BEGIN RTOS_QUEUES */
+  INPUT_INIT();
+  I2C_BUS_INIT();
+  SENSOR_INIT();
+  SENSOR_REGISTER(EXT_ADC_ADDRESS, EXT_ADC_RESULT_REG, GPIO_PIN_0, CH_EXT);
   /* add queues, ... */
   /* USER CODE END RTOS_QUEUES */
 
@@ -511,6 +1315,17 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
+/**
+  * @brief  EXTI line detection callback (buttons and encoder A, see INPUT.h; sensor
+  *         data-ready lines, see SENSOR.h).
+  * @param  GPIO_Pin: The pin whose line fired.
+  * @retval None
+  */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  INPUT_EXTI_CALLBACK(GPIO_Pin);
+  SENSOR_EXTI_CALLBACK(GPIO_Pin);
+}
 
 /* USER CODE END 4 */
 
@@ -524,10 +1339,36 @@ static void MX_GPIO_Init(void)
 void StartDefaultTask(void *argument)
 {
   /* USER CODE BEGIN 5 */
+  uint32_t applied = 0;
+  TIME_Map map;
+
   /* Infinite loop */
   for(;;)
   {
-    osDelay(1);
+    // Pass boundary: apply the calibration of a newly committed configuration
+    CONFIG_Set *config = CONFIG_ENTER(CONFIG_STAGE_PROCESS);
+    if (config->epoch != applied)
+    {
+      for (uint8_t ch = 0; ch < CONFIG_CHANNELS; ch++)
+        CHANNEL_CONFIGURE(ch, config->params.gain[ch], config->params.offset[ch], config->params.limit[ch]);
+      applied = config->epoch;
+      TRACE_EVENT(TRACE_CONFIG_APPLIED, (uint16_t) applied);
+    }
+    CHANNEL_PROCESS();
+    MODBUS_SERVICE(&config->params);
+    PULSE_SERVICE(HAL_GetTick());
+    SYNC_SERVICE(HAL_GetTick());
+    if (TIME_SERVICE(HAL_GetTick()))
+    {
+      // New tick to wall-clock mapping: the exported sample blocks carry ticks only
+      TIME_READ_MAP(&map);
+      EXPORT_PUSH_TIME(map.base_mono.ms, map.base_mono.us, map.base_wall_us, map.skew_q32);
+      TRACE_EVENT(TRACE_TIME_CORRELATED, (uint16_t) map.sequence);
+    }
+    STATE_SAVE(HAL_GetTick(), config);
+    TERMINAL_SERVICE(config);
+    SAMPLE_LOG_SERVICE();
+    RTOS_DELAY(10);
   }
   /* USER CODE END 5 */
 }
@@ -22,6 +22,12 @@
 #include "stm32f4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "EXPORT.h"
+#include "CHECKSUM.h"
+#include "INPUT.h"
+#include "SENSOR.h"
+#include "SYNC.h"
+#include "MODBUS.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -175,4 +181,108 @@ void TIM2_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA1 stream3 global interrupt (USART3 TX, sample exporter).
+  */
+void DMA1_Stream3_IRQHandler(void)
+{
+  EXPORT_DMA_IRQHandler();
+}
+
+/**
+  * @brief This function handles DMA2 stream0 global interrupt (CRC unit feed).
+  */
+void DMA2_Stream0_IRQHandler(void)
+{
+  CHECKSUM_DMA_IRQHandler();
+}
+
+/**
+  * @brief This function handles EXTI line0 interrupt (sensor data-ready).
+  */
+void EXTI0_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_0);
+}
+
+/**
+  * @brief This function handles EXTI line1 interrupt (sensor data-ready).
+  */
+void EXTI1_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_1);
+}
+
+/**
+  * @brief This function handles EXTI line2 interrupt (button 0).
+  */
+void EXTI2_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_2);
+}
+
+/**
+  * @brief This function handles EXTI line3 interrupt (button 1).
+  */
+void EXTI3_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_3);
+}
+
+/**
+  * @brief This function handles EXTI line4 interrupt (button 2).
+  */
+void EXTI4_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_4);
+}
+
+/**
+  * @brief This function handles EXTI line[15:10] interrupts (encoder A).
+  */
+void EXTI15_10_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_12);
+}
+
+/**
+  * @brief This function handles TIM7 global interrupt (input debounce).
+  */
+void TIM7_IRQHandler(void)
+{
+  INPUT_TIMER_IRQHandler();
+}
+
+/**
+  * @brief This function handles I2C2 event interrupt (general-call sync reception).
+  */
+void I2C2_EV_IRQHandler(void)
+{
+  SYNC_I2C_EV_IRQHandler();
+}
+
+/**
+  * @brief This function handles TIM8 capture compare interrupt (tick lock onto the sampling grid).
+  */
+void TIM8_CC_IRQHandler(void)
+{
+  SYNC_TIMER_IRQHandler();
+}
+
+/**
+  * @brief This function handles ADC1/ADC2 global interrupt (grid-triggered conversions).
+  */
+void ADC_IRQHandler(void)
+{
+  SYNC_ADC_IRQHandler();
+}
+
+/**
+  * @brief This function handles USART6 global interrupt (Modbus RTU slave).
+  */
+void USART6_IRQHandler(void)
+{
+  MODBUS_IRQHandler();
+}
+
 /* USER CODE END 1 */
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""Host receiver for the firmware sample exporter (Core/Src/EXPORT.c).
+
+Frames arrive as COBS(payload) 0x00, where payload is
+  type(1) seq(1) channel(1) count(1) tick(u32 LE) samples(count x u16 LE) crc16(LE)
+and the CRC-16/CCITT-FALSE covers everything before it. Time frames (type 2, channel and
+count 0) carry us(u16) wall_us(i64) skew_q32(i32) after the tick and map later ticks to
+Unix time: wall = wall_us + d + (d * skew_q32 >> 32), d = microseconds since tick/us.
+
+    export_rx.py /dev/ttyUSB0 --baud 921600 --csv samples.csv
+    export_rx.py capture.bin --bin samples.bin
+"""
+
+import argparse
+import os
+import struct
+import sys
+import termios
+import time
+
+FRAME_SAMPLE_BLOCK = 0x01
+FRAME_TIME = 0x02
+HEADER = struct.Struct("<BBBBI")
+TIME = struct.Struct("<Hqi")
+
+BAUD_CONSTANTS = {
+    115200: termios.B115200,
+    230400: termios.B230400,
+    460800: getattr(termios, "B460800", None),
+    921600: getattr(termios, "B921600", None),
+}
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS code")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def to_wall_us(mapping, tick):
+    base_tick, base_us, wall_us, skew = mapping
+    d = ((tick - base_tick + 0x80000000) % 0x100000000 - 0x80000000) * 1000 - base_us
+    return wall_us + d + ((d * skew) >> 32)
+
+
+def open_input(path, baud):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        attrs = termios.tcgetattr(fd)
+        attrs[0] = 0                                     # iflag: raw
+        attrs[1] = 0                                     # oflag
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attrs[3] = 0                                     # lflag: no echo, no canonical mode
+        speed = BAUD_CONSTANTS.get(baud)
+        if speed is not None:
+            attrs[4] = attrs[5] = speed
+        attrs[6][termios.VMIN] = 1
+        attrs[6][termios.VTIME] = 0
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="serial device, pty or capture file")
+    parser.add_argument("--baud", type=int, default=921600)
+    parser.add_argument("--csv", help="write tick,seq,channel,index,value,wall_us rows")
+    parser.add_argument("--bin", help="write raw little-endian u16 samples")
+    parser.add_argument("--frames", type=int, default=0, help="stop after N good frames")
+    args = parser.parse_args()
+
+    fd = open_input(args.input, args.baud)
+    csv = open(args.csv, "w") if args.csv else None
+    binary = open(args.bin, "wb") if args.bin else None
+    if csv:
+        csv.write("tick,seq,channel,index,value,wall_us\n")
+
+    good = crc_errors = cobs_errors = lost = total_bytes = 0
+    last_seq = None
+    mapping = None
+    pending = bytearray()
+    start = time.monotonic()
+
+    try:
+        while not args.frames or good < args.frames:
+            chunk = os.read(fd, 4096)
+            if not chunk:
+                break
+            total_bytes += len(chunk)
+            pending += chunk
+            while True:
+                end = pending.find(0)
+                if end < 0:
+                    break
+                encoded = bytes(pending[:end])
+                del pending[:end + 1]
+                if not encoded:
+                    continue
+                try:
+                    payload = cobs_decode(encoded)
+                except ValueError:
+                    cobs_errors += 1
+                    continue
+                if len(payload) < HEADER.size + 2 or crc16(payload[:-2]) != struct.unpack("<H", payload[-2:])[0]:
+                    crc_errors += 1
+                    continue
+                ftype, seq, channel, count, tick = HEADER.unpack_from(payload)
+                if ftype == FRAME_TIME and len(payload) == HEADER.size + TIME.size + 2:
+                    mapping = (tick,) + TIME.unpack_from(payload, HEADER.size)
+                elif ftype != FRAME_SAMPLE_BLOCK or len(payload) != HEADER.size + 2 * count + 2:
+                    crc_errors += 1
+                    continue
+                if last_seq is not None:
+                    lost += (seq - last_seq - 1) & 0xFF
+                last_seq = seq
+                if ftype == FRAME_TIME:
+                    continue
+                samples = struct.unpack_from("<%dH" % count, payload, HEADER.size)
+                if csv:
+                    wall = "%d" % to_wall_us(mapping, tick) if mapping else ""
+                    for index, value in enumerate(samples):
+                        csv.write("%u,%u,%u,%u,%u,%s\n" % (tick, seq, channel, index, value, wall))
+                if binary:
+                    binary.write(payload[HEADER.size:HEADER.size + 2 * count])
+                good += 1
+    except KeyboardInterrupt:
+        pass
+    finally:
+        elapsed = max(time.monotonic() - start, 1e-9)
+        sys.stderr.write("frames %u, lost %u, crc errors %u, cobs errors %u, %.0f bytes/s\n"
+                         % (good, lost, crc_errors, cobs_errors, total_bytes / elapsed))
+        if csv:
+            csv.close()
+        if binary:
+            binary.close()
+
+
+if __name__ == "__main__":
+    main()
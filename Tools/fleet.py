@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Runs many instances of a host-simulated board at once and aggregates their metrics.
+
+Each instance is started as its own process with
+  FLEET_INSTANCE   index of the instance (0..N-1)
+  FLEET_INSTANCES  N
+  FLEET_BUS        path of the shared virtual bus (only with --bus)
+in its environment. Lines of the form
+  METRIC <name> <value>
+on an instance's stdout are collected; every other line goes to its log (--log-dir).
+
+The virtual bus is a Unix datagram socket served by the harness: every datagram an instance
+sends to it is delivered to all other instances that have sent at least one datagram (their
+socket address is learned from the first one), so N boards see one shared medium. A frame
+for an instance whose receive queue is full is dropped and counted, not waited for.
+
+    fleet.py -n 200 --bus --json fleet.json -- ./board_sim --seconds 60
+"""
+
+import argparse
+import json
+import os
+import select
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+
+class VirtualBus(threading.Thread):
+    """Relays every datagram to all other members."""
+
+    def __init__(self, path):
+        super().__init__(daemon=True)
+        self.path = path
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+        self.sock.bind(path)
+        self.members = []
+        self.peak_members = 0
+        self.frames = self.deliveries = self.drops = 0
+        self.running = True
+
+    def run(self):
+        while self.running:
+            ready, _, _ = select.select([self.sock], [], [], 0.2)
+            if not ready:
+                continue
+            data, sender = self.sock.recvfrom(65536)
+            if not sender:
+                continue                                 # unbound sender cannot be answered
+            if sender not in self.members:
+                self.members.append(sender)
+                self.peak_members = max(self.peak_members, len(self.members))
+            self.frames += 1
+            for member in list(self.members):
+                if member == sender:
+                    continue
+                try:
+                    # Never block the whole bus on one slow reader: a full queue drops the frame
+                    self.sock.sendto(data, socket.MSG_DONTWAIT, member)
+                    self.deliveries += 1
+                except BlockingIOError:
+                    self.drops += 1
+                except OSError:
+                    self.members.remove(member)          # instance has exited
+
+    def stop(self):
+        self.running = False
+        self.join()
+        self.sock.close()
+        os.unlink(self.path)
+
+
+class Instance:
+    def __init__(self, index, count, command, bus_path, log_dir):
+        self.index = index
+        self.metrics = {}
+        self.exit_code = None
+        self.rusage = None
+        self.elapsed = 0.0
+        env = dict(os.environ, FLEET_INSTANCE=str(index), FLEET_INSTANCES=str(count))
+        if bus_path:
+            env["FLEET_BUS"] = bus_path
+        self.log = open(os.path.join(log_dir, "board%04u.log" % index), "w") if log_dir else None
+        self.start = time.monotonic()
+        self.proc = subprocess.Popen(command, env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                     universal_newlines=True, bufsize=1)
+        self.reader = threading.Thread(target=self.read, daemon=True)
+        self.reader.start()
+
+    def read(self):
+        for line in self.proc.stdout:
+            fields = line.split()
+            if len(fields) == 3 and fields[0] == "METRIC":
+                try:
+                    self.metrics.setdefault(fields[1], []).append(float(fields[2]))
+                    continue
+                except ValueError:
+                    pass
+            if self.log:
+                self.log.write(line)
+
+    def wait(self, deadline):
+        # wait4 instead of Popen.wait: the per-child rusage gives peak RSS and CPU time
+        while True:
+            pid, status, rusage = os.wait4(self.proc.pid, os.WNOHANG)
+            if pid:
+                break
+            if deadline and time.monotonic() > deadline:
+                self.proc.kill()
+                deadline = None
+            time.sleep(0.05)
+        self.elapsed = time.monotonic() - self.start
+        self.proc.returncode = self.exit_code = os.waitstatus_to_exitcode(status)
+        self.rusage = rusage
+        self.reader.join()
+        if self.log:
+            self.log.close()
+
+
+def percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def summarize(instances, bus):
+    metrics = {}
+    for inst in instances:
+        for name, values in inst.metrics.items():
+            metrics.setdefault(name, []).extend(values)
+    rss = [inst.rusage.ru_maxrss for inst in instances]
+    cpu = [inst.rusage.ru_utime + inst.rusage.ru_stime for inst in instances]
+    summary = {
+        "instances": len(instances),
+        "failed": [inst.index for inst in instances if inst.exit_code != 0],
+        "max_rss_kb": {"min": min(rss), "mean": sum(rss) / len(rss), "max": max(rss)},
+        "cpu_s": {"min": min(cpu), "mean": sum(cpu) / len(cpu), "max": max(cpu)},
+        "wall_s": max(inst.elapsed for inst in instances),
+        "metrics": {},
+    }
+    for name, values in sorted(metrics.items()):
+        summary["metrics"][name] = {
+            "count": len(values), "min": min(values), "mean": sum(values) / len(values),
+            "p99": percentile(values, 0.99), "max": max(values),
+        }
+    if bus:
+        summary["bus"] = {"members": bus.peak_members, "frames": bus.frames,
+                          "deliveries": bus.deliveries, "drops": bus.drops}
+    return summary
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-n", "--instances", type=int, default=100)
+    parser.add_argument("--jobs", type=int, default=0, help="max instances running at once (default: all)")
+    parser.add_argument("--bus", action="store_true", help="connect the instances to one virtual bus")
+    parser.add_argument("--timeout", type=float, default=0, help="kill instances still running after S seconds")
+    parser.add_argument("--log-dir", help="write each instance's non-metric output to board<N>.log")
+    parser.add_argument("--json", help="write the summary as JSON")
+    parser.add_argument("command", nargs=argparse.REMAINDER, help="board command (after --)")
+    args = parser.parse_args()
+
+    command = args.command[1:] if args.command[:1] == ["--"] else args.command
+    if not command or args.instances < 1:
+        parser.error("need a command and at least one instance")
+    if args.log_dir:
+        os.makedirs(args.log_dir, exist_ok=True)
+
+    bus = None
+    if args.bus:
+        bus = VirtualBus(os.path.join(tempfile.mkdtemp(prefix="fleet"), "bus"))
+        bus.start()
+
+    jobs = args.jobs or args.instances
+    running, done = [], []
+    next_index = 0
+    try:
+        while next_index < args.instances or running:
+            while next_index < args.instances and len(running) < jobs:
+                running.append(Instance(next_index, args.instances, command, bus and bus.path, args.log_dir))
+                next_index += 1
+            # Oldest first: with --jobs the slots free up roughly in start order
+            inst = running.pop(0)
+            inst.wait(inst.start + args.timeout if args.timeout else None)
+            done.append(inst)
+    except KeyboardInterrupt:
+        for inst in running:
+            inst.proc.kill()
+            inst.wait(None)
+            done.append(inst)
+    finally:
+        if bus:
+            bus.stop()
+            os.rmdir(os.path.dirname(bus.path))
+
+    summary = summarize(done, bus)
+    if args.json:
+        with open(args.json, "w") as out:
+            json.dump(summary, out, indent=2)
+
+    sys.stderr.write("%u instances, %u failed, wall %.1f s, peak RSS %u kB, CPU %.2f s mean\n"
+                     % (summary["instances"], len(summary["failed"]), summary["wall_s"],
+                        summary["max_rss_kb"]["max"], summary["cpu_s"]["mean"]))
+    for name, m in summary["metrics"].items():
+        sys.stderr.write("  %-24s n=%-7u min %-10.4g mean %-10.4g p99 %-10.4g max %.4g\n"
+                         % (name, m["count"], m["min"], m["mean"], m["p99"], m["max"]))
+    if bus:
+        sys.stderr.write("  bus: %(members)u members, %(frames)u frames, %(deliveries)u deliveries, %(drops)u drops\n"
+                         % summary["bus"])
+    return 1 if summary["failed"] else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""Minimal Modbus RTU master for exercising the firmware slave (Core/Src/MODBUS.c).
+
+Polls a register range and reports response latency (request sent to last response byte
+received) and throughput; can also write holding registers. Works on a serial adapter or on
+a pty bridged to a simulated board.
+
+    modbus_master.py /dev/ttyUSB0 --read input:0:40 --count 1000
+    modbus_master.py /dev/ttyUSB0 --write 0=50          # period_ms of channel 0
+    modbus_master.py /dev/ttyUSB0 --set-time
+"""
+
+import argparse
+import os
+import select
+import struct
+import termios
+import time
+
+BAUD_CONSTANTS = {9600: termios.B9600, 19200: termios.B19200, 38400: termios.B38400,
+                  57600: termios.B57600, 115200: termios.B115200}
+HR_TIME = 10
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def frame(pdu):
+    return pdu + struct.pack("<H", crc16(pdu))
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(fd):
+        attrs = termios.tcgetattr(fd)
+        attrs[0] = 0
+        attrs[1] = 0
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL | termios.PARENB   # 8E1
+        attrs[3] = 0
+        attrs[4] = attrs[5] = BAUD_CONSTANTS[baud]
+        attrs[6][termios.VMIN] = 0
+        attrs[6][termios.VTIME] = 0
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+def transact(fd, request, expected, timeout):
+    """Sends one request; returns (response, seconds) or (None, seconds) on timeout / error."""
+    start = time.monotonic()
+    os.write(fd, request)
+    response = b""
+    while True:
+        need = 5 if len(response) >= 2 and response[1] & 0x80 else expected
+        if len(response) >= need:
+            break
+        left = timeout - (time.monotonic() - start)
+        if left <= 0 or not select.select([fd], [], [], left)[0]:
+            return None, time.monotonic() - start
+        response += os.read(fd, 256)
+    elapsed = time.monotonic() - start
+    if crc16(response[:-2]) != struct.unpack("<H", response[-2:])[0]:
+        return None, elapsed
+    return response, elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port")
+    parser.add_argument("--baud", type=int, default=19200)
+    parser.add_argument("--slave", type=int, default=1)
+    parser.add_argument("--read", help="input|holding:START:COUNT (default input:0:16 without writes)")
+    parser.add_argument("--count", type=int, default=1, help="read requests to send")
+    parser.add_argument("--write", action="append", default=[], help="REG=VALUE holding register")
+    parser.add_argument("--set-time", action="store_true", help="write the host clock")
+    parser.add_argument("--timeout", type=float, default=0.5)
+    args = parser.parse_args()
+
+    fd = open_port(args.port, args.baud)
+    writes = [tuple(int(v, 0) for v in w.split("=")) for w in args.write]
+    if args.set_time:
+        now = int(time.time())
+        writes += [(HR_TIME, now >> 16), (HR_TIME + 1, now & 0xFFFF)]
+    for reg, value in sorted(writes):
+        response, _ = transact(fd, frame(struct.pack(">BBHH", args.slave, 0x06, reg, value)), 8, args.timeout)
+        print("write %u=%u: %s" % (reg, value, "ok" if response and not response[1] & 0x80 else
+                                   "exception %u" % response[2] if response else "no response"))
+    if writes and not args.read:
+        return
+
+    kind, start, count = (args.read or "input:0:16").split(":")
+    function = 0x04 if kind == "input" else 0x03
+    request = frame(struct.pack(">BBHH", args.slave, function, int(start), int(count)))
+    latencies = []
+    failures = 0
+    values = None
+    began = time.monotonic()
+    for _ in range(args.count):
+        response, elapsed = transact(fd, request, 5 + 2 * int(count), args.timeout)
+        if response is None or response[1] & 0x80:
+            failures += 1
+            continue
+        latencies.append(elapsed)
+        values = struct.unpack(">%dH" % int(count), response[3:-2])
+    total = time.monotonic() - began
+
+    if values is not None:
+        print("registers %s: %s" % (start, " ".join(str(v) for v in values)))
+    if latencies:
+        latencies.sort()
+        print("%u ok, %u failed, %.1f requests/s, latency min %.2f ms, median %.2f ms, max %.2f ms"
+              % (len(latencies), failures, len(latencies) / total, latencies[0] * 1e3,
+                 latencies[len(latencies) // 2] * 1e3, latencies[-1] * 1e3))
+    else:
+        print("no valid response (%u failed)" % failures)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Drains the firmware RTT channels (Core/Src/RTT.c) while the target keeps running.
+
+Memory is read through one of
+  --openocd HOST:PORT  the OpenOCD Tcl server (read_memory / write_memory, port 6666)
+  --pid PID            /proc/PID/mem of a host-simulated board (64-bit pointers)
+and the control block is found by scanning RAM for the "SEGGER RTT" ID unless --address
+gives it (e.g. the _SEGGER_RTT symbol from the ELF).
+
+Up channel 0 (terminal) goes to stdout. Channel 1 holds TraceRecord (cycles u32, event u16,
+arg u16) and channel 2 SampleRecord (tick u32, channel u8, reserved u8, value u16). The
+sample channel runs in overwrite mode, so after an overrun the reader skips to the next
+record boundary (records never straddle one: the write index stays a multiple of 8).
+
+    rtt_rx.py --openocd localhost:6666 --samples samples.csv --trace trace.csv
+    rtt_rx.py --openocd localhost:6666 --send "time 1760000000"
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+RTT_ID = b"SEGGER RTT\0"
+RECORD_SIZE = 8
+TRACE = struct.Struct("<IHH")
+SAMPLE = struct.Struct("<IBBH")
+
+
+class OpenOcd:
+    pointer = 4
+
+    def __init__(self, address):
+        host, port = address.rsplit(":", 1)
+        self.sock = socket.create_connection((host, int(port)))
+        self.pending = b""
+
+    def command(self, text):
+        self.sock.sendall(text.encode() + b"\x1a")
+        while b"\x1a" not in self.pending:
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                raise ConnectionError("OpenOCD closed the connection")
+            self.pending += chunk
+        reply, self.pending = self.pending.split(b"\x1a", 1)
+        return reply.decode()
+
+    def read(self, address, length):
+        values = self.command("read_memory 0x%x 8 %d" % (address, length)).split()
+        return bytes(int(v, 16) for v in values)
+
+    def write(self, address, data):
+        self.command("write_memory 0x%x 8 {%s}" % (address, " ".join("0x%02x" % b for b in data)))
+
+
+class ProcMem:
+    pointer = 8
+
+    def __init__(self, pid):
+        self.file = open("/proc/%d/mem" % pid, "r+b", buffering=0)
+
+    def read(self, address, length):
+        self.file.seek(address)
+        return self.file.read(length)
+
+    def write(self, address, data):
+        self.file.seek(address)
+        self.file.write(data)
+
+
+def find_control_block(mem, start, size, chunk=4096):
+    for base in range(start, start + size, chunk):
+        data = mem.read(base, chunk + len(RTT_ID))
+        offset = data.find(RTT_ID)
+        if offset >= 0:
+            return base + offset
+    return None
+
+
+class Channel:
+    def __init__(self, mem, address):
+        p = mem.pointer
+        self.mem = mem
+        self.desc = address
+        fmt = "<QQIIII" if p == 8 else "<IIIIII"
+        _, self.buffer, self.size, _, _, self.flags = struct.unpack(fmt, mem.read(address, struct.calcsize(fmt)))
+        self.wr_at = address + 2 * p + 4
+        self.rd_at = address + 2 * p + 8
+
+    def indices(self):
+        wr, rd = struct.unpack("<II", self.mem.read(self.wr_at, 8))
+        return wr, rd
+
+    def drain(self):
+        wr, rd = self.indices()
+        if wr == rd or wr >= self.size or rd >= self.size:
+            return rd, b""
+        if wr > rd:
+            data = self.mem.read(self.buffer + rd, wr - rd)
+        else:
+            data = self.mem.read(self.buffer + rd, self.size - rd) + self.mem.read(self.buffer, wr)
+        self.mem.write(self.rd_at, struct.pack("<I", wr))
+        return rd, data
+
+    def send(self, data):
+        wr, rd = self.indices()
+        for byte in data:
+            nxt = (wr + 1) % self.size
+            if nxt == rd:
+                break                                   # Down buffer full: the rest is dropped
+            self.mem.write(self.buffer + wr, bytes([byte]))
+            wr = nxt
+        self.mem.write(self.wr_at, struct.pack("<I", wr))
+
+
+def records(rd, data):
+    skip = (-rd) % RECORD_SIZE                          # Partial record left by an overwrite
+    data = data[skip:]
+    return [data[i:i + RECORD_SIZE] for i in range(0, len(data) - RECORD_SIZE + 1, RECORD_SIZE)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--openocd", help="OpenOCD Tcl server, HOST:PORT")
+    source.add_argument("--pid", type=int, help="host-simulated board process")
+    parser.add_argument("--address", type=lambda v: int(v, 0), help="control block address")
+    parser.add_argument("--ram", default="0x20000000:0x20000", help="scanned range START:SIZE")
+    parser.add_argument("--trace", help="write cycles,event,arg rows")
+    parser.add_argument("--samples", help="write tick,channel,value rows")
+    parser.add_argument("--send", help="line sent to the terminal down channel")
+    parser.add_argument("--period", type=float, default=0.05, help="poll period in seconds")
+    parser.add_argument("--seconds", type=float, default=0, help="stop after this long")
+    args = parser.parse_args()
+
+    mem = OpenOcd(args.openocd) if args.openocd else ProcMem(args.pid)
+    address = args.address
+    if address is None:
+        start, size = (int(v, 0) for v in args.ram.split(":"))
+        address = find_control_block(mem, start, size)
+        if address is None:
+            sys.exit("no RTT control block in RAM")
+    max_up, max_down = struct.unpack("<ii", mem.read(address + 16, 8))
+    desc = 32 if mem.pointer == 8 else 24
+    up = [Channel(mem, address + 24 + i * desc) for i in range(max_up)]
+    down = [Channel(mem, address + 24 + (max_up + i) * desc) for i in range(max_down)]
+
+    trace = open(args.trace, "w") if args.trace else None
+    samples = open(args.samples, "w") if args.samples else None
+    if trace:
+        trace.write("cycles,event,arg\n")
+    if samples:
+        samples.write("tick,channel,value\n")
+    if args.send and down:
+        down[0].send(args.send.encode() + b"\n")
+
+    start = time.monotonic()
+    try:
+        while not args.seconds or time.monotonic() - start < args.seconds:
+            _, text = up[0].drain()
+            if text:
+                sys.stdout.write(text.decode(errors="replace"))
+                sys.stdout.flush()
+            if len(up) > 1:
+                rd, data = up[1].drain()
+                for record in records(rd, data):
+                    if trace:
+                        trace.write("%u,%u,%u\n" % TRACE.unpack(record))
+            if len(up) > 2:
+                rd, data = up[2].drain()
+                for record in records(rd, data):
+                    tick, channel, _, value = SAMPLE.unpack(record)
+                    if samples:
+                        samples.write("%u,%u,%u\n" % (tick, channel, value))
+            time.sleep(args.period)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if trace:
+            trace.close()
+        if samples:
+            samples.close()
+
+
+if __name__ == "__main__":
+    main()